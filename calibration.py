@@ -91,6 +91,24 @@ np.savez("calibration_data.npz",
          rotationMatrix=rotation_matrix, translationVector=translation_vector,
          leftMapX=left_map_x, leftMapY=left_map_y,
          rightMapX=right_map_x, rightMapY=right_map_y,
-         leftROI=left_roi, rightROI=right_roi)
-
-print("Calibration complete! Saved to 'calibration_data.npz'.")
+         leftROI=left_roi, rightROI=right_roi,
+         leftRectification=left_rectification, rightRectification=right_rectification,
+         leftProjection=left_projection, rightProjection=right_projection,
+         disparityToDepth=disparity_to_depth_map)
+
+# The same calibration for onedong's C++ stereo stage, which rebuilds the remap tables from it at startup
+storage = cv2.FileStorage("calibration_data.yml", cv2.FILE_STORAGE_WRITE)
+storage.write("imageWidth", gray_left.shape[1])
+storage.write("imageHeight", gray_left.shape[0])
+storage.write("leftCameraMatrix", left_camera_matrix)
+storage.write("leftDistortion", left_dist_coeffs)
+storage.write("leftRectification", left_rectification)
+storage.write("leftProjection", left_projection)
+storage.write("rightCameraMatrix", right_camera_matrix)
+storage.write("rightDistortion", right_dist_coeffs)
+storage.write("rightRectification", right_rectification)
+storage.write("rightProjection", right_projection)
+storage.write("disparityToDepth", disparity_to_depth_map)
+storage.release()
+
+print("Calibration complete! Saved to 'calibration_data.npz' and 'calibration_data.yml'.")
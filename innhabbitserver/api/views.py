@@ -6,11 +6,19 @@ class EntranceViewset(viewsets.ModelViewSet):
     queryset = Entrance.objects.all()
     serializer_class = EntranceSerializer
 
-class EntryEventViewset(viewsets.ModelViewSet):
+class BulkCreateMixin:
+    """Accept a JSON list on create so devices can upload a batch of events in one request"""
+
+    def get_serializer(self, *args, **kwargs):
+        if isinstance(kwargs.get("data"), list):
+            kwargs["many"] = True
+        return super().get_serializer(*args, **kwargs)
+
+class EntryEventViewset(BulkCreateMixin, viewsets.ModelViewSet):
     queryset = EntryEvent.objects.all()
     serializer_class = EntryEventSerializer
 
-class ExitEventViewset(viewsets.ModelViewSet):
+class ExitEventViewset(BulkCreateMixin, viewsets.ModelViewSet):
     queryset = ExitEvent.objects.all()
     serializer_class = ExitEventSerializer
 
@@ -0,0 +1,77 @@
+#include "alloc_check.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+
+#ifdef ONEDONG_ALLOC_CHECK
+
+// Initial-exec so reading it never calls back into malloc, even from the shared library
+static thread_local uint64_t allocations __attribute__((tls_model("initial-exec"))) = 0;
+
+// glibc's own allocator, under the names it exports for exactly this
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+// Replacing malloc itself also counts what operator new, cv::fastMalloc (posix_memalign) and
+// C libraries allocate, which a replaced operator new alone would miss. free is left alone.
+extern "C" {
+
+void* malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+    allocations++;
+    return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    allocations++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    allocations++;
+    void* allocated = __libc_memalign(alignment, size);
+    if (!allocated) return ENOMEM;
+    *p = allocated;
+    return 0;
+}
+
+}
+
+bool allocationCountingEnabled() {
+    return true;
+}
+
+uint64_t threadAllocations() {
+    return allocations;
+}
+
+#else
+
+bool allocationCountingEnabled() {
+    return false;
+}
+
+uint64_t threadAllocations() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation counting, used to check that per-frame paths stay allocation-free.
+// Counting only happens in builds made with `make ALLOC_CHECK=1`, which replaces glibc's malloc,
+// calloc, realloc and aligned allocators, so OpenCV's Mat buffers are counted along with
+// operator new; otherwise the counters stay at zero.
+bool allocationCountingEnabled();
+
+// Heap allocations made by the calling thread so far
+uint64_t threadAllocations();
@@ -0,0 +1,286 @@
+#include "assignment.hpp"
+#include "detection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace cv;
+using namespace std;
+
+void solveAssignment(const float* cost, int rows, int cols, vector<int>& rowToCol) {
+    rowToCol.assign(rows, -1);
+    if (rows == 0 || cols == 0) return;
+
+    // The solver below needs rows <= cols, so solve the transpose when that isn't the case
+    thread_local vector<float> transposed;
+    bool transpose = rows > cols;
+    const float* a = cost;
+    int n = rows;
+    int m = cols;
+    if (transpose) {
+        transposed.resize(static_cast<size_t>(rows) * cols);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) {
+                transposed[c * rows + r] = cost[r * cols + c];
+            }
+        }
+        a = transposed.data();
+        n = cols;
+        m = rows;
+    }
+
+    // Potentials are 1-indexed, index 0 is the virtual start column
+    thread_local vector<double> u, v, minv;
+    thread_local vector<int> p, way;
+    thread_local vector<char> used;
+    const double inf = numeric_limits<double>::infinity();
+    u.assign(n + 1, 0.0);
+    v.assign(m + 1, 0.0);
+    p.assign(m + 1, 0);
+    way.assign(m + 1, 0);
+
+    for (int i = 1; i <= n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        minv.assign(m + 1, inf);
+        used.assign(m + 1, 0);
+        do {
+            used[j0] = 1;
+            int i0 = p[j0];
+            double delta = inf;
+            int j1 = 0;
+            const float* row = a + static_cast<size_t>(i0 - 1) * m;
+            for (int j = 1; j <= m; j++) {
+                if (used[j]) continue;
+                double cur = row[j - 1] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= m; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+
+        // Flip the augmenting path
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    for (int j = 1; j <= m; j++) {
+        if (p[j] == 0) continue;
+        if (transpose) {
+            rowToCol[j - 1] = p[j] - 1;
+        } else {
+            rowToCol[p[j] - 1] = j - 1;
+        }
+    }
+}
+
+void IoUMatcher::buildGrid(const vector<Rect>& detections) {
+    gridBounds = detections[0];
+    long long sizeSum = 0;
+    for (const auto& det : detections) {
+        gridBounds |= det;
+        sizeSum += max(det.width, det.height);
+    }
+
+    // Cells roughly one box wide, so each box lands in a handful of cells
+    const int maxCellsPerAxis = 128;
+    cellSize = max(16, static_cast<int>(sizeSum / static_cast<long long>(detections.size())));
+    cellSize = max(cellSize, (max(gridBounds.width, gridBounds.height) + maxCellsPerAxis - 1) / maxCellsPerAxis);
+    gridCols = gridBounds.width / cellSize + 1;
+    gridRows = gridBounds.height / cellSize + 1;
+
+    // Counting pass, prefix sum, then fill
+    cellStart.assign(gridCols * gridRows + 1, 0);
+    for (const auto& det : detections) {
+        int x0 = (det.x - gridBounds.x) / cellSize;
+        int y0 = (det.y - gridBounds.y) / cellSize;
+        int x1 = (det.x + det.width - gridBounds.x) / cellSize;
+        int y1 = (det.y + det.height - gridBounds.y) / cellSize;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                cellStart[y * gridCols + x + 1]++;
+            }
+        }
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) {
+        cellStart[c] += cellStart[c - 1];
+    }
+    cellItems.resize(cellStart.back());
+    order.assign(cellStart.begin(), cellStart.end() - 1); // Reused as the fill cursor
+    for (int i = 0; i < static_cast<int>(detections.size()); i++) {
+        const Rect& det = detections[i];
+        int x0 = (det.x - gridBounds.x) / cellSize;
+        int y0 = (det.y - gridBounds.y) / cellSize;
+        int x1 = (det.x + det.width - gridBounds.x) / cellSize;
+        int y1 = (det.y + det.height - gridBounds.y) / cellSize;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                cellItems[order[y * gridCols + x]++] = i;
+            }
+        }
+    }
+}
+
+void IoUMatcher::findCandidates(const vector<Rect>& tracks, const vector<Rect>& detections, float minIoU) {
+    seenStamp.assign(detections.size(), -1);
+    for (int t = 0; t < static_cast<int>(tracks.size()); t++) {
+        const Rect& track = tracks[t];
+
+        if (track.x + track.width < gridBounds.x || track.y + track.height < gridBounds.y ||
+            track.x > gridBounds.x + gridBounds.width || track.y > gridBounds.y + gridBounds.height) {
+            continue;
+        }
+
+        // Boxes that don't share a cell can't overlap, so only visit the track's cells
+        int x0 = max(track.x - gridBounds.x, 0) / cellSize;
+        int y0 = max(track.y - gridBounds.y, 0) / cellSize;
+        int x1 = min(track.x + track.width - gridBounds.x, gridBounds.width) / cellSize;
+        int y1 = min(track.y + track.height - gridBounds.y, gridBounds.height) / cellSize;
+
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                int cell = y * gridCols + x;
+                for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+                    int d = cellItems[k];
+                    if (seenStamp[d] == t) continue;
+                    seenStamp[d] = t;
+
+                    float iou = computeIoU(track, detections[d]);
+                    if (iou > minIoU) {
+                        edges.push_back({t, d, iou});
+                    }
+                }
+            }
+        }
+    }
+}
+
+int IoUMatcher::findRoot(int node) {
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+void IoUMatcher::match(const vector<Rect>& tracks, const vector<Rect>& detections,
+                       float minIoU, vector<pair<int, int>>& matches) {
+    edges.clear();
+    if (tracks.empty() || detections.empty()) return;
+
+    buildGrid(detections);
+    findCandidates(tracks, detections, minIoU);
+    solve(static_cast<int>(tracks.size()), static_cast<int>(detections.size()), matches);
+}
+
+void IoUMatcher::match(const vector<Rect>& tracks, const vector<Rect>& detections, const vector<float>& trackDepths,
+                       const vector<float>& detectionDepths, float maxDepthGap, float minIoU,
+                       vector<pair<int, int>>& matches) {
+    edges.clear();
+    if (tracks.empty() || detections.empty()) return;
+
+    buildGrid(detections);
+    findCandidates(tracks, detections, minIoU);
+    edges.erase(remove_if(edges.begin(), edges.end(),
+                          [&](const Edge& edge) {
+                              float trackDepth = trackDepths[edge.track];
+                              float detectionDepth = detectionDepths[edge.detection];
+                              return trackDepth > 0 && detectionDepth > 0 &&
+                                     fabs(trackDepth - detectionDepth) > maxDepthGap;
+                          }),
+                edges.end());
+    solve(static_cast<int>(tracks.size()), static_cast<int>(detections.size()), matches);
+}
+
+void IoUMatcher::solve(int trackCount, int detectionCount, vector<pair<int, int>>& matches) {
+    if (edges.empty()) return;
+
+    // Union-find over tracks [0, T) and detections [T, T + D) to split the problem into independent clusters
+    const int nodeCount = trackCount + detectionCount;
+    parent.resize(nodeCount);
+    for (int i = 0; i < nodeCount; i++) {
+        parent[i] = i;
+    }
+    for (const auto& edge : edges) {
+        int a = findRoot(edge.track);
+        int b = findRoot(trackCount + edge.detection);
+        if (a != b) parent[a] = b;
+    }
+
+    componentOf.resize(edges.size());
+    order.resize(edges.size());
+    for (size_t e = 0; e < edges.size(); e++) {
+        componentOf[e] = findRoot(edges[e].track);
+        order[e] = static_cast<int>(e);
+    }
+    sort(order.begin(), order.end(), [this](int a, int b) { return componentOf[a] < componentOf[b]; });
+
+    localIndex.assign(nodeCount, -1);
+    for (size_t begin = 0; begin < order.size(); ) {
+        size_t end = begin;
+        while (end < order.size() && componentOf[order[end]] == componentOf[order[begin]]) {
+            end++;
+        }
+
+        // A single candidate pair needs no solver
+        if (end - begin == 1) {
+            const Edge& edge = edges[order[begin]];
+            matches.emplace_back(edge.track, edge.detection);
+            begin = end;
+            continue;
+        }
+
+        componentTracks.clear();
+        componentDetections.clear();
+        for (size_t k = begin; k < end; k++) {
+            const Edge& edge = edges[order[k]];
+            if (localIndex[edge.track] < 0) {
+                localIndex[edge.track] = static_cast<int>(componentTracks.size());
+                componentTracks.push_back(edge.track);
+            }
+            if (localIndex[trackCount + edge.detection] < 0) {
+                localIndex[trackCount + edge.detection] = static_cast<int>(componentDetections.size());
+                componentDetections.push_back(edge.detection);
+            }
+        }
+
+        // Cost is 1 - IoU, and pairs that didn't survive pruning cost the same as IoU 0
+        const int rows = static_cast<int>(componentTracks.size());
+        const int cols = static_cast<int>(componentDetections.size());
+        cost.assign(static_cast<size_t>(rows) * cols, 1.0f);
+        for (size_t k = begin; k < end; k++) {
+            const Edge& edge = edges[order[k]];
+            cost[localIndex[edge.track] * cols + localIndex[trackCount + edge.detection]] = 1.0f - edge.iou;
+        }
+
+        solveAssignment(cost.data(), rows, cols, assignment);
+        for (int r = 0; r < rows; r++) {
+            int c = assignment[r];
+            if (c >= 0 && cost[r * cols + c] < 1.0f) {
+                matches.emplace_back(componentTracks[r], componentDetections[c]);
+            }
+        }
+
+        for (int t : componentTracks) localIndex[t] = -1;
+        for (int d : componentDetections) localIndex[trackCount + d] = -1;
+        begin = end;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <utility>
+#include <vector>
+
+// Solves the rectangular linear assignment problem on a dense row-major cost matrix
+// (Hungarian method with shortest augmenting paths, O(n^2 m)). rowToCol[r] is the
+// column assigned to row r, or -1 when there are more rows than columns.
+void solveAssignment(const float* cost, int rows, int cols, std::vector<int>& rowToCol);
+
+// Finds the track/detection pairing that maximises total IoU among pairs whose IoU is
+// above a threshold. Candidate pairs are pruned with a uniform grid, split into connected
+// components, and each component is solved on its own small dense cost matrix.
+// Scratch buffers are kept between calls, so steady-state matching does not allocate.
+class IoUMatcher {
+    public:
+        // Appends (trackIndex, detectionIndex) pairs to matches
+        void match(const std::vector<cv::Rect>& tracks, const std::vector<cv::Rect>& detections,
+                   float minIoU, std::vector<std::pair<int, int>>& matches);
+        // Same, but a pair whose depths are both known (> 0) and more than maxDepthGap apart is
+        // never matched, so people overlapping in the image at different distances keep their tracks
+        void match(const std::vector<cv::Rect>& tracks, const std::vector<cv::Rect>& detections,
+                   const std::vector<float>& trackDepths, const std::vector<float>& detectionDepths,
+                   float maxDepthGap, float minIoU, std::vector<std::pair<int, int>>& matches);
+
+        // Number of candidate pairs that survived pruning in the last call
+        size_t candidateCount() const { return edges.size(); }
+
+    private:
+        struct Edge {
+            int track;
+            int detection;
+            float iou;
+        };
+
+        void buildGrid(const std::vector<cv::Rect>& detections);
+        void findCandidates(const std::vector<cv::Rect>& tracks, const std::vector<cv::Rect>& detections, float minIoU);
+        void solve(int trackCount, int detectionCount, std::vector<std::pair<int, int>>& matches);
+        int findRoot(int node);
+
+        // Grid over the detections, stored as CSR: cellStart[c]..cellStart[c + 1] index cellItems
+        cv::Rect gridBounds;
+        int cellSize = 64;
+        int gridCols = 0;
+        int gridRows = 0;
+        std::vector<int> cellStart;
+        std::vector<int> cellItems;
+        std::vector<int> seenStamp;
+        int stamp = 0;
+
+        std::vector<Edge> edges;
+        std::vector<int> parent;
+        std::vector<int> componentOf;
+        std::vector<int> order;
+        std::vector<int> localIndex;
+        std::vector<int> componentTracks;
+        std::vector<int> componentDetections;
+        std::vector<float> cost;
+        std::vector<int> assignment;
+};
@@ -0,0 +1,39 @@
+#include "backend.hpp"
+
+#include <opencv2/core/ocl.hpp>
+
+using namespace cv;
+using namespace dnn;
+using namespace std;
+
+bool parseBackend(const string& name, ComputeBackend& backend) {
+    if (name == "auto") backend = ComputeBackend::Auto;
+    else if (name == "cuda") backend = ComputeBackend::Cuda;
+    else if (name == "opencl") backend = ComputeBackend::OpenCL;
+    else if (name == "cpu") backend = ComputeBackend::Cpu;
+    else return false;
+    return true;
+}
+
+const char* selectBackend(Net& net, ComputeBackend backend) {
+    if (backend == ComputeBackend::Auto) {
+        if (cuda::getCudaEnabledDeviceCount() > 0) backend = ComputeBackend::Cuda;
+        else if (ocl::haveOpenCL()) backend = ComputeBackend::OpenCL;
+        else backend = ComputeBackend::Cpu;
+    }
+
+    switch (backend) {
+        case ComputeBackend::Cuda:
+            net.setPreferableBackend(DNN_BACKEND_CUDA);
+            net.setPreferableTarget(DNN_TARGET_CUDA);
+            return "CUDA";
+        case ComputeBackend::OpenCL:
+            net.setPreferableBackend(DNN_BACKEND_OPENCV);
+            net.setPreferableTarget(DNN_TARGET_OPENCL);
+            return "OpenCL";
+        default:
+            net.setPreferableBackend(DNN_BACKEND_OPENCV);
+            net.setPreferableTarget(DNN_TARGET_CPU);
+            return "CPU";
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <opencv2/dnn.hpp>
+
+#include <string>
+
+enum class ComputeBackend {
+    Auto,   // CUDA if there is a device, then OpenCL, then CPU
+    Cuda,
+    OpenCL,
+    Cpu,
+};
+
+// Parses "auto", "cuda", "opencl" or "cpu"
+bool parseBackend(const std::string& name, ComputeBackend& backend);
+
+// Points the network at the requested backend and returns the name of the one in use
+const char* selectBackend(cv::dnn::Net& net, ComputeBackend backend = ComputeBackend::Auto);
@@ -0,0 +1,415 @@
+// Counts people in archived footage much faster than real time, for backfilling the server.
+// The video is cut into chunks of --chunk-seconds. Workers, each with its own network, decode and
+// detect whole chunks in parallel. Each chunk starts --overlap frames early, so a seek that lands
+// late loses nothing. One thread takes the chunks' detections in order, drops the frames the overlap
+// repeated, and tracks and counts the result as a single pass over the file would. Crossings are
+// written as a Django fixture for `python manage.py loaddata`.
+#include "bytetracker.hpp"
+#include "counter.hpp"
+#include "detection_log.hpp"
+#include "detector.hpp"
+#include "nms.hpp"
+#include "preprocess.hpp"
+#include "uplink.hpp"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <regex>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+// A range of frames [begin, end) one worker decodes and detects
+struct Chunk {
+    int64_t begin = 0;
+    int64_t end = 0; // INT64_MAX for the last chunk, which runs to the end of the file
+};
+
+struct ChunkFrame {
+    double ms; // Position in the file
+    vector<Detection> detections;
+};
+
+struct ChunkResult {
+    bool done = false;
+    vector<ChunkFrame> frames;
+};
+
+struct WorkerStats {
+    uint64_t chunks = 0;
+    uint64_t frames = 0;
+    double decodeMs = 0.0;
+    double detectMs = 0.0;
+};
+
+static double elapsedMs(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+static bool openVideo(VideoCapture& cap, const string& path) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+    // One decoder thread per worker; the workers already use every core
+    return cap.open(path, CAP_FFMPEG, {CAP_PROP_N_THREADS, 1});
+#else
+    return cap.open(path, CAP_FFMPEG);
+#endif
+}
+
+// Parses "YYYY-MM-DDTHH:MM:SS", local time unless it ends in Z
+static bool parseStart(const string& text, chrono::system_clock::time_point& start) {
+    tm local = {};
+    char zone = 0;
+    int n = sscanf(text.c_str(), "%d-%d-%d%*1[T ]%d:%d:%d%c", &local.tm_year, &local.tm_mon, &local.tm_mday,
+                   &local.tm_hour, &local.tm_min, &local.tm_sec, &zone);
+    if (n < 6 || (n == 7 && zone != 'Z')) return false;
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    time_t seconds = zone == 'Z' ? timegm(&local) : mktime(&local);
+    if (seconds == -1) return false;
+    start = chrono::system_clock::from_time_t(seconds);
+    return true;
+}
+
+// When recording started: from a name like WIN_20250303_10_21_48_Pro.mp4 (local time), otherwise the
+// file's modification time minus its length
+static chrono::system_clock::time_point guessStart(const string& path, double durationSeconds) {
+    static const regex stamp(R"((\d{4})-?(\d{2})-?(\d{2})[_T -]?(\d{2})[_:.-]?(\d{2})[_:.-]?(\d{2}))");
+    string name = path.substr(path.find_last_of('/') + 1);
+    smatch match;
+    if (regex_search(name, match, stamp)) {
+        string text = match[1].str() + "-" + match[2].str() + "-" + match[3].str() + "T" + match[4].str() + ":" +
+                      match[5].str() + ":" + match[6].str();
+        chrono::system_clock::time_point start;
+        if (parseStart(text, start)) {
+            cout << "Recording started " << text << " local time, from the file name" << endl;
+            return start;
+        }
+    }
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return chrono::system_clock::now();
+    cerr << "Warning: No time in the file name, assuming the recording ended when " << path
+         << " was last modified; pass --start to set it" << endl;
+    return chrono::system_clock::from_time_t(info.st_mtime) -
+           chrono::duration_cast<chrono::system_clock::duration>(chrono::duration<double>(durationSeconds));
+}
+
+// Appends crossings to a Django fixture as they are counted, closing the list on finish
+class FixtureWriter {
+    public:
+        bool open(const string& path) {
+            out.open(path);
+            if (!out) {
+                cerr << "Error: Cannot write " << path << endl;
+                return false;
+            }
+            out << "[";
+            return true;
+        }
+
+        void write(const CrossingEvent& event) {
+            out << (count ? ",\n" : "\n") << "{\"model\": \"occupancy."
+                << (event.kind == EventKind::Entry ? "entryevent" : "exitevent")
+                << "\", \"fields\": {\"timestamp\": \"" << isoTimestamp(event.time)
+                << "\", \"entrance\": " << event.entrance << "}}";
+            count++;
+        }
+
+        void finish() { out << "\n]\n"; }
+
+    private:
+        ofstream out;
+        uint64_t count = 0;
+};
+
+// Decodes and detects one chunk on a worker's own capture and network
+static void runChunk(VideoCapture& cap, Detector& detector, Preprocessor& preprocessor, const NmsParams& nmsParams,
+                     const Chunk& chunk, int overlap, ChunkResult& result, WorkerStats& stats) {
+    // FFmpeg seeks to the keyframe before and decodes forward from there
+    cap.set(CAP_PROP_POS_FRAMES, static_cast<double>(max<int64_t>(0, chunk.begin - overlap)));
+    Mat frame, blob;
+    vector<Mat> outputs;
+    vector<DecodeParams> imageParams(1);
+    DecodeBuffer candidates;
+    for (;;) {
+        auto begin = chrono::steady_clock::now();
+        if (!cap.read(frame)) break;
+        // The position after a read is that of the next frame
+        int64_t index = static_cast<int64_t>(cap.get(CAP_PROP_POS_FRAMES)) - 1;
+        double ms = cap.get(CAP_PROP_POS_MSEC);
+        stats.decodeMs += elapsedMs(begin);
+        if (index >= chunk.end) break;
+
+        begin = chrono::steady_clock::now();
+        preprocessor.run(frame, blob);
+        detector.forward(blob, outputs);
+        imageParams[0] = preprocessor.decodeParams();
+        detector.decode(outputs, imageParams, candidates);
+        result.frames.push_back({ms, {}});
+        suppressToDetections(candidates, nmsParams, result.frames.back().detections);
+        stats.detectMs += elapsedMs(begin);
+        stats.frames++;
+    }
+    stats.chunks++;
+}
+
+int main(int argc, char* argv[]) {
+    string videoPath;
+    string outPath = "events.json";
+    string recordPath;
+    string startText;
+    vector<CountingZone> zones;
+    ByteTrackConfig trackConfig;
+    DetectorConfig detectorConfig;
+    PreprocessConfig preprocessConfig;
+    NmsParams nmsParams;
+    int workers = static_cast<int>(thread::hardware_concurrency());
+    double chunkSeconds = 60.0;
+    int overlap = 8;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--zone") == 0 && i + 1 < argc) {
+            CountingZone zone;
+            if (!parseZone(argv[++i], zone)) {
+                cerr << "Error: Bad zone " << argv[i] << ", expected entrance:x1,y1,x2,y2[,...]" << endl;
+                return -1;
+            }
+            zones.push_back(zone);
+        } else if (strcmp(argv[i], "--track-param") == 0 && i + 1 < argc) {
+            if (!parseByteTrackParam(argv[++i], trackConfig)) {
+                cerr << "Error: Bad tracker parameter " << argv[i]
+                     << ", expected max-kill|iou-high|iou-low|conf-high|conf-low=value" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--detector") == 0 && i + 1 < argc) {
+            if (!parseDetector(argv[++i], detectorConfig)) {
+                cerr << "Error: Bad detector " << argv[i] << ", expected dnn[:model[:config]] or onnx:model.onnx" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (!parseBackend(argv[++i], detectorConfig.backend)) {
+                cerr << "Error: Unknown backend " << argv[i] << ", expected auto, cuda, opencl or cpu" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--nms") == 0 && i + 1 < argc) {
+            if (!parseNmsMethod(argv[++i], nmsParams.method)) {
+                cerr << "Error: Unknown NMS method " << argv[i] << ", expected greedy, matrix or opencv" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--model-cache") == 0 && i + 1 < argc) {
+            detectorConfig.cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--letterbox") == 0) {
+            preprocessConfig.letterbox = true;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--chunk-seconds") == 0 && i + 1 < argc) {
+            chunkSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--overlap") == 0 && i + 1 < argc) {
+            overlap = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+            startText = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else {
+            videoPath = argv[i];
+        }
+    }
+    if (videoPath.empty()) {
+        cerr << "Usage: backfill video.mp4 --zone ... [--out events.json] [--start YYYY-MM-DDTHH:MM:SS[Z]] "
+                "[--workers N] [--chunk-seconds S] [--overlap FRAMES] [--detector SPEC] [--backend NAME] "
+                "[--model-cache DIR] [--letterbox] [--nms METHOD] [--track-param name=value] [--record detections.log]"
+             << endl;
+        return -1;
+    }
+    if (zones.empty()) {
+        cerr << "Warning: No --zone given, nothing will be counted" << endl;
+    }
+
+    VideoCapture probe;
+    if (!openVideo(probe, videoPath)) {
+        cerr << "Error: Cannot open " << videoPath << endl;
+        return -1;
+    }
+    double fps = probe.get(CAP_PROP_FPS);
+    int64_t frameCount = static_cast<int64_t>(probe.get(CAP_PROP_FRAME_COUNT));
+    probe.release();
+
+    // The frame count is an estimate for some containers, so the last chunk just reads to the end
+    vector<Chunk> chunks;
+    if (fps > 0 && frameCount > 0) {
+        int64_t chunkFrames = max<int64_t>(1, static_cast<int64_t>(chunkSeconds * fps));
+        for (int64_t begin = 0; begin < frameCount; begin += chunkFrames) {
+            chunks.push_back({begin, begin + chunkFrames});
+        }
+    } else {
+        cerr << "Warning: " << videoPath << " has no frame count or rate, so it can't be split; decoding it in one piece"
+             << endl;
+        chunks.push_back({0, 0});
+    }
+    chunks.back().end = INT64_MAX;
+    workers = max(1, min(workers, static_cast<int>(chunks.size())));
+
+    chrono::system_clock::time_point start;
+    if (!startText.empty()) {
+        if (!parseStart(startText, start)) {
+            cerr << "Error: Bad start time " << startText << ", expected YYYY-MM-DDTHH:MM:SS[Z]" << endl;
+            return -1;
+        }
+    } else {
+        start = guessStart(videoPath, fps > 0 ? frameCount / fps : 0.0);
+    }
+
+    // Parallelism comes from the workers, so each network gets one thread unless told otherwise
+    if (detectorConfig.threads == 0) {
+        detectorConfig.threads = 1;
+    }
+    vector<unique_ptr<Detector>> detectors;
+    vector<VideoCapture> captures(workers);
+    for (int w = 0; w < workers; w++) {
+        unique_ptr<Detector> detector = createDetector(detectorConfig);
+        if (!detector) {
+            return -1;
+        }
+        if (!openVideo(captures[w], videoPath)) {
+            cerr << "Error: Cannot open " << videoPath << endl;
+            return -1;
+        }
+        detectors.push_back(std::move(detector));
+    }
+    preprocessConfig.inputSize = detectors[0]->inputSize();
+
+    FixtureWriter fixture;
+    if (!fixture.open(outPath)) {
+        return -1;
+    }
+    DetectionLogWriter detectionLog;
+    if (!recordPath.empty() && !detectionLog.open(recordPath, fps)) {
+        return -1;
+    }
+
+    cout << "Backfilling " << videoPath << ": " << chunks.size() << " chunks on " << workers << " workers with "
+         << detectors[0]->name() << endl;
+
+    // Workers stay at most a few chunks ahead of the tracker, so memory doesn't grow with the file
+    const size_t window = 2 * static_cast<size_t>(workers);
+    vector<ChunkResult> results(chunks.size());
+    vector<WorkerStats> stats(workers);
+    atomic<size_t> nextChunk{0};
+    size_t merged = 0;
+    mutex lock;
+    condition_variable chunkDone;
+    condition_variable chunkMerged;
+    auto begin = chrono::steady_clock::now();
+
+    vector<thread> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.emplace_back([&, w] {
+            Preprocessor preprocessor(preprocessConfig);
+            for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++) {
+                {
+                    unique_lock<mutex> guard(lock);
+                    chunkMerged.wait(guard, [&] { return c < merged + window; });
+                }
+                ChunkResult result;
+                runChunk(captures[w], *detectors[w], preprocessor, nmsParams, chunks[c], overlap, result, stats[w]);
+                result.done = true;
+                {
+                    lock_guard<mutex> guard(lock);
+                    results[c] = std::move(result);
+                }
+                chunkDone.notify_all();
+            }
+        });
+    }
+
+    // Tracking and counting run in file order over every frame exactly once, so the counts are
+    // those of a single pass however the file was split
+    ByteTrack tracker(trackConfig);
+    if (fps > 0) tracker.setFramePeriod(1.0 / fps);
+    LineCounter counter(zones);
+    vector<CrossingEvent> events;
+    const double periodMs = fps > 0 ? 1000.0 / fps : 0.0;
+    double lastMs = -1e300;
+    uint64_t frames = 0;
+    uint64_t repeated = 0;
+    uint64_t gaps = 0;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        ChunkResult result;
+        {
+            unique_lock<mutex> guard(lock);
+            chunkDone.wait(guard, [&] { return results[c].done; });
+            result = std::move(results[c]);
+            results[c] = ChunkResult();
+            merged = c + 1;
+        }
+        chunkMerged.notify_all();
+
+        bool first = true;
+        for (ChunkFrame& frame : result.frames) {
+            // Frames the overlap decoded again; a seek is only as exact as the file's timestamps
+            if (frame.ms <= lastMs + 0.5 * periodMs) {
+                repeated++;
+                continue;
+            }
+            if (first && c > 0 && periodMs > 0 && frame.ms > lastMs + 1.5 * periodMs) {
+                gaps++;
+            }
+            first = false;
+            lastMs = frame.ms;
+
+            chrono::steady_clock::time_point timestamp(
+                chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(frame.ms)));
+            chrono::system_clock::time_point time =
+                start + chrono::duration_cast<chrono::system_clock::duration>(chrono::duration<double, milli>(frame.ms));
+            if (!recordPath.empty()) {
+                detectionLog.write(time, true, frame.detections);
+            }
+            TrackView tracks = tracker.update(frame.detections, timestamp);
+            events.clear();
+            counter.update(tracks, time, events);
+            for (const auto& event : events) {
+                fixture.write(event);
+            }
+            frames++;
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    fixture.finish();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    cout << fixed << setprecision(1);
+    for (int w = 0; w < workers; w++) {
+        const WorkerStats& s = stats[w];
+        cout << "Worker " << w << ": " << s.chunks << " chunks, " << s.frames << " frames, decode "
+             << (s.frames ? s.decodeMs / s.frames : 0.0) << " ms, detect " << (s.frames ? s.detectMs / s.frames : 0.0)
+             << " ms per frame" << endl;
+    }
+    double videoSeconds = periodMs > 0 ? frames * periodMs / 1000.0 : 0.0;
+    cout << frames << " frames in " << seconds << " s, " << (seconds > 0 ? frames / seconds : 0.0) << " fps";
+    if (videoSeconds > 0) cout << ", " << videoSeconds / seconds << "x real time";
+    cout << "; " << repeated << " overlap frames dropped, " << gaps << " gaps at chunk boundaries" << endl;
+    if (gaps > 0) {
+        cerr << "Warning: Some chunks started late; raise --overlap so their seeks land before the boundary" << endl;
+    }
+    cout << "Entries " << counter.entries() << ", exits " << counter.exits() << ", written to " << outPath << endl;
+    cout << "Load with: python manage.py loaddata " << outPath << endl;
+    return 0;
+}
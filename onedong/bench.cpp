@@ -0,0 +1,524 @@
+// End-to-end benchmark. Runs the detector and tracker serially over a video or still images,
+// headless, and reports per-stage latency percentiles and throughput, then times
+// ByteTrack::update alone on synthetic crowds of thousands of people.
+// Everything also goes to a JSON file so builds and backends can be compared over time.
+// With --eval it instead scores detectors on a labelled image set, to see what a faster
+// backend or a quantized model costs in accuracy.
+#include "backend.hpp"
+#include "bytetracker.hpp"
+#include "detector.hpp"
+#include "model_cache.hpp"
+#include "nms.hpp"
+#include "preprocess.hpp"
+#include "synthetic_crowd.hpp"
+#include "tiling.hpp"
+#include "yolo_decoder.hpp"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+enum BenchStage {
+    Decode,
+    Preprocess,
+    Forward,
+    Parse,
+    Nms,
+    Track,
+    StageCount,
+};
+
+static const char* benchStageNames[StageCount] = {"decode", "preprocess", "forward", "parse", "nms", "track"};
+
+struct Percentiles {
+    double mean = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+// Nearest-rank percentiles of samples in milliseconds
+static Percentiles summarize(vector<double> samples) {
+    Percentiles p;
+    if (samples.empty()) return p;
+    sort(samples.begin(), samples.end());
+    auto rank = [&](double q) {
+        size_t i = static_cast<size_t>(q * samples.size());
+        return samples[min(i, samples.size() - 1)];
+    };
+    double total = 0;
+    for (double s : samples) total += s;
+    p.mean = total / samples.size();
+    p.p50 = rank(0.50);
+    p.p90 = rank(0.90);
+    p.p99 = rank(0.99);
+    p.max = samples.back();
+    return p;
+}
+
+static double elapsedMs(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+static bool isImage(const string& path) {
+    string ext = path.substr(path.find_last_of('.') + 1);
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp";
+}
+
+static string jsonString(const string& s) {
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static void writePercentiles(ostream& os, const Percentiles& p) {
+    os << "{\"mean_ms\": " << p.mean << ", \"p50_ms\": " << p.p50 << ", \"p90_ms\": " << p.p90
+       << ", \"p99_ms\": " << p.p99 << ", \"max_ms\": " << p.max << "}";
+}
+
+// Stills are decoded from memory every frame so "decode" measures the codec, not the disk
+class FrameSource {
+    public:
+        explicit FrameSource(const vector<string>& paths) {
+            if (paths.size() == 1 && !isImage(paths[0])) {
+                cap.open(paths[0], CAP_FFMPEG);
+                return;
+            }
+            for (const auto& path : paths) {
+                ifstream file(path, ios::binary);
+                if (!file) continue;
+                encoded.emplace_back(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+            }
+        }
+
+        bool isOpen() const { return cap.isOpened() || !encoded.empty(); }
+
+        bool read(Mat& frame) {
+            if (cap.isOpened()) {
+                return cap.read(frame) && !frame.empty();
+            }
+            frame = imdecode(encoded[next++ % encoded.size()], IMREAD_COLOR);
+            return !frame.empty();
+        }
+
+    private:
+        VideoCapture cap;
+        vector<vector<uchar>> encoded;
+        size_t next = 0;
+};
+
+// Ground truth in YOLO format: images/x.jpg is labelled by labels/x.txt (or x.txt next to it),
+// one "class cx cy w h" line per object in normalised coordinates. Class 0 is person.
+static vector<Rect> loadLabels(const string& imagePath, Size imageSize) {
+    string base = imagePath.substr(0, imagePath.find_last_of('.'));
+    string labelPath = base + ".txt";
+    size_t images = base.rfind("/images/");
+    if (images != string::npos) {
+        string candidate = base.substr(0, images) + "/labels/" + base.substr(images + 8) + ".txt";
+        if (ifstream(candidate)) labelPath = candidate;
+    }
+
+    vector<Rect> truths;
+    ifstream file(labelPath);
+    int cls;
+    float cx, cy, w, h;
+    while (file >> cls >> cx >> cy >> w >> h) {
+        if (cls != 0) continue;
+        truths.emplace_back(static_cast<int>((cx - w / 2) * imageSize.width), static_cast<int>((cy - h / 2) * imageSize.height),
+                            static_cast<int>(w * imageSize.width), static_cast<int>(h * imageSize.height));
+    }
+    return truths;
+}
+
+struct EvalResult {
+    string name;
+    double ap50 = 0;
+    double forwardMs = 0;
+    int images = 0;
+    int truths = 0;
+};
+
+// Person AP at IoU 0.5, all-point interpolation as in Pascal VOC
+static EvalResult evaluate(Detector& detector, const vector<string>& images, PreprocessConfig config) {
+    EvalResult result;
+    result.name = detector.name();
+    config.inputSize = detector.inputSize();
+    Preprocessor preprocessor(config);
+    Mat frame, blob;
+    vector<Mat> outputs;
+    DecodeBuffer candidates;
+    vector<Detection> detections;
+    vector<pair<float, bool>> scored; // Confidence, true positive
+    vector<DecodeParams> imageParams(1);
+    vector<double> forwardMs;
+
+    for (const auto& path : images) {
+        frame = imread(path, IMREAD_COLOR);
+        if (frame.empty()) continue;
+        vector<Rect> truths = loadLabels(path, frame.size());
+
+        preprocessor.run(frame, blob);
+        auto begin = chrono::steady_clock::now();
+        detector.forward(blob, outputs);
+        forwardMs.push_back(elapsedMs(begin));
+        imageParams[0] = preprocessor.decodeParams();
+        detector.decode(outputs, imageParams, candidates);
+        detections.clear();
+        suppressToDetections(candidates, NmsParams(), detections);
+
+        // Greedy by confidence: each truth can only be found once
+        sort(detections.begin(), detections.end(),
+             [](const Detection& a, const Detection& b) { return a.confidence > b.confidence; });
+        vector<bool> found(truths.size(), false);
+        for (const auto& det : detections) {
+            int best = -1;
+            float bestIoU = 0.5f;
+            for (size_t t = 0; t < truths.size(); t++) {
+                float iou = computeIoU(det.bbox, truths[t]);
+                if (!found[t] && iou >= bestIoU) {
+                    best = static_cast<int>(t);
+                    bestIoU = iou;
+                }
+            }
+            if (best >= 0) found[best] = true;
+            scored.emplace_back(det.confidence, best >= 0);
+        }
+        result.truths += static_cast<int>(truths.size());
+        result.images++;
+    }
+
+    sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    vector<double> precision, recall;
+    int truePositives = 0;
+    for (size_t i = 0; i < scored.size(); i++) {
+        truePositives += scored[i].second;
+        precision.push_back(static_cast<double>(truePositives) / (i + 1));
+        recall.push_back(result.truths ? static_cast<double>(truePositives) / result.truths : 0.0);
+    }
+    for (int i = static_cast<int>(precision.size()) - 2; i >= 0; i--) {
+        precision[i] = max(precision[i], precision[i + 1]);
+    }
+    double previousRecall = 0;
+    for (size_t i = 0; i < precision.size(); i++) {
+        result.ap50 += (recall[i] - previousRecall) * precision[i];
+        previousRecall = recall[i];
+    }
+    result.forwardMs = summarize(forwardMs).mean;
+    return result;
+}
+
+static int runEvaluation(const string& dir, const vector<DetectorConfig>& configs, const PreprocessConfig& preprocessConfig,
+                         const string& jsonPath) {
+    vector<String> found;
+    vector<string> images;
+    for (const char* pattern : {"/*.jpg", "/*.png"}) {
+        glob(dir + pattern, found, false);
+        images.insert(images.end(), found.begin(), found.end());
+    }
+    if (images.empty()) {
+        cerr << "Error: No images in " << dir << endl;
+        return -1;
+    }
+
+    vector<EvalResult> results;
+    for (const auto& config : configs) {
+        unique_ptr<Detector> detector = createDetector(config);
+        if (!detector) return -1;
+        results.push_back(evaluate(*detector, images, preprocessConfig));
+    }
+
+    cout << fixed << setprecision(4);
+    for (const auto& r : results) {
+        cout << r.name << ": AP50 " << r.ap50 << ", forward " << r.forwardMs << " ms, " << r.images << " images, "
+             << r.truths << " people" << endl;
+    }
+    if (results.size() == 2) {
+        cout << "AP50 drift: " << results[0].ap50 - results[1].ap50 << ", speedup: "
+             << (results[0].forwardMs > 0 ? results[1].forwardMs / results[0].forwardMs : 0.0) << "x" << endl;
+    }
+
+    ofstream json(jsonPath);
+    if (!json) {
+        cerr << "Error: Cannot write " << jsonPath << endl;
+        return -1;
+    }
+    json << fixed << setprecision(4) << "{\n  \"eval\": " << jsonString(dir) << ",\n  \"detectors\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        json << "    {\"name\": " << jsonString(results[i].name) << ", \"model\": " << jsonString(configs[i].model)
+             << ", \"ap50\": " << results[i].ap50 << ", \"forward_ms\": " << results[i].forwardMs
+             << ", \"images\": " << results[i].images << ", \"people\": " << results[i].truths << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]";
+    if (results.size() == 2) {
+        json << ",\n  \"ap50_drift\": " << results[0].ap50 - results[1].ap50;
+    }
+    json << "\n}\n";
+    cout << "Wrote " << jsonPath << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> sources;
+    DetectorConfig detectorConfig;
+    DetectorConfig referenceConfig;
+    bool haveReference = false;
+    string evalDir;
+    PreprocessConfig preprocessConfig;
+    vector<Rect> tiles;
+    int frames = 200;
+    int warmup = 5;
+    int syntheticMax = 5000;
+    int syntheticFrames = 100;
+    string jsonPath = "bench.json";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (!parseBackend(argv[++i], detectorConfig.backend)) {
+                cerr << "Error: Unknown backend " << argv[i] << ", expected auto, cuda, opencl or cpu" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--detector") == 0 && i + 1 < argc) {
+            if (!parseDetector(argv[++i], detectorConfig)) {
+                cerr << "Error: Bad detector " << argv[i] << ", expected dnn[:model[:config]] or onnx:model.onnx" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            if (!parseDetector(argv[++i], referenceConfig)) {
+                cerr << "Error: Bad detector " << argv[i] << ", expected dnn[:model[:config]] or onnx:model.onnx" << endl;
+                return -1;
+            }
+            haveReference = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            detectorConfig.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--model-cache") == 0 && i + 1 < argc) {
+            detectorConfig.cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--eval") == 0 && i + 1 < argc) {
+            evalDir = argv[++i];
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            Rect tile;
+            if (!parseTile(argv[++i], tile)) {
+                cerr << "Error: Bad tile " << argv[i] << ", expected x,y,width,height" << endl;
+                return -1;
+            }
+            tiles.push_back(tile);
+        } else if (strcmp(argv[i], "--letterbox") == 0) {
+            preprocessConfig.letterbox = true;
+        } else if (strcmp(argv[i], "--synthetic-max") == 0 && i + 1 < argc) {
+            syntheticMax = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--synthetic-frames") == 0 && i + 1 < argc) {
+            syntheticFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            sources.push_back(argv[i]);
+        }
+    }
+    if (!detectorConfig.cacheDir.empty() && !prepareModelCache(detectorConfig.cacheDir)) {
+        return -1;
+    }
+    if (!evalDir.empty()) {
+        // The reference runs with the same threads, device and cache as the detector under test
+        referenceConfig.threads = detectorConfig.threads;
+        referenceConfig.backend = detectorConfig.backend;
+        referenceConfig.cacheDir = detectorConfig.cacheDir;
+        vector<DetectorConfig> configs = {detectorConfig};
+        if (haveReference) configs.insert(configs.begin(), referenceConfig);
+        return runEvaluation(evalDir, configs, preprocessConfig, jsonPath);
+    }
+    if (sources.empty()) {
+        sources = {"../scene11.png", "../scene12.png", "../scene15.png"};
+    }
+
+    FrameSource source(sources);
+    if (!source.isOpen()) {
+        cerr << "Error: Cannot open " << sources[0] << endl;
+        return -1;
+    }
+
+    // Load and first-forward times show what --model-cache saves on a restart; run twice to see a warm cache
+    auto loadBegin = chrono::steady_clock::now();
+    unique_ptr<Detector> detector = createDetector(detectorConfig);
+    if (!detector) {
+        return -1;
+    }
+    double loadMs = elapsedMs(loadBegin);
+    double firstForwardMs = 0.0;
+    string backendName = detector->name();
+    preprocessConfig.inputSize = detector->inputSize();
+
+    Preprocessor preprocessor(preprocessConfig);
+    TiledInput tiledInput(tiles, preprocessConfig);
+    vector<DecodeParams> imageParams(1);
+    ByteTrack tracker;
+    Mat frame, blob;
+    vector<Mat> outputs;
+    DecodeBuffer candidates;
+    vector<Detection> detections;
+    vector<double> samples[StageCount];
+    int measured = 0;
+
+    // Serial on purpose: each stage gets the machine to itself, so numbers are comparable between runs
+    auto runBegin = chrono::steady_clock::now();
+    for (int f = 0; f < warmup + frames; f++) {
+        if (f == warmup) {
+            runBegin = chrono::steady_clock::now();
+        }
+        double ms[StageCount];
+
+        auto begin = chrono::steady_clock::now();
+        if (!source.read(frame)) break;
+        ms[Decode] = elapsedMs(begin);
+
+        begin = chrono::steady_clock::now();
+        if (tiledInput.enabled()) {
+            tiledInput.run(frame, blob);
+        } else {
+            preprocessor.run(frame, blob);
+        }
+        ms[Preprocess] = elapsedMs(begin);
+
+        begin = chrono::steady_clock::now();
+        detector->forward(blob, outputs);
+        ms[Forward] = elapsedMs(begin);
+        if (f == 0) firstForwardMs = ms[Forward];
+
+        begin = chrono::steady_clock::now();
+        if (tiledInput.enabled()) {
+            detector->decode(outputs, tiledInput.decodeParams(), candidates);
+        } else {
+            imageParams[0] = preprocessor.decodeParams();
+            detector->decode(outputs, imageParams, candidates);
+        }
+        ms[Parse] = elapsedMs(begin);
+
+        begin = chrono::steady_clock::now();
+        detections.clear();
+        suppressToDetections(candidates, NmsParams(), detections);
+        ms[Nms] = elapsedMs(begin);
+
+        begin = chrono::steady_clock::now();
+        tracker.update(detections);
+        ms[Track] = elapsedMs(begin);
+
+        if (f < warmup) continue;
+        for (int s = 0; s < StageCount; s++) {
+            samples[s].push_back(ms[s]);
+        }
+        measured++;
+    }
+    if (measured == 0) {
+        cerr << "Error: No frames decoded from " << sources[0] << endl;
+    }
+    double runSeconds = chrono::duration<double>(chrono::steady_clock::now() - runBegin).count();
+    double fps = measured && runSeconds > 0 ? measured / runSeconds : 0.0;
+
+    Percentiles stages[StageCount];
+    cout << fixed << setprecision(3);
+    cout << "Backend " << backendName << ", decode path " << decodeSimdName() << ", " << measured << " frames" << endl;
+    cout << "stage           mean       p50       p90       p99       max" << endl;
+    for (int s = 0; s < StageCount; s++) {
+        stages[s] = summarize(samples[s]);
+        cout << left << setw(10) << benchStageNames[s] << right << setw(10) << stages[s].mean << setw(10)
+             << stages[s].p50 << setw(10) << stages[s].p90 << setw(10) << stages[s].p99 << setw(10)
+             << stages[s].max << endl;
+    }
+    cout << "Throughput: " << fps << " fps" << endl;
+    cout << "Startup: model load " << loadMs << " ms, first forward " << firstForwardMs << " ms" << endl;
+
+    // ByteTrack::update alone over synthetic crowds, for tuning the tracker without a model
+    struct SyntheticResult {
+        int people;
+        Percentiles update;
+        size_t tracks;
+    };
+    vector<SyntheticResult> synthetic;
+    mt19937 rng(42);
+    for (int people : {100, 500, 1000, 2000, 5000, 10000}) {
+        if (people > syntheticMax) break;
+        ByteTrack crowdTracker;
+        vector<Person> crowd = makeCrowd(people, rng);
+        vector<double> updateMs;
+        size_t tracks = 0;
+        for (int f = 0; f < syntheticFrames; f++) {
+            stepCrowd(crowd);
+            crowdDetections(crowd, rng, 2, detections);
+            auto begin = chrono::steady_clock::now();
+            tracks = crowdTracker.update(detections).size();
+            updateMs.push_back(elapsedMs(begin));
+        }
+        synthetic.push_back({people, summarize(updateMs), tracks});
+        cout << "Synthetic " << setw(6) << people << " people: update p50 " << synthetic.back().update.p50
+             << " ms, p99 " << synthetic.back().update.p99 << " ms" << endl;
+    }
+
+    ofstream json(jsonPath);
+    if (!json) {
+        cerr << "Error: Cannot write " << jsonPath << endl;
+        return -1;
+    }
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    json << fixed << setprecision(4);
+    json << "{\n  \"timestamp\": \"" << timestamp << "\",\n"
+         << "  \"opencv\": \"" << CV_VERSION << "\",\n"
+         << "  \"compiler\": " << jsonString(__VERSION__) << ",\n"
+         << "  \"backend\": " << jsonString(backendName) << ",\n"
+         << "  \"model\": " << jsonString(detectorConfig.model) << ",\n"
+         << "  \"threads\": " << detectorConfig.threads << ",\n"
+         << "  \"model_cache\": " << (detectorConfig.cacheDir.empty() ? "false" : "true") << ",\n"
+         << "  \"load_ms\": " << loadMs << ",\n"
+         << "  \"first_forward_ms\": " << firstForwardMs << ",\n"
+         << "  \"decode_path\": \"" << decodeSimdName() << "\",\n"
+         << "  \"input\": [" << preprocessConfig.inputSize.width << ", " << preprocessConfig.inputSize.height << "],\n"
+         << "  \"letterbox\": " << (preprocessConfig.letterbox ? "true" : "false") << ",\n"
+         << "  \"tiles\": " << tiles.size() << ",\n"
+         << "  \"sources\": [";
+    for (size_t i = 0; i < sources.size(); i++) {
+        json << (i ? ", " : "") << jsonString(sources[i]);
+    }
+    json << "],\n  \"frames\": " << measured << ",\n  \"warmup\": " << warmup << ",\n"
+         << "  \"throughput_fps\": " << fps << ",\n  \"stages\": {\n";
+    for (int s = 0; s < StageCount; s++) {
+        json << "    \"" << benchStageNames[s] << "\": ";
+        writePercentiles(json, stages[s]);
+        json << (s + 1 < StageCount ? ",\n" : "\n");
+    }
+    json << "  },\n  \"synthetic_tracker\": [\n";
+    for (size_t i = 0; i < synthetic.size(); i++) {
+        json << "    {\"people\": " << synthetic[i].people << ", \"frames\": " << syntheticFrames
+             << ", \"tracks\": " << synthetic[i].tracks << ", \"update\": ";
+        writePercentiles(json, synthetic[i].update);
+        json << "}" << (i + 1 < synthetic.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    cout << "Wrote " << jsonPath << endl;
+    return 0;
+}
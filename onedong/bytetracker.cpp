@@ -1,302 +1,136 @@
-#include "opencv2/videoio.hpp"
-#include <cmath>
-#include <opencv2/opencv.hpp>
-#include <opencv2/dnn.hpp>
-#include <opencv2/core/ocl.hpp>
-#include <iostream>
-#include <fstream>
-#include <curl/curl.h>
+#include "bytetracker.hpp"
+
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 
 using namespace cv;
-using namespace dnn;
 using namespace std;
 
-void sendHttpRequest(const string& url, const string& jsonPayload) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        cerr << "Failed to initialize CURL" << endl;
-        return;
-    }
-
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonPayload.c_str());
-
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        cerr << "CURL request failed: " << curl_easy_strerror(res) << endl;
-    }
-
-    curl_easy_cleanup(curl);
+bool setByteTrackParam(ByteTrackConfig& config, const string& name, float value) {
+    if (name == "max-kill") config.maxKillCount = static_cast<int>(value);
+    else if (name == "iou-high") config.iouThresholdHigh = value;
+    else if (name == "iou-low") config.iouThresholdLow = value;
+    else if (name == "conf-high") config.confThresholdHigh = value;
+    else if (name == "conf-low") config.confThresholdLow = value;
+    else return false;
+    return true;
 }
 
-struct Detection {
-    int id;
-    Rect bbox;
-    float confidence;
-    bool matched = false;
-    Scalar color;
-    int killCount = 0;
-};
-
-float computeIoU(const Rect& box1, const Rect& box2) {
-    float intersection = (box1 & box2).area();
-    float unionArea = box1.area() + box2.area() - intersection;
-    return intersection / unionArea;
+bool parseByteTrackParam(const string& text, ByteTrackConfig& config) {
+    size_t eq = text.find('=');
+    if (eq == string::npos) return false;
+    char* end = nullptr;
+    float value = strtof(text.c_str() + eq + 1, &end);
+    if (end == text.c_str() + eq + 1 || *end != '\0') return false;
+    return setByteTrackParam(config, text.substr(0, eq), value);
 }
 
-class ByteTrack {
-    private:
-        vector<Detection> activeTracks;
-        int nextID = 1;
-        int maxKillCount = 15;
-        float iouThresholdLow = 0.4;
-        float iouThresholdHigh = 0.3;
-        float confThresholdHigh = 0.6; // Threshold for high-confidence detections
-        float confThresholdLow = 0.1;  // Threshold for low-confidence detections
-    
-    public:
-        vector<Detection> update(vector<Detection>& detections) {
-            vector<Detection> highConfDetections;
-            vector<Detection> lowConfDetections;
-            vector<Detection> unmatchedTracks;
-    
-            // Separate high and low-confidence detections
-            for (auto& det : detections) {
-                if (det.confidence > confThresholdHigh) {
-                    highConfDetections.push_back(det);
-                } else if (det.confidence > confThresholdLow) {
-                    lowConfDetections.push_back(det);
-                }
-            }
-    
-            // Step 1: Match high-confidence detections to existing tracks
-            for (auto& track : activeTracks) {
-                track.matched = false; // Set all of the classes tracks to be unmatched
-
-                float highestIoU = 0.0;
-                Detection* bestDetection;
-                for (auto& det : highConfDetections) {
-                    float IoU = computeIoU(track.bbox, det.bbox);
-                    if (IoU > highestIoU) {
-                        highestIoU = IoU;
-                        bestDetection = &det;
-                    }
-                }
-
-                if (highestIoU > iouThresholdHigh) {
-                    track.bbox = bestDetection->bbox;
-                    track.confidence = bestDetection->confidence;
-
-                    track.killCount = 0;
-                    track.matched = true;
-                    bestDetection->matched = true;
-                }
-                
-                if (!track.matched) {
-                    
-                    highestIoU = 0.0;
-                    // Step 2: Attempt to assign unmatched tracks to low-confidence detections
-                    for (auto& det : lowConfDetections) {
-                        float IoU = computeIoU(track.bbox, det.bbox);
-                        if (IoU > highestIoU) {
-                            highestIoU = IoU;
-                            bestDetection = &det;
-                        }
-                    }
-                    if (highestIoU > iouThresholdLow) {
-                        track.bbox = bestDetection->bbox;
-                        track.confidence = bestDetection->confidence;
-    
-                        track.killCount = 0;
-                        track.matched = true;
-                        bestDetection->matched = true;
-                    }
-                }
-                
-            }
-    
-            // Step 3: Remove those who have been missing for longer than maxKillCount frames
-            for (auto it = activeTracks.begin(); it != activeTracks.end(); ) {
-                auto& track = *it;
-            
-                if (!track.matched) {
-                    track.killCount++;
-                    
-                    // If the track has been unmatched for too long, remove it
-                    if (track.killCount > maxKillCount) {
-                        // Track should be removed from activeTracks, so we erase it
-                        it = activeTracks.erase(it);  // erase returns the next iterator
-                    } else {
-                        // If not removed, just move to the next track
-                        ++it;
-                    }
-                } else {
-                    // If track is matched, move to the next track
-                    ++it;
-                }
-            }
-            
-    
-            // Step 4: Create new tracks for unmatched high-confidence detections
-            for (auto& det : highConfDetections) {
-                if (!det.matched) {
-                    det.id = nextID++;
-                    det.color = Scalar(rand() % 255, rand() % 255, rand() % 255);
-                    activeTracks.push_back(det);
-                }
-            }
-    
-            return activeTracks;
+// Optimal one-to-one assignment between the still unmatched tracks and the given detections
+void ByteTrack::associate(vector<Detection>& detections, float iouThreshold) {
+    candidateTracks.clear();
+    trackBoxes.clear();
+    trackDepths.clear();
+    for (int i = 0; i < static_cast<int>(activeTracks.size()); i++) {
+        if (!activeTracks.matched[i]) {
+            candidateTracks.push_back(i);
+            trackBoxes.push_back(activeTracks.boxes[i]);
+            trackDepths.push_back(activeTracks.depths[i]);
         }
-
-    };
-
-int main(int argc, char* argv[]) {
-    std::string imagePath = "WIN_20250303_10_21_48_Pro.mp4";
-    if (argc > 1) {
-        imagePath = argv[1];
-        std::cout << "Received image path: " << imagePath << '\n';
-    }
-
-    // Load YOLO model
-    Net net = readNet("yolov7-tiny.weights", "yolov7-tiny.cfg");
-
-    // Set the backend and target
-    if (cv::cuda::getCudaEnabledDeviceCount() > 0) {
-        // If CUDA is available, use it
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
-        cout << "Using CUDA backend" << endl;
-    } 
-    else if (cv::ocl::haveOpenCL()) {
-        // If OpenCL is available, use it
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_OPENCL);
-        cout << "Using OpenCL backend" << endl;
-    } 
-    else {
-        // Fall back to CPU if neither CUDA nor OpenCL is available
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-        cout << "Using CPU backend" << endl;
     }
 
-    vector<string> layerNames = net.getUnconnectedOutLayersNames();
-
-    // Load class labels (COCO dataset labels)
-    vector<string> classes;
-    ifstream ifs("coco.names");
-    string line;
-    while (getline(ifs, line)) {
-        classes.push_back(line);
+    detectionBoxes.clear();
+    detectionDepths.clear();
+    for (const auto& det : detections) {
+        detectionBoxes.push_back(det.bbox);
+        detectionDepths.push_back(det.depth);
     }
 
-    // Open the laptop camera (use 0 for default webcam)
-    VideoCapture cap(imagePath, cv::CAP_FFMPEG);
-    if (!cap.isOpened()) {
-        cerr << "Error: Cannot open webcam" << endl;
-        return -1;
+    matches.clear();
+    if (maxDepthGap > 0) {
+        matcher.match(trackBoxes, detectionBoxes, trackDepths, detectionDepths, maxDepthGap, iouThreshold, matches);
+    } else {
+        matcher.match(trackBoxes, detectionBoxes, iouThreshold, matches);
     }
 
-    ByteTrack tracker;
-    
-    while (true) {
-        Mat frame;
-        cap >> frame;
-        if (frame.empty()) break;
+    for (const auto& [trackIndex, detectionIndex] : matches) {
+        int track = candidateTracks[trackIndex];
+        Detection& det = detections[detectionIndex];
+        kalman.update(activeTracks.states[track], det.bbox);
+        activeTracks.boxes[track] = det.bbox;
+        activeTracks.confidences[track] = det.confidence;
+        if (det.depth > 0) {
+            activeTracks.depths[track] = det.depth;
+        }
 
-        vector<Detection> detections;
+        activeTracks.killCounts[track] = 0;
+        activeTracks.matched[track] = 1;
+        det.matched = true;
+    }
+}
 
-        // Prepare input blob for YOLOv7
-        Mat blob;
-        blobFromImage(frame, blob, 0.00392, Size(640, 640), Scalar(0, 0, 0), true, false);
-        net.setInput(blob);
+TrackView ByteTrack::update(vector<Detection>& detections) {
+    step(detections, 1.0f);
+    return TrackView(activeTracks);
+}
 
-        // Perform forward pass and get output layers
-        vector<Mat> outputs;
-        net.forward(outputs, layerNames);
+TrackView ByteTrack::update(vector<Detection>& detections, chrono::steady_clock::time_point timestamp) {
+    float steps = 1.0f;
+    if (framePeriod > 0 && lastFrame.time_since_epoch().count() != 0) {
+        double gap = chrono::duration<double>(timestamp - lastFrame).count();
+        // Never backwards, and never further than a coasting track would survive anyway
+        steps = static_cast<float>(min(max(gap / framePeriod, 0.0), static_cast<double>(config.maxKillCount)));
+    }
+    lastFrame = timestamp;
+    step(detections, steps);
+    return TrackView(activeTracks);
+}
 
-        vector<int> classIds;
-        vector<float> confidences;
-        vector<Rect> boxes;
+void ByteTrack::step(vector<Detection>& detections, float predictSteps) {
+    highConfDetections.clear();
+    lowConfDetections.clear();
 
-        // Process the outputs
-        for (const auto& output : outputs) {
-            for (int i = 0; i < output.rows; i++) {
-                const float* data = output.ptr<float>(i);
-                vector<float> scores(data + 5, data + output.cols);
-                int classId = max_element(scores.begin(), scores.end()) - scores.begin();
-                float confidence = scores[classId];; // Confidence score for each detected object
-    
-                if (confidence > 0.1 && classId == 0) {
-                    // The data format depends on YOLO model
-                    // YOLOv7 has 4 values for bbox (x_center, y_center, width, height) followed by class scores
-    
-                    int centerX = static_cast<int>(data[0] * frame.cols);
-                    int centerY = static_cast<int>(data[1] * frame.rows);
-                    int width = static_cast<int>(data[2] * frame.cols);
-                    int height = static_cast<int>(data[3] * frame.rows);
-    
-                    // Create a Rect bounding box around the detected object
-                    int x = centerX - width / 2;
-                    int y = centerY - height / 2;
-                    Rect box(x, y, width, height);
-    
-                    // Push detected class IDs, confidence, and bounding box coordinates
-                    confidences.push_back(confidence);
-                    boxes.push_back(box);
-                    classIds.push_back(0);  // Assuming we're detecting "people" (class 0 in COCO dataset)
-                }
-            }
+    // Separate high and low-confidence detections
+    for (auto& det : detections) {
+        if (det.confidence > config.confThresholdHigh) {
+            highConfDetections.push_back(det);
+        } else if (det.confidence > config.confThresholdLow) {
+            lowConfDetections.push_back(det);
         }
+    }
 
-        // Apply Non-Maximum Suppression (NMS) to remove overlapping bounding boxes
-        vector<int> indices;
-        dnn::NMSBoxes(boxes, confidences, 0.1, 0.65, indices);
-
-        // Store final detections with unique IDs
-        for (int i : indices) {
-            Detection detection;
-            detection.bbox = boxes[i];
-            detection.confidence = confidences[i];
-            detection.id = -1;  // ID will be assigned later during tracking
-            detections.push_back(detection);
+    // Move every track to where it should be now, so fast movers and skipped frames still overlap
+    for (size_t i = 0; i < activeTracks.size(); i++) {
+        KalmanState& state = activeTracks.states[i];
+        if (activeTracks.killCounts[i] > 0) {
+            state.mean(7) = 0; // A coasting track keeps walking but stops growing or shrinking
         }
+        kalman.predict(state, predictSteps);
+        activeTracks.boxes[i] = KalmanBoxFilter::toRect(state);
+        activeTracks.matched[i] = 0; // Set all of the classes tracks to be unmatched
+    }
 
-        vector<Detection> trackedObjects = tracker.update(detections);
+    // Step 1: Match high-confidence detections to existing tracks
+    associate(highConfDetections, config.iouThresholdHigh);
 
-        for (const auto& obj : trackedObjects) {
-            
-            rectangle(frame, obj.bbox, obj.color, 2);
-            putText(frame, "ID: " + to_string(obj.id), obj.bbox.tl(), FONT_HERSHEY_SIMPLEX, 0.5, obj.color, 2);
-        }
+    // Step 2: Attempt to assign unmatched tracks to low-confidence detections
+    associate(lowConfDetections, config.iouThresholdLow);
 
-        // Draw bounding boxes for detected humans
-        /*vector<Person> people;
-        for (int i : indices) {
-            Rect box = boxes[i];
-            Person person = Person({box.x, box.y}, {box.width, box.height});
-            people.push_back(person);
+    // Step 3: Remove those who have been missing for longer than maxKillCount frames.
+    // Coasting tracks stay at their predicted box.
+    for (size_t i = 0; i < activeTracks.size(); ) {
+        if (!activeTracks.matched[i] && ++activeTracks.killCounts[i] > config.maxKillCount) {
+            activeTracks.remove(i); // The last track moves into i and is looked at next
+        } else {
+            i++;
         }
-        tracker.update(people);
-        tracker.draw(frame);*/
-
-        // Show the output frame
-        imshow("Human Detection", frame);
+    }
 
-        // Break on 'q' key press
-        if (waitKey(1) == 'q') {
-            break;
+    // Step 4: Create new tracks for unmatched high-confidence detections
+    for (auto& det : highConfDetections) {
+        if (!det.matched) {
+            Scalar color(rand() % 255, rand() % 255, rand() % 255);
+            activeTracks.add(nextID++, det.bbox, det.confidence, det.depth, kalman.initiate(det.bbox), color);
         }
     }
-
-    cap.release();
-    destroyAllWindows();
-    return 0;
 }
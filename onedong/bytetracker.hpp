@@ -0,0 +1,74 @@
+#pragma once
+
+#include "assignment.hpp"
+#include "detection.hpp"
+#include "kalman.hpp"
+#include "track_pool.hpp"
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The thresholds worth tuning, see replay.cpp for sweeping them over recorded detections
+struct ByteTrackConfig {
+    int maxKillCount = 15;         // Frames a track coasts without a match before it is removed
+    float iouThresholdLow = 0.4;
+    float iouThresholdHigh = 0.3;
+    float confThresholdHigh = 0.6; // Threshold for high-confidence detections
+    float confThresholdLow = 0.1;  // Threshold for low-confidence detections
+};
+
+// Sets one of max-kill, iou-high, iou-low, conf-high or conf-low; false for any other name
+bool setByteTrackParam(ByteTrackConfig& config, const std::string& name, float value);
+// Parses "name=value" with a name as above
+bool parseByteTrackParam(const std::string& text, ByteTrackConfig& config);
+
+class ByteTrack {
+    private:
+        TrackPool activeTracks;
+        KalmanBoxFilter kalman;
+        int nextID = 1;
+        ByteTrackConfig config;
+        float maxDepthGap = 0;         // Stereo depth gate for association, 0 disables
+        double framePeriod = 0;        // Seconds, for turning capture time gaps into prediction steps
+        std::chrono::steady_clock::time_point lastFrame;
+
+        // Scratch space reused between frames
+        IoUMatcher matcher;
+        std::vector<Detection> highConfDetections;
+        std::vector<Detection> lowConfDetections;
+        std::vector<int> candidateTracks;
+        std::vector<cv::Rect> trackBoxes;
+        std::vector<cv::Rect> detectionBoxes;
+        std::vector<float> trackDepths;
+        std::vector<float> detectionDepths;
+        std::vector<std::pair<int, int>> matches;
+
+        void associate(std::vector<Detection>& detections, float iouThreshold);
+        void step(std::vector<Detection>& detections, float predictSteps);
+
+    public:
+        explicit ByteTrack(const ByteTrackConfig& config = ByteTrackConfig()) : config(config) {}
+
+        // Applies from the next update on; live tracks carry over
+        void setConfig(const ByteTrackConfig& next) { config = next; }
+
+        // Detections whose stereo depth differs from a track's by more than maxGap can't continue it
+        void setDepthGate(float maxGap) { maxDepthGap = maxGap; }
+
+        // Nominal time between frames, usually 1 / camera fps; 0 predicts one frame per update
+        void setFramePeriod(double seconds) { framePeriod = seconds; }
+
+        // Returns the live tracks, including coasting ones; the view is valid until the next update
+        TrackView update(std::vector<Detection>& detections);
+        // Same, for a frame captured at `timestamp`: with a frame period set, tracks are predicted
+        // across the real gap since the last frame, so frames dropped upstream don't make
+        // everyone appear to slow down
+        TrackView update(std::vector<Detection>& detections, std::chrono::steady_clock::time_point timestamp);
+        TrackView tracks() const { return TrackView(activeTracks); }
+
+        // Gives track i of the current view another id; re-identification uses it to hand a lost
+        // track's id to the track that replaced it
+        void reassignId(size_t i, int id) { activeTracks.ids[i] = id; }
+};
@@ -0,0 +1,379 @@
+#include "capture.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+bool parseCaptureSize(const string& text, int& width, int& height) {
+    int w, h;
+    if (sscanf(text.c_str(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) return false;
+    width = w;
+    height = h;
+    return true;
+}
+
+bool parsePixelFormat(const string& text, PixelFormat& format) {
+    if (text == "auto") format = PixelFormat::Auto;
+    else if (text == "mjpeg") format = PixelFormat::Mjpeg;
+    else if (text == "yuyv") format = PixelFormat::Yuyv;
+    else return false;
+    return true;
+}
+
+chrono::system_clock::time_point wallClockAt(chrono::steady_clock::time_point time) {
+    auto age = chrono::steady_clock::now() - time;
+    return chrono::system_clock::now() - chrono::duration_cast<chrono::system_clock::duration>(age);
+}
+
+static int xioctl(int fd, unsigned long request, void* arg) {
+    int result;
+    do {
+        result = ioctl(fd, request, arg);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+static bool isJpeg(uint32_t fourcc) {
+    return fourcc == V4L2_PIX_FMT_MJPEG || fourcc == V4L2_PIX_FMT_JPEG;
+}
+
+// Memory-mapped V4L2 streaming. The driver fills a ring of buffers; grab() dequeues one and keeps
+// it until the next grab(), so retrieve() decodes straight out of the driver's memory.
+class V4l2Capture : public CaptureSource {
+    public:
+        explicit V4l2Capture(const CaptureConfig& config) : config(config) {}
+        ~V4l2Capture() override;
+
+        bool open(const string& path);
+
+        bool grab() override;
+        bool retrieve(Mat& frame) override;
+        chrono::steady_clock::time_point timestamp() const override { return capturedAt; }
+        double fps() const override { return rate; }
+        uint64_t drained() const override { return drainedFrames.load(memory_order_relaxed); }
+        string describe() const override;
+
+    private:
+        struct Buffer {
+            void* start = nullptr;
+            size_t length = 0;
+        };
+
+        bool negotiateFormat();
+        bool startStreaming();
+        // 1 with a filled buffer, 0 when none is ready, -1 on error
+        int dequeue(v4l2_buffer& buf);
+        bool requeue(uint32_t index);
+        bool fail(const char* what);
+
+        CaptureConfig config;
+        string device;
+        int fd = -1;
+        uint32_t fourcc = 0;
+        int width = 0;
+        int height = 0;
+        int bytesPerLine = 0;
+        double rate = 0.0;
+        vector<Buffer> buffers;
+        bool streaming = false;
+
+        int held = -1; // Buffer index owned by us between grab() and the next grab()
+        uint32_t heldBytes = 0;
+        chrono::steady_clock::time_point capturedAt;
+        atomic<uint64_t> drainedFrames{0}; // Read by the stats and metrics threads
+};
+
+V4l2Capture::~V4l2Capture() {
+    if (streaming) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(fd, VIDIOC_STREAMOFF, &type);
+    }
+    for (auto& buffer : buffers) {
+        if (buffer.start) munmap(buffer.start, buffer.length);
+    }
+    if (fd >= 0) ::close(fd);
+}
+
+bool V4l2Capture::fail(const char* what) {
+    cerr << "Error: " << device << ": " << what << ": " << strerror(errno) << endl;
+    return false;
+}
+
+bool V4l2Capture::open(const string& path) {
+    device = path;
+    // Non-blocking, so draining stale buffers can stop as soon as the queue is empty
+    fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return fail("cannot open");
+
+    v4l2_capability caps{};
+    if (xioctl(fd, VIDIOC_QUERYCAP, &caps) < 0) return fail("not a V4L2 device");
+    uint32_t deviceCaps = caps.capabilities & V4L2_CAP_DEVICE_CAPS ? caps.device_caps : caps.capabilities;
+    if (!(deviceCaps & V4L2_CAP_VIDEO_CAPTURE) || !(deviceCaps & V4L2_CAP_STREAMING)) {
+        cerr << "Error: " << device << " can't stream video capture" << endl;
+        return false;
+    }
+    return negotiateFormat() && startStreaming();
+}
+
+bool V4l2Capture::negotiateFormat() {
+    bool hasMjpeg = false, hasYuyv = false;
+    v4l2_fmtdesc desc{};
+    desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    for (desc.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++) {
+        hasMjpeg |= isJpeg(desc.pixelformat);
+        hasYuyv |= desc.pixelformat == V4L2_PIX_FMT_YUYV;
+    }
+
+    uint32_t wanted = 0;
+    if (config.format != PixelFormat::Yuyv && hasMjpeg) {
+        wanted = V4L2_PIX_FMT_MJPEG;
+    } else if (config.format != PixelFormat::Mjpeg && hasYuyv) {
+        wanted = V4L2_PIX_FMT_YUYV;
+    } else {
+        const char* name = config.format == PixelFormat::Mjpeg ? "MJPEG"
+                           : config.format == PixelFormat::Yuyv ? "YUYV" : "MJPEG or YUYV";
+        cerr << "Error: " << device << " has no " << name << " mode" << endl;
+        return false;
+    }
+
+    v4l2_format fmt{};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_FMT, &fmt) < 0) return fail("cannot read format");
+    fmt.fmt.pix.pixelformat = wanted;
+    fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    if (config.width > 0 && config.height > 0) {
+        fmt.fmt.pix.width = config.width;
+        fmt.fmt.pix.height = config.height;
+    }
+    if (xioctl(fd, VIDIOC_S_FMT, &fmt) < 0) return fail("cannot set format");
+
+    // The driver picks the nearest mode it has
+    fourcc = fmt.fmt.pix.pixelformat;
+    width = static_cast<int>(fmt.fmt.pix.width);
+    height = static_cast<int>(fmt.fmt.pix.height);
+    bytesPerLine = static_cast<int>(fmt.fmt.pix.bytesperline);
+    if (!isJpeg(fourcc) && fourcc != V4L2_PIX_FMT_YUYV) {
+        cerr << "Error: " << device << " switched to an unsupported pixel format" << endl;
+        return false;
+    }
+    if (config.width > 0 && (width != config.width || height != config.height)) {
+        cerr << "Warning: " << device << " gives " << width << "x" << height << " instead of " << config.width
+             << "x" << config.height << endl;
+    }
+
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (config.fps > 0) {
+        parm.parm.capture.timeperframe.numerator = 1000;
+        parm.parm.capture.timeperframe.denominator = static_cast<uint32_t>(lround(config.fps * 1000));
+        xioctl(fd, VIDIOC_S_PARM, &parm); // Not every driver lets the rate be chosen
+    }
+    if (xioctl(fd, VIDIOC_G_PARM, &parm) == 0 && parm.parm.capture.timeperframe.numerator > 0) {
+        rate = static_cast<double>(parm.parm.capture.timeperframe.denominator) / parm.parm.capture.timeperframe.numerator;
+    }
+    return true;
+}
+
+bool V4l2Capture::startStreaming() {
+    v4l2_requestbuffers request{};
+    request.count = static_cast<uint32_t>(max(2, config.buffers));
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_REQBUFS, &request) < 0) return fail("cannot allocate buffers");
+    if (request.count < 2) {
+        cerr << "Error: " << device << " granted only " << request.count << " buffer" << endl;
+        return false;
+    }
+
+    buffers.resize(request.count);
+    for (uint32_t i = 0; i < request.count; i++) {
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) return fail("cannot query buffer");
+        void* start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+        if (start == MAP_FAILED) return fail("cannot map buffer");
+        buffers[i].start = start;
+        buffers[i].length = buf.length;
+        if (!requeue(i)) return false;
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_STREAMON, &type) < 0) return fail("cannot start streaming");
+    streaming = true;
+    return true;
+}
+
+int V4l2Capture::dequeue(v4l2_buffer& buf) {
+    buf = v4l2_buffer{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_DQBUF, &buf) == 0) return 1;
+    if (errno == EAGAIN) return 0;
+    fail("cannot dequeue buffer");
+    return -1;
+}
+
+bool V4l2Capture::requeue(uint32_t index) {
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    return xioctl(fd, VIDIOC_QBUF, &buf) == 0 || fail("cannot queue buffer");
+}
+
+bool V4l2Capture::grab() {
+    // The previous frame's buffer goes back to the driver only now, retrieve() may still have read it
+    if (held >= 0) {
+        if (!requeue(static_cast<uint32_t>(held))) return false;
+        held = -1;
+    }
+
+    v4l2_buffer buf;
+    for (;;) {
+        int got = dequeue(buf);
+        if (got < 0) return false;
+        if (got == 0) {
+            pollfd waiter{fd, POLLIN, 0};
+            int ready = poll(&waiter, 1, 2000);
+            if (ready == 0) {
+                cerr << "Error: " << device << ": no frame for 2 s" << endl;
+                return false;
+            }
+            if (ready < 0 && errno != EINTR) return fail("poll");
+            continue;
+        }
+
+        // Everything still queued behind it is newer; keep only the last one
+        if (config.latestOnly) {
+            v4l2_buffer newer;
+            while ((got = dequeue(newer)) == 1) {
+                if (!requeue(buf.index)) return false;
+                drainedFrames.fetch_add(1, memory_order_relaxed);
+                buf = newer;
+            }
+            if (got < 0) return false;
+        }
+
+        // Corrupt transfers are flagged rather than dropped by some drivers
+        if (buf.flags & V4L2_BUF_FLAG_ERROR || buf.bytesused == 0) {
+            if (!requeue(buf.index)) return false;
+            continue;
+        }
+        break;
+    }
+
+    held = static_cast<int>(buf.index);
+    heldBytes = buf.bytesused;
+    // The driver stamps the buffer when its first byte arrives, on the clock steady_clock reads
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        capturedAt = chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::seconds(buf.timestamp.tv_sec) + chrono::microseconds(buf.timestamp.tv_usec)));
+    } else {
+        capturedAt = chrono::steady_clock::now();
+    }
+    return true;
+}
+
+bool V4l2Capture::retrieve(Mat& frame) {
+    if (held < 0) return false;
+    const Buffer& buffer = buffers[held];
+    if (isJpeg(fourcc)) {
+        Mat encoded(1, static_cast<int>(heldBytes), CV_8U, buffer.start);
+        imdecode(encoded, IMREAD_COLOR, &frame);
+        return !frame.empty();
+    }
+    Mat yuyv(height, width, CV_8UC2, buffer.start, static_cast<size_t>(bytesPerLine));
+    cvtColor(yuyv, frame, COLOR_YUV2BGR_YUYV);
+    return true;
+}
+
+string V4l2Capture::describe() const {
+    ostringstream text;
+    text << device << ": V4L2 " << width << "x" << height << " " << (isJpeg(fourcc) ? "MJPEG" : "YUYV");
+    if (rate > 0) text << " at " << rate << " fps";
+    text << ", " << buffers.size() << " buffers" << (config.latestOnly ? ", latest frame only" : "");
+    return text.str();
+}
+
+// Files and network streams through FFmpeg
+class VideoCaptureSource : public CaptureSource {
+    public:
+        bool open(const string& path, const CaptureConfig& config) {
+            source = path;
+            live = path.find("://") != string::npos;
+            if (!cap.open(path, CAP_FFMPEG)) return false;
+            if (config.width > 0 && config.height > 0) {
+                cap.set(CAP_PROP_FRAME_WIDTH, config.width);
+                cap.set(CAP_PROP_FRAME_HEIGHT, config.height);
+            }
+            rate = cap.get(CAP_PROP_FPS);
+            start = chrono::steady_clock::now();
+            return true;
+        }
+
+        bool grab() override {
+            if (!cap.grab()) return false;
+            grabInstant = chrono::steady_clock::now();
+            if (live) {
+                capturedAt = grabInstant;
+            } else {
+                // A file plays in media time, however fast it is decoded
+                capturedAt = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                         chrono::duration<double, milli>(cap.get(CAP_PROP_POS_MSEC)));
+            }
+            return true;
+        }
+
+        bool retrieve(Mat& frame) override { return cap.retrieve(frame) && !frame.empty(); }
+        chrono::steady_clock::time_point timestamp() const override { return capturedAt; }
+        chrono::steady_clock::time_point grabbedAt() const override { return grabInstant; }
+        double fps() const override { return rate; }
+        string describe() const override { return source + ": FFmpeg" + (live ? " stream" : " file"); }
+
+    private:
+        VideoCapture cap;
+        string source;
+        bool live = false;
+        double rate = 0.0;
+        chrono::steady_clock::time_point start;
+        chrono::steady_clock::time_point capturedAt;
+        chrono::steady_clock::time_point grabInstant;
+};
+
+unique_ptr<CaptureSource> openCapture(const string& source, const CaptureConfig& config) {
+    bool isIndex = !source.empty() && all_of(source.begin(), source.end(), [](unsigned char c) { return isdigit(c); });
+    if (isIndex || source.rfind("/dev/video", 0) == 0) {
+        auto camera = make_unique<V4l2Capture>(config);
+        if (!camera->open(isIndex ? "/dev/video" + source : source)) return nullptr;
+        return camera;
+    }
+
+    auto capture = make_unique<VideoCaptureSource>();
+    if (!capture->open(source, config)) {
+        cerr << "Error: Cannot open source " << source << endl;
+        return nullptr;
+    }
+    return capture;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+enum class PixelFormat {
+    Auto,  // MJPEG when the camera offers it, otherwise YUYV
+    Mjpeg, // Compressed on the camera: high resolutions at full rate over USB 2, costs a JPEG decode
+    Yuyv,  // Uncompressed: no decode, but bandwidth-limited to lower resolutions or rates
+};
+
+struct CaptureConfig {
+    int width = 0; // 0 keeps the device's current size
+    int height = 0;
+    double fps = 0.0; // 0 keeps the device's current rate
+    PixelFormat format = PixelFormat::Auto;
+    int buffers = 4; // V4L2 driver buffers
+    // Drain everything queued and hand out only the newest frame, so a slow consumer always sees
+    // the present rather than a backlog
+    bool latestOnly = false;
+};
+
+// Parses "WIDTHxHEIGHT"
+bool parseCaptureSize(const std::string& text, int& width, int& height);
+// Parses "auto", "mjpeg" or "yuyv"
+bool parsePixelFormat(const std::string& text, PixelFormat& format);
+
+// Where frames come from. grab() and retrieve() split like cv::VideoCapture's, so several
+// sources can be grabbed back to back before any of them is decoded.
+class CaptureSource {
+    public:
+        virtual ~CaptureSource() = default;
+
+        // Waits for the next frame. Returns false at end of stream or on a device error.
+        virtual bool grab() = 0;
+        // Decodes the grabbed frame into frame, reusing its buffer
+        virtual bool retrieve(cv::Mat& frame) = 0;
+        // When the grabbed frame was captured, on the steady (CLOCK_MONOTONIC) clock
+        virtual std::chrono::steady_clock::time_point timestamp() const = 0;
+        // When grab() returned, for measuring latency. Files are stamped in media time, so their
+        // timestamp() says nothing about how long a frame has been in the pipeline.
+        virtual std::chrono::steady_clock::time_point grabbedAt() const { return timestamp(); }
+
+        // Nominal frame rate, 0 when unknown
+        virtual double fps() const = 0;
+        // Frames thrown away unseen under latestOnly
+        virtual uint64_t drained() const { return 0; }
+        virtual std::string describe() const = 0;
+
+        bool read(cv::Mat& frame) { return grab() && retrieve(frame); }
+};
+
+// Streams "0" or "/dev/videoN" straight from V4L2 through mmap'd driver buffers, with the driver's
+// capture timestamps. Anything else (files, RTSP URLs) goes through cv::VideoCapture and FFmpeg.
+// Prints the reason and returns null when the source can't be opened.
+std::unique_ptr<CaptureSource> openCapture(const std::string& source, const CaptureConfig& config = CaptureConfig());
+
+// The wall-clock time of a steady-clock instant in the recent past, for event timestamps
+std::chrono::system_clock::time_point wallClockAt(std::chrono::steady_clock::time_point time);
@@ -0,0 +1,132 @@
+#include "counter.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+bool parseZone(const string& text, CountingZone& zone) {
+    size_t colon = text.rfind(':');
+    if (colon == string::npos) return false;
+    size_t sourceColon = text.find(':');
+    if (sourceColon != colon && text.find(':', sourceColon + 1) != colon) return false;
+    zone.source = sourceColon == colon ? -1 : atoi(text.substr(0, sourceColon).c_str());
+    zone.entrance = atoi(text.substr(sourceColon == colon ? 0 : sourceColon + 1).c_str());
+
+    vector<float> values;
+    stringstream ss(text.substr(colon + 1));
+    string item;
+    while (getline(ss, item, ',')) {
+        values.push_back(static_cast<float>(atof(item.c_str())));
+    }
+    if (values.size() < 4 || values.size() % 2 != 0) return false;
+
+    zone.polygon.clear();
+    if (values.size() == 4) {
+        zone.a = Point2f(values[0], values[1]);
+        zone.b = Point2f(values[2], values[3]);
+    } else {
+        for (size_t i = 0; i < values.size(); i += 2) {
+            zone.polygon.emplace_back(values[i], values[i + 1]);
+        }
+    }
+    return true;
+}
+
+vector<CountingZone> zonesForSource(const vector<CountingZone>& zones, int source) {
+    vector<CountingZone> own;
+    for (const auto& zone : zones) {
+        if (zone.source < 0 || zone.source == source) own.push_back(zone);
+    }
+    return own;
+}
+
+LineCounter::LineCounter(vector<CountingZone> zones) : countingZones(std::move(zones)) {}
+
+void LineCounter::setZones(vector<CountingZone> zones) {
+    countingZones = std::move(zones);
+    for (auto& entry : states) {
+        entry.second.side.clear();
+    }
+}
+
+// Positive inside, negative outside, in pixels
+float LineCounter::signedDistance(const CountingZone& zone, Point2f p) const {
+    if (!zone.polygon.empty()) {
+        return static_cast<float>(pointPolygonTest(zone.polygon, p, true));
+    }
+
+    Point2f d = zone.b - zone.a;
+    float length = sqrt(d.x * d.x + d.y * d.y);
+    if (length <= 0) return 0;
+
+    // Beyond the ends of the segment the person is walking past the door, not through it
+    Point2f ap = p - zone.a;
+    float t = (ap.x * d.x + ap.y * d.y) / (length * length);
+    if (t < 0 || t > 1) return 0;
+
+    // Image y points down, so a positive cross product is the left-hand side of a -> b on screen
+    return (ap.x * d.y - ap.y * d.x) / length;
+}
+
+void LineCounter::update(const TrackView& tracks, chrono::system_clock::time_point time,
+                         vector<CrossingEvent>& events) {
+    frame++;
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks.killCount(i) > 0) continue;
+
+        int trackId = tracks.id(i);
+        const Rect& box = tracks.bbox(i);
+        TrackState& state = states[trackId];
+        if (state.side.empty()) {
+            state.side.assign(countingZones.size(), 0);
+        }
+        state.lastFrame = frame;
+
+        Point2f center(box.x + box.width * 0.5f, box.y + box.height * 0.5f);
+        state.history[state.historyNext] = center;
+        state.historyNext = (state.historyNext + 1) % historyLength;
+        state.historySize = min(state.historySize + 1, historyLength);
+
+        Point2f smoothed(0, 0);
+        for (int h = 0; h < state.historySize; h++) {
+            smoothed.x += state.history[h].x;
+            smoothed.y += state.history[h].y;
+        }
+        smoothed.x /= state.historySize;
+        smoothed.y /= state.historySize;
+
+        for (size_t z = 0; z < countingZones.size(); z++) {
+            const CountingZone& zone = countingZones[z];
+            float distance = signedDistance(zone, smoothed);
+
+            int8_t side = 0;
+            if (distance > zone.hysteresis) side = 1;
+            else if (distance < -zone.hysteresis) side = -1;
+            if (side == 0 || side == state.side[z]) continue;
+
+            // The first settled side just initialises the track, a change of side is a crossing
+            if (state.side[z] != 0) {
+                EventKind kind = side > 0 ? EventKind::Entry : EventKind::Exit;
+                events.push_back({trackId, zone.entrance, kind, time});
+                if (kind == EventKind::Entry) entryCount++;
+                else exitCount++;
+            }
+            state.side[z] = side;
+        }
+    }
+
+    // Forget tracks ByteTrack has dropped; sweeping every few frames keeps this amortised constant
+    if (frame % 32 == 0) {
+        for (auto it = states.begin(); it != states.end(); ) {
+            if (frame - it->second.lastFrame > retention) {
+                it = states.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "track_pool.hpp"
+#include "uplink.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A counting boundary for one entrance. Either a line segment a -> b, where the left-hand side
+// (seen from a towards b) is inside, or a polygon that is inside. Coordinates are frame pixels.
+struct CountingZone {
+    int source = -1; // Index of the source it is drawn on, -1 when there is only one
+    int entrance = 1;
+    cv::Point2f a;
+    cv::Point2f b;
+    std::vector<cv::Point2f> polygon; // Used instead of the line when not empty
+    float hysteresis = 12.0f;         // Distance in pixels a centroid must clear on either side
+};
+
+// Parses "entrance:x1,y1,x2,y2" as a line, or "entrance:x1,y1,x2,y2,x3,y3,..." as a polygon.
+// A leading "source:" binds the zone to the source with that index, for several cameras.
+bool parseZone(const std::string& text, CountingZone& zone);
+
+// The zones that count on one source: those bound to it and those bound to none
+std::vector<CountingZone> zonesForSource(const std::vector<CountingZone>& zones, int source);
+
+struct CrossingEvent {
+    int trackId;
+    int entrance;
+    EventKind kind;
+    std::chrono::system_clock::time_point time;
+};
+
+// Turns tracks into entry/exit events. Each track keeps a small ring of recent centroids; the
+// smoothed position has to move from one side of a zone, through the hysteresis band, to the other
+// before an event fires, so jitter near the line can't count the same person twice.
+// Work per track per frame is constant.
+class LineCounter {
+    public:
+        static constexpr int historyLength = 4;
+
+        explicit LineCounter(std::vector<CountingZone> zones = {});
+
+        // Only tracks seen this frame (killCount 0) move; coasting tracks keep their last side
+        void update(const TrackView& tracks, std::chrono::system_clock::time_point time,
+                    std::vector<CrossingEvent>& events);
+
+        // Swaps the zones between frames. Counts so far are kept; tracks settle on a side of the
+        // new zones before they can cross them.
+        void setZones(std::vector<CountingZone> zones);
+
+        // Frames a track can go unseen before its side is forgotten (default 64). Must cover every
+        // gap after which the same id can come back, such as ReID giving a lost id back.
+        void setRetention(uint64_t frames) { retention = frames; }
+
+        const std::vector<CountingZone>& zones() const { return countingZones; }
+        int entries() const { return entryCount; }
+        int exits() const { return exitCount; }
+
+    private:
+        struct TrackState {
+            std::array<cv::Point2f, historyLength> history;
+            int historySize = 0;
+            int historyNext = 0;
+            uint64_t lastFrame = 0;
+            std::vector<int8_t> side; // Per zone: -1 outside, 1 inside, 0 not settled yet
+        };
+
+        float signedDistance(const CountingZone& zone, cv::Point2f p) const;
+
+        std::vector<CountingZone> countingZones;
+        std::unordered_map<int, TrackState> states;
+        uint64_t frame = 0;
+        uint64_t retention = 64;
+        int entryCount = 0;
+        int exitCount = 0;
+};
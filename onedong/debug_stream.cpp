@@ -0,0 +1,127 @@
+#include "debug_stream.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <cstdlib>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+DebugStream::DebugStream(int port, double fps, int channelCount)
+    : server(port),
+      interval(chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / max(fps, 0.1)))) {
+    for (int i = 0; i < channelCount; i++) {
+        channels.push_back(make_unique<Channel>());
+    }
+    server.handle("/stream", [this](int fd, const HttpRequest& request) {
+        int channel = request.path.size() > 8 ? atoi(request.path.c_str() + 8) : 0;
+        if (channel < 0 || channel >= static_cast<int>(channels.size())) {
+            HttpServer::sendResponse(fd, 404, "text/plain", "No such camera\n");
+            return;
+        }
+        streamClient(fd, channel);
+    });
+}
+
+DebugStream::~DebugStream() {
+    stop();
+}
+
+bool DebugStream::start() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        running = true;
+    }
+    encoder = thread(&DebugStream::encodeLoop, this);
+    return server.start();
+}
+
+void DebugStream::stop() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
+    }
+    rawAvailable.notify_all();
+    jpegAvailable.notify_all();
+    if (encoder.joinable()) {
+        encoder.join();
+    }
+    server.stop();
+}
+
+bool DebugStream::wantsFrame(int channel) {
+    Channel& ch = *channels[channel];
+    if (ch.clients.load(memory_order_relaxed) == 0) return false;
+    return chrono::steady_clock::now() - ch.lastPublish >= interval;
+}
+
+void DebugStream::publish(const Mat& frame, int channel) {
+    Channel& ch = *channels[channel];
+    ch.lastPublish = chrono::steady_clock::now();
+    {
+        lock_guard<std::mutex> lock(mutex);
+        frame.copyTo(ch.raw); // Reuses the buffer after the first frame
+        ch.rawReady = true;
+    }
+    rawAvailable.notify_one();
+}
+
+void DebugStream::encodeLoop() {
+    const vector<int> params = {IMWRITE_JPEG_QUALITY, 70};
+    Mat frame;
+    unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        Channel* ready = nullptr;
+        for (auto& ch : channels) {
+            if (ch->rawReady) ready = ch.get();
+        }
+        if (!ready) {
+            rawAvailable.wait(lock);
+            continue;
+        }
+
+        ready->rawReady = false;
+        swap(frame, ready->raw);
+        lock.unlock();
+
+        auto jpeg = make_shared<vector<uchar>>();
+        imencode(".jpg", frame, *jpeg, params);
+
+        lock.lock();
+        ready->jpeg = std::move(jpeg);
+        ready->sequence++;
+        jpegAvailable.notify_all();
+    }
+}
+
+void DebugStream::streamClient(int fd, int channel) {
+    static const string header =
+        "HTTP/1.0 200 OK\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n\r\n";
+    if (!HttpServer::writeAll(fd, header.data(), header.size())) return;
+
+    Channel& ch = *channels[channel];
+    ch.clients++;
+    uint64_t seen = 0;
+    while (true) {
+        shared_ptr<const vector<uchar>> jpeg;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            jpegAvailable.wait(lock, [&] { return !running || ch.sequence != seen; });
+            if (!running) break;
+            seen = ch.sequence;
+            jpeg = ch.jpeg;
+        }
+
+        string part = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " + to_string(jpeg->size()) + "\r\n\r\n";
+        if (!HttpServer::writeAll(fd, part.data(), part.size()) ||
+            !HttpServer::writeAll(fd, jpeg->data(), jpeg->size()) ||
+            !HttpServer::writeAll(fd, "\r\n", 2)) {
+            break;
+        }
+    }
+    ch.clients--;
+}
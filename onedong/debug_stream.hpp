@@ -0,0 +1,53 @@
+#pragma once
+
+#include "http_server.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Serves annotated frames as an MJPEG stream for looking at a headless unit.
+// GET /stream shows channel 0, /stream/<n> shows channel n (one channel per camera).
+// Costs nothing while nobody watches: wantsFrame() is false without a client, and with one it
+// is true at most `fps` times a second. JPEG encoding happens on the stream's own thread.
+class DebugStream {
+    public:
+        DebugStream(int port, double fps, int channels = 1);
+        ~DebugStream();
+
+        bool start();
+        void stop();
+
+        // Cheap check for the frame loop, call before drawing anything
+        bool wantsFrame(int channel = 0);
+        // Copies the annotated frame and returns immediately
+        void publish(const cv::Mat& frame, int channel = 0);
+
+    private:
+        struct Channel {
+            std::atomic<int> clients{0};
+            std::chrono::steady_clock::time_point lastPublish{};
+            cv::Mat raw;                                   // Guarded by mutex
+            bool rawReady = false;
+            std::shared_ptr<const std::vector<uchar>> jpeg; // Guarded by mutex
+            uint64_t sequence = 0;
+        };
+
+        void encodeLoop();
+        void streamClient(int fd, int channel);
+
+        HttpServer server;
+        std::chrono::steady_clock::duration interval;
+        std::vector<std::unique_ptr<Channel>> channels;
+        std::mutex mutex;
+        std::condition_variable rawAvailable;
+        std::condition_variable jpegAvailable;
+        std::thread encoder;
+        bool running = false;
+};
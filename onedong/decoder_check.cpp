@@ -0,0 +1,129 @@
+// Checks the YOLO row decoder: the scalar path and the dispatched SIMD path against the original
+// per-row max_element loop, on random output blocks and on tie-heavy ones (few distinct scores,
+// person tied with other classes, scores equal to the threshold, NaNs). Exits non-zero on any
+// difference in the boxes or scores kept.
+#include "yolo_decoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// The decode `main` ran before the SIMD rewrite: argmax over all classes, then the threshold
+static void decodeReference(const float* rows, int rowCount, int stride, const DecodeParams& params, DecodeBuffer& out) {
+    out.reserve(out.count + rowCount);
+    for (int i = 0; i < rowCount; i++) {
+        const float* data = rows + static_cast<size_t>(i) * stride;
+        vector<float> scores(data + 5, data + stride);
+        int classId = max_element(scores.begin(), scores.end()) - scores.begin();
+        float confidence = scores[classId];
+        if (confidence > params.confThreshold && classId == 0) {
+            int centerX = static_cast<int>(data[0] * params.scaleX + params.offsetX);
+            int centerY = static_cast<int>(data[1] * params.scaleY + params.offsetY);
+            int width = static_cast<int>(data[2] * params.scaleX);
+            int height = static_cast<int>(data[3] * params.scaleY);
+
+            size_t k = out.count++;
+            out.x[k] = static_cast<float>(centerX - width / 2);
+            out.y[k] = static_cast<float>(centerY - height / 2);
+            out.w[k] = static_cast<float>(width);
+            out.h[k] = static_cast<float>(height);
+            out.conf[k] = confidence;
+        }
+    }
+}
+
+static bool sameCandidates(const DecodeBuffer& a, const DecodeBuffer& b) {
+    if (a.count != b.count) return false;
+    for (size_t i = 0; i < a.count; i++) {
+        if (a.x[i] != b.x[i] || a.y[i] != b.y[i] || a.w[i] != b.w[i] || a.h[i] != b.h[i] || a.conf[i] != b.conf[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Scores spread evenly, with about one row in eight given a strong person score
+static void fillRandom(vector<float>& rows, int stride, mt19937& rng) {
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < rows.size(); i++) {
+        rows[i] = unit(rng);
+        if (i % stride >= 5) rows[i] *= 0.3f;
+    }
+    for (size_t row = 0; row < rows.size() / stride; row += 1 + rng() % 15) {
+        rows[row * stride + 5] = 0.3f + 0.7f * unit(rng);
+    }
+}
+
+// Scores from a handful of values including the threshold, so person ties the best other class
+// on many rows; a few NaNs among the other classes
+static void fillTies(vector<float>& rows, int stride, float threshold, mt19937& rng) {
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float levels[] = {0.0f, threshold, 0.25f, 0.5f, 0.5f, 0.75f};
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i % stride < 5) {
+            rows[i] = unit(rng);
+        } else if (i % stride > 5 && rng() % 64 == 0) {
+            rows[i] = numeric_limits<float>::quiet_NaN();
+        } else {
+            rows[i] = levels[rng() % 6];
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int rowCount = 25200; // Rows of a 640x640 YOLOv7 output
+    int seeds = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rowCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) seeds = atoi(argv[++i]);
+    }
+
+    DecodeParams params;
+    params.scaleX = 1920.0f;
+    params.scaleY = 1080.0f;
+    params.offsetX = 3.0f;
+
+    cout << "simd: " << decodeSimdName() << endl;
+    cout << " block  classes    rows  kept  scalar  simd" << endl;
+    bool allIdentical = true;
+    for (const char* block : {"random", "ties"}) {
+        // 80 COCO classes, a single class, and counts that leave SIMD tails of every length
+        for (int classes : {80, 1, 2, 7, 8, 9, 15, 17}) {
+            const int stride = 5 + classes;
+            // Odd row counts leave a scalar tail after the SIMD blocks too
+            for (int rows : {rowCount, rowCount + 7}) {
+                size_t kept = 0;
+                bool scalarSame = true;
+                bool simdSame = true;
+                for (int seed = 0; seed < seeds; seed++) {
+                    mt19937 rng(seed * 1000 + classes);
+                    vector<float> data(static_cast<size_t>(rows) * stride);
+                    if (strcmp(block, "random") == 0) fillRandom(data, stride, rng);
+                    else fillTies(data, stride, params.confThreshold, rng);
+
+                    DecodeBuffer reference, scalar, simd;
+                    decodeReference(data.data(), rows, stride, params, reference);
+                    decodePersonRows(data.data(), rows, stride, params, scalar, DecodePath::Scalar);
+                    decodePersonRows(data.data(), rows, stride, params, simd, DecodePath::Auto);
+                    kept += reference.count;
+                    scalarSame = scalarSame && sameCandidates(scalar, reference);
+                    simdSame = simdSame && sameCandidates(simd, reference);
+                }
+                allIdentical = allIdentical && scalarSame && simdSame;
+                cout << setw(6) << block << setw(9) << classes << setw(8) << rows << setw(6) << kept / seeds
+                     << setw(8) << (scalarSame ? "yes" : "NO") << setw(6) << (simdSame ? "yes" : "NO") << endl;
+            }
+        }
+    }
+    cout << (allIdentical ? "All paths identical to max_element" : "MISMATCH against max_element") << endl;
+    return allIdentical ? 0 : 1;
+}
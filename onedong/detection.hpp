@@ -0,0 +1,18 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+// One detector box for one frame. Tracks live in a TrackPool (track_pool.hpp).
+struct Detection {
+    int id;
+    cv::Rect bbox;
+    float confidence;
+    bool matched = false;
+    float depth = 0.0f; // From the stereo stage, in calibration units; 0 when unknown
+};
+
+inline float computeIoU(const cv::Rect& box1, const cv::Rect& box2) {
+    float intersection = (box1 & box2).area();
+    float unionArea = box1.area() + box2.area() - intersection;
+    return intersection / unionArea;
+}
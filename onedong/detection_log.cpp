@@ -0,0 +1,174 @@
+#include "detection_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cv;
+using namespace std;
+
+static const char magic[4] = {'O', 'D', 'D', 'L'};
+static const uint32_t version = 1;
+static const size_t headerSize = 16;
+static const size_t frameHeaderSize = 12;
+static const size_t detectionSize = 12;
+
+template <typename T>
+static void put(char*& out, T value) {
+    memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+}
+
+template <typename T>
+static T get(const char*& in) {
+    T value;
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+static int16_t clampShort(int value) {
+    return static_cast<int16_t>(min(max(value, -32768), 32767));
+}
+
+static uint16_t clampUnsigned(float value) {
+    return static_cast<uint16_t>(min(max(lround(value), 0L), 65535L));
+}
+
+// Bytes of whole frames after the header; a partly written last frame is left out
+static size_t completeLength(const char* data, size_t size) {
+    size_t pos = headerSize;
+    while (pos + frameHeaderSize <= size) {
+        uint16_t count;
+        memcpy(&count, data + pos + 8, sizeof(count));
+        size_t frameSize = frameHeaderSize + count * detectionSize;
+        if (pos + frameSize > size) break;
+        pos += frameSize;
+    }
+    return pos;
+}
+
+static bool validHeader(const char* data, size_t size) {
+    uint32_t fileVersion;
+    if (size < headerSize || memcmp(data, magic, sizeof(magic)) != 0) return false;
+    memcpy(&fileVersion, data + 4, sizeof(fileVersion));
+    return fileVersion == version;
+}
+
+DetectionLogWriter::~DetectionLogWriter() {
+    close();
+}
+
+bool DetectionLogWriter::open(const string& path, double fps) {
+    close();
+
+    size_t keep = 0;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && st.st_size > 0) {
+        MappedFile existing;
+        if (!existing.open(path) || !validHeader(existing.data(), existing.size())) {
+            cerr << "Error: " << path << " exists and is not a detection log of version " << version << endl;
+            return false;
+        }
+        // Drop a frame a crash cut short, or everything appended after it would be misread
+        keep = completeLength(existing.data(), existing.size());
+        if (keep < existing.size() && truncate(path.c_str(), keep) != 0) {
+            cerr << "Error: Cannot repair " << path << ": " << strerror(errno) << endl;
+            return false;
+        }
+    }
+
+    file = fopen(path.c_str(), keep ? "ab" : "wb");
+    if (!file) {
+        cerr << "Error: Cannot write detection log " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    if (!keep) {
+        char header[headerSize];
+        char* out = header;
+        memcpy(out, magic, sizeof(magic));
+        out += sizeof(magic);
+        put<uint32_t>(out, version);
+        put<double>(out, fps);
+        fwrite(header, 1, headerSize, file);
+    }
+    frames = 0;
+    return true;
+}
+
+void DetectionLogWriter::close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void DetectionLogWriter::write(chrono::system_clock::time_point time, bool inferred,
+                               const vector<Detection>& detections) {
+    if (!file) return;
+
+    size_t count = min<size_t>(detections.size(), 65535);
+    buffer.resize(frameHeaderSize + count * detectionSize);
+    char* out = buffer.data();
+    put<int64_t>(out, chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count());
+    put<uint16_t>(out, static_cast<uint16_t>(count));
+    put<uint16_t>(out, inferred ? 1 : 0);
+    for (size_t i = 0; i < count; i++) {
+        const Detection& det = detections[i];
+        put<int16_t>(out, clampShort(det.bbox.x));
+        put<int16_t>(out, clampShort(det.bbox.y));
+        put<int16_t>(out, clampShort(det.bbox.width));
+        put<int16_t>(out, clampShort(det.bbox.height));
+        put<uint16_t>(out, clampUnsigned(det.confidence * 65535.0f));
+        put<uint16_t>(out, clampUnsigned(det.depth));
+    }
+    fwrite(buffer.data(), 1, buffer.size(), file);
+    frames++;
+}
+
+bool DetectionLogReader::open(const string& path) {
+    if (!mapping.open(path)) {
+        cerr << "Error: Cannot open detection log " << path << endl;
+        return false;
+    }
+    if (!validHeader(mapping.data(), mapping.size())) {
+        cerr << "Error: " << path << " is not a detection log of version " << version << endl;
+        mapping.close();
+        return false;
+    }
+    const char* in = mapping.data() + 8;
+    frameRate = get<double>(in);
+    length = completeLength(mapping.data(), mapping.size());
+    return true;
+}
+
+DetectionLogReader::Cursor::Cursor(const DetectionLogReader& log)
+    : pos(log.mapping.data() + headerSize),
+      end(log.mapping.data() + log.length) {}
+
+bool DetectionLogReader::Cursor::next(DetectionLogFrame& frame) {
+    if (pos >= end) return false;
+
+    frame.time = chrono::system_clock::time_point(
+        chrono::duration_cast<chrono::system_clock::duration>(chrono::nanoseconds(get<int64_t>(pos))));
+    uint16_t count = get<uint16_t>(pos);
+    frame.inferred = get<uint16_t>(pos) & 1;
+    frame.detections.resize(count);
+    for (uint16_t i = 0; i < count; i++) {
+        Detection& det = frame.detections[i];
+        det.id = i;
+        det.bbox.x = get<int16_t>(pos);
+        det.bbox.y = get<int16_t>(pos);
+        det.bbox.width = get<int16_t>(pos);
+        det.bbox.height = get<int16_t>(pos);
+        det.confidence = get<uint16_t>(pos) / 65535.0f;
+        det.depth = get<uint16_t>(pos);
+        det.matched = false;
+    }
+    return true;
+}
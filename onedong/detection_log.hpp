@@ -0,0 +1,75 @@
+#pragma once
+
+#include "detection.hpp"
+#include "model_cache.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Per-frame detections on disk, so tracking and counting can be re-run without the network.
+//
+// Layout, little-endian, append-only:
+//   header:  "ODDL", uint32 version, float64 camera fps (0 unknown)
+//   frames:  int64 capture time (wall clock, ns since the epoch), uint16 detection count, uint16 flags,
+//            then per detection int16 x, y, width, height, uint16 confidence (1/65535),
+//            uint16 depth (rounded calibration units, 0 unknown)
+// A frame is 12 bytes plus 12 per detection. A file cut short by a crash just loses its last frame.
+// Times are wall clock so that runs appended to the same log stay in order across reboots.
+
+struct DetectionLogFrame {
+    std::chrono::system_clock::time_point time;
+    bool inferred = true; // False when the motion gate skipped the network for this frame
+    std::vector<Detection> detections;
+};
+
+class DetectionLogWriter {
+    public:
+        DetectionLogWriter() = default;
+        ~DetectionLogWriter();
+        DetectionLogWriter(const DetectionLogWriter&) = delete;
+        DetectionLogWriter& operator=(const DetectionLogWriter&) = delete;
+
+        // Appends to an existing log of the same version, otherwise starts a new one
+        bool open(const std::string& path, double fps);
+        void close();
+
+        void write(std::chrono::system_clock::time_point time, bool inferred,
+                   const std::vector<Detection>& detections);
+
+        uint64_t framesWritten() const { return frames; }
+
+    private:
+        FILE* file = nullptr;
+        std::vector<char> buffer; // One frame, written with a single fwrite
+        uint64_t frames = 0;
+};
+
+// Maps a log and walks it frame by frame without copying it. Any number of cursors, one per
+// sweep thread, can walk the same mapping at once.
+class DetectionLogReader {
+    public:
+        bool open(const std::string& path);
+
+        // Of the first run in the log
+        double fps() const { return frameRate; }
+
+        // A cursor over the frames; detections are decoded into `frame`, reusing its vector
+        class Cursor {
+            public:
+                explicit Cursor(const DetectionLogReader& log);
+                bool next(DetectionLogFrame& frame);
+
+            private:
+                const char* pos;
+                const char* end;
+        };
+        Cursor frames() const { return Cursor(*this); }
+
+    private:
+        MappedFile mapping;
+        size_t length = 0; // Up to the end of the last complete frame
+        double frameRate = 0.0;
+};
@@ -0,0 +1,287 @@
+#include "detector.hpp"
+#include "model_cache.hpp"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/dnn.hpp>
+
+#ifdef HAVE_ONNXRUNTIME
+#include <onnxruntime_cxx_api.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+using namespace cv;
+using namespace dnn;
+using namespace std;
+
+bool parseDetector(const string& spec, DetectorConfig& config) {
+    size_t first = spec.find(':');
+    string kind = spec.substr(0, first);
+    string rest = first == string::npos ? "" : spec.substr(first + 1);
+
+    if (kind == "dnn") {
+        config.kind = DetectorKind::Dnn;
+        if (!rest.empty()) {
+            size_t second = rest.find(':');
+            config.model = rest.substr(0, second);
+            config.config = second == string::npos ? "" : rest.substr(second + 1);
+        }
+        return true;
+    }
+    if (kind == "onnx" && !rest.empty()) {
+        config.kind = DetectorKind::Onnx;
+        config.model = rest;
+        config.config.clear();
+        return true;
+    }
+    return false;
+}
+
+bool parseInputSize(const string& text, Size& size) {
+    int width = 0, height = 0;
+    char end;
+    if (sscanf(text.c_str(), "%dx%d%c", &width, &height, &end) != 2) return false;
+    if (width <= 0 || height <= 0 || width % 32 != 0 || height % 32 != 0) return false;
+    size = Size(width, height);
+    return true;
+}
+
+// width= and height= from the [net] section of a darknet cfg, empty when missing
+static Size darknetInputSize(const string& cfg) {
+    Size size;
+    istringstream lines(cfg);
+    string line;
+    bool inNet = false;
+    while (getline(lines, line)) {
+        line.erase(remove_if(line.begin(), line.end(), [](unsigned char c) { return isspace(c); }), line.end());
+        if (!line.empty() && line[0] == '[') {
+            if (inNet) break;
+            inNet = line == "[net]" || line == "[network]";
+        } else if (inNet && line.compare(0, 6, "width=") == 0) {
+            size.width = atoi(line.c_str() + 6);
+        } else if (inNet && line.compare(0, 7, "height=") == 0) {
+            size.height = atoi(line.c_str() + 7);
+        }
+    }
+    return size.width > 0 && size.height > 0 ? size : Size();
+}
+
+void Detector::warmUp(int batchSize) {
+    Size size = inputSize();
+    const int shape[] = {batchSize, 3, size.height, size.width};
+    Mat blob(4, shape, CV_32F, Scalar(0));
+    vector<Mat> outputs;
+    forward(blob, outputs);
+}
+
+static bool endsWith(const string& text, const char* suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+void Detector::decode(const vector<Mat>& outputs, const vector<DecodeParams>& images, DecodeBuffer& out) const {
+    out.count = 0;
+    const int batchSize = static_cast<int>(images.size());
+    for (int b = 0; b < batchSize; b++) {
+        decodeImage(outputs, batchSize, b, images[b], out);
+    }
+}
+
+// The darknet path the project started with
+class DnnDetector : public Detector {
+    public:
+        explicit DnnDetector(const DetectorConfig& config) {
+            // Darknet files are parsed straight out of the page cache instead of through ifstreams
+            MappedFile weights, cfg;
+            if (endsWith(config.model, ".weights") && weights.open(config.model) && cfg.open(config.config)) {
+                net = readNetFromDarknet(cfg.data(), cfg.size(), weights.data(), weights.size());
+            } else {
+                net = readNet(config.model, config.config);
+            }
+            if (net.empty()) return;
+            // The size it was trained at, unless the site asks for another
+            size = config.inputSize;
+            if (size.empty() && (cfg.isOpen() || cfg.open(config.config))) {
+                size = darknetInputSize(string(cfg.data(), cfg.size()));
+            }
+            if (size.empty()) size = Size(640, 640);
+            if (config.threads > 0) {
+                setNumThreads(config.threads);
+            }
+            device = selectBackend(net, config.backend);
+            layerNames = net.getUnconnectedOutLayersNames();
+        }
+
+        bool loaded() const { return !net.empty(); }
+
+        void forward(const Mat& blob, vector<Mat>& outputs) override {
+            net.setInput(blob);
+            net.forward(outputs, layerNames);
+        }
+
+        void decodeImage(const vector<Mat>& outputs, int batchSize, int image, const DecodeParams& params,
+                         DecodeBuffer& out) const override {
+            decodeBatchImage(outputs, batchSize, image, params, out);
+        }
+
+        Size inputSize() const override { return size; }
+        string name() const override { return string("OpenCV DNN (") + device + ")"; }
+
+    private:
+        Net net;
+        Size size;
+        vector<string> layerNames;
+        const char* device = "";
+};
+
+#ifdef HAVE_ONNXRUNTIME
+
+// YOLOv8 ONNX models on ONNX Runtime's CPU provider. int8 models from yolov/quantize.py load the
+// same way; the quantize/dequantize nodes are inside the graph.
+class OrtDetector : public Detector {
+    public:
+        explicit OrtDetector(const DetectorConfig& config) : env(ORT_LOGGING_LEVEL_WARNING, "onedong") {
+            Ort::SessionOptions options;
+            if (config.threads > 0) {
+                options.SetIntraOpNumThreads(config.threads);
+            }
+            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+            if (!config.cacheDir.empty()) {
+                loadCached(config, options);
+            }
+            if (!session) {
+                session = make_unique<Ort::Session>(env, config.model.c_str(), options);
+            }
+
+            Ort::AllocatorWithDefaultOptions allocator;
+            inputName = session->GetInputNameAllocated(0, allocator).get();
+            outputName = session->GetOutputNameAllocated(0, allocator).get();
+
+            // Fixed-size exports say so in the input shape; dynamic ones get the training size
+            vector<int64_t> shape = session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+            if (shape.size() == 4 && shape[2] > 0 && shape[3] > 0) {
+                size = Size(static_cast<int>(shape[3]), static_cast<int>(shape[2]));
+                if (!config.inputSize.empty() && config.inputSize != size) {
+                    cerr << "Warning: " << config.model << " takes " << size.width << "x" << size.height
+                         << " only, ignoring the configured input size" << endl;
+                }
+            } else if (!config.inputSize.empty()) {
+                size = config.inputSize;
+            }
+        }
+
+        void forward(const Mat& blob, vector<Mat>& outputs) override {
+            // The input tensor wraps the blob's memory, nothing is copied on the way in
+            const int64_t shape[4] = {blob.size[0], blob.size[1], blob.size[2], blob.size[3]};
+            Ort::Value input = Ort::Value::CreateTensor<float>(memoryInfo, const_cast<float*>(blob.ptr<float>()),
+                                                               blob.total(), shape, 4);
+            const char* inputNames[] = {inputName.c_str()};
+            const char* outputNames[] = {outputName.c_str()};
+            vector<Ort::Value> result = session->Run(Ort::RunOptions{nullptr}, inputNames, &input, 1, outputNames, 1);
+
+            // [batch, 4 + classes, anchors] as a (batch * channels) x anchors Mat
+            vector<int64_t> outShape = result[0].GetTensorTypeAndShapeInfo().GetShape();
+            CV_Assert(outShape.size() == 3);
+            outputs.resize(1);
+            outputs[0].create(static_cast<int>(outShape[0] * outShape[1]), static_cast<int>(outShape[2]), CV_32F);
+            memcpy(outputs[0].ptr<float>(), result[0].GetTensorData<float>(), outputs[0].total() * sizeof(float));
+        }
+
+        void decodeImage(const vector<Mat>& outputs, int batchSize, int image, const DecodeParams& params,
+                         DecodeBuffer& out) const override {
+            if (outputs.empty()) return;
+            const Mat& output = outputs[0];
+            CV_Assert(output.rows % batchSize == 0);
+            int channels = output.rows / batchSize;
+            decodePersonColumns(output.ptr<float>(image * channels), channels, output.cols, size, params, out);
+        }
+
+        Size inputSize() const override { return size; }
+        string name() const override { return "ONNX Runtime (CPU)"; }
+
+    private:
+        // Loads the ORT-format copy of the model from the cache, optimizing and saving it there
+        // first on a miss. ORT-format models are flatbuffers the session can use in place, so a
+        // cache hit skips protobuf parsing and graph optimization and leaves the weights in the
+        // page cache instead of on the heap.
+        void loadCached(const DetectorConfig& config, const Ort::SessionOptions& options) {
+            string cached = cachedModelPath(config.cacheDir, config.model, "ort" + to_string(ORT_API_VERSION), ".ort");
+            if (cached.empty()) return;
+
+            if (!mapped.open(cached)) {
+                // Unique per process, so units starting together on a shared cache never write the same file
+                string building = config.cacheDir + "/.building." + to_string(getpid()) + "." +
+                                  to_string(random_device{}()) + ".ort";
+                Ort::SessionOptions save;
+                save.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+                save.SetOptimizedModelFilePath(building.c_str());
+                save.AddConfigEntry("session.save_model_format", "ORT");
+                {
+                    Ort::Session optimizer(env, config.model.c_str(), save);
+                }
+                // Renamed into place so a crash mid-write never leaves a truncated cache entry
+                if (rename(building.c_str(), cached.c_str()) != 0 || !mapped.open(cached)) {
+                    remove(building.c_str());
+                    cerr << "Warning: Cannot write model cache " << cached << endl;
+                    return;
+                }
+                cout << "Cached optimized model as " << cached << endl;
+            }
+
+            Ort::SessionOptions fromCache = options.Clone();
+            fromCache.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+            fromCache.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+            try {
+                session = make_unique<Ort::Session>(env, mapped.data(), mapped.size(), fromCache);
+            } catch (const Ort::Exception& e) {
+                // Typically written by another onnxruntime version; rebuilt on the next start
+                cerr << "Warning: Ignoring model cache " << cached << ": " << e.what() << endl;
+                mapped.close();
+                remove(cached.c_str());
+            }
+        }
+
+        Ort::Env env;
+        MappedFile mapped; // Backs the session when loaded from the cache, so declared before it
+        unique_ptr<Ort::Session> session;
+        Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        string inputName;
+        string outputName;
+        Size size = Size(640, 640);
+};
+
+#endif
+
+unique_ptr<Detector> createDetector(const DetectorConfig& config) {
+    if (config.kind == DetectorKind::Onnx) {
+#ifdef HAVE_ONNXRUNTIME
+        try {
+            return make_unique<OrtDetector>(config);
+        } catch (const Ort::Exception& e) {
+            cerr << "Error: Cannot load " << config.model << ": " << e.what() << endl;
+            return nullptr;
+        }
+#else
+        cerr << "Error: Built without ONNX Runtime, rebuild with make ONNXRUNTIME=1" << endl;
+        return nullptr;
+#endif
+    }
+
+    try {
+        auto detector = make_unique<DnnDetector>(config);
+        if (detector->loaded()) {
+            return detector;
+        }
+    } catch (const cv::Exception& e) {
+        cerr << e.what() << endl;
+    }
+    cerr << "Error: Cannot load " << config.model << endl;
+    return nullptr;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "backend.hpp"
+#include "yolo_decoder.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class DetectorKind {
+    Dnn,  // OpenCV DNN: darknet cfg/weights, or anything readNet understands
+    Onnx, // ONNX Runtime on CPU, for YOLOv8 exports from yolov/ (fp32 or int8)
+};
+
+struct DetectorConfig {
+    DetectorKind kind = DetectorKind::Dnn;
+    std::string model = "yolov7-tiny.weights";
+    std::string config = "yolov7-tiny.cfg"; // Darknet cfg, DNN only
+    ComputeBackend backend = ComputeBackend::Auto; // DNN only
+    int threads = 0; // 0 leaves the library default
+    std::string cacheDir; // Pre-optimized models and compiled kernels, empty to disable
+    cv::Size inputSize;   // Network input; empty for the model's own (darknet cfg, ONNX shape), else 640x640
+};
+
+// Parses "dnn[:model[:config]]" or "onnx:model.onnx"
+bool parseDetector(const std::string& spec, DetectorConfig& config);
+// Parses "WIDTHxHEIGHT", both positive multiples of 32 as YOLO strides need
+bool parseInputSize(const std::string& text, cv::Size& size);
+
+// One network that turns a preprocessed NCHW blob into person candidates. Implementations own
+// their runtime; the pipeline only ever sees blobs, output Mats and DecodeBuffers.
+class Detector {
+    public:
+        virtual ~Detector() = default;
+
+        // Runs the network on a batch of images. Output Mats are reused between calls.
+        virtual void forward(const cv::Mat& blob, std::vector<cv::Mat>& outputs) = 0;
+        // Appends the candidates of image `image` of a batched forward pass
+        virtual void decodeImage(const std::vector<cv::Mat>& outputs, int batchSize, int image,
+                                 const DecodeParams& params, DecodeBuffer& out) const = 0;
+
+        virtual cv::Size inputSize() const = 0;
+        virtual std::string name() const = 0;
+
+        // Runs one throwaway forward pass so layer fusion, allocation and kernel compilation
+        // happen before the first real frame instead of on it
+        void warmUp(int batchSize = 1);
+
+        // Clears out and decodes every image of a batched forward pass, each with its own mapping
+        void decode(const std::vector<cv::Mat>& outputs, const std::vector<DecodeParams>& images,
+                    DecodeBuffer& out) const;
+};
+
+// Loads the model, through config.cacheDir when set; prints the reason and returns null when it can't
+std::unique_ptr<Detector> createDetector(const DetectorConfig& config);
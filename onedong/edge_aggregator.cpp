@@ -0,0 +1,205 @@
+// Site-wide fan-in for several onedong processes, one per doorway, on the same device.
+// `main --aggregator` publishes crossings and live track counts into a shared-memory bus instead of
+// posting them itself. This daemon drains the bus, drops duplicates, keeps per-entrance and
+// site-wide occupancy in the segment where any process can read it, and uploads everything to the
+// server in one batch per interval.
+#include "edge_bus.hpp"
+#include "http_server.hpp"
+#include "uplink.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Sequences already seen from one publisher: the highest, and a bit for each of the 63 below it
+struct ReplayWindow {
+    uint64_t highest = 0;
+    uint64_t seen = 0;
+};
+
+// True the first time a sequence number arrives. Sequences more than 63 behind the highest count
+// as seen; publishers write in order, so they only turn up as replays.
+static bool firstTime(ReplayWindow& window, uint64_t sequence) {
+    if (sequence > window.highest) {
+        uint64_t shift = sequence - window.highest;
+        window.seen = (shift >= 64 ? 0 : window.seen << shift) | 1;
+        window.highest = sequence;
+        return true;
+    }
+    uint64_t back = window.highest - sequence;
+    if (back >= 64) return false;
+    uint64_t bit = uint64_t(1) << back;
+    if (window.seen & bit) return false;
+    window.seen |= bit;
+    return true;
+}
+
+// Crossings counted lately at one entrance in one direction, for merging cameras that share it
+struct RecentCrossing {
+    int64_t timeNs;
+    uint64_t instance;
+    bool merged;
+};
+
+// With two cameras on one doorway, the same person crosses in both within a moment. Each counted
+// crossing absorbs at most one crossing from another camera within the window.
+static bool mergeWithOtherCamera(deque<RecentCrossing>& recent, const EdgeEvent& event, int64_t windowNs) {
+    while (!recent.empty() && recent.front().timeNs < event.timeNs - 2 * windowNs) {
+        recent.pop_front();
+    }
+    for (auto& crossing : recent) {
+        if (crossing.merged || crossing.instance == event.instance) continue;
+        if (llabs(crossing.timeNs - event.timeNs) <= windowNs) {
+            crossing.merged = true;
+            return true;
+        }
+    }
+    recent.push_back({event.timeNs, event.instance, false});
+    return false;
+}
+
+static string snapshotJson(const EdgeSnapshot& snapshot) {
+    ostringstream json;
+    json << "{\"occupancy\": " << snapshot.occupancy << ", \"in_view\": " << snapshot.inView
+         << ", \"publishers\": " << snapshot.publishers << ", \"duplicates\": " << snapshot.duplicates
+         << ", \"dropped\": " << snapshot.dropped << ", \"entrances\": [";
+    for (size_t i = 0; i < snapshot.entrances.size(); i++) {
+        const auto& e = snapshot.entrances[i];
+        json << (i ? ", " : "") << "{\"entrance\": " << e.entrance << ", \"entries\": " << e.entries
+             << ", \"exits\": " << e.exits << ", \"occupancy\": " << e.entries - e.exits << "}";
+    }
+    json << "]}\n";
+    return json.str();
+}
+
+// Reads the live counts straight from the segment
+static int query(const string& busName) {
+    unique_ptr<EdgeBus> bus = EdgeBus::open(busName);
+    if (!bus) {
+        cerr << "Error: No edge aggregator running on " << busName << endl;
+        return -1;
+    }
+    auto begin = chrono::steady_clock::now();
+    EdgeSnapshot snapshot = bus->snapshot();
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count();
+    cout << snapshotJson(snapshot);
+    cerr << "Read in " << fixed << setprecision(1) << us << " us" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string busName = defaultEdgeBus;
+    size_t slots = 4096;
+    mode_t busMode = 0660;
+    string server;
+    double intervalSeconds = 10.0;
+    double mergeWindowMs = 0.0;
+    int httpPort = 0;
+    bool reset = false;
+    bool queryOnly = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bus") == 0 && i + 1 < argc) busName = argv[++i];
+        else if (strcmp(argv[i], "--slots") == 0 && i + 1 < argc) slots = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--bus-mode") == 0 && i + 1 < argc) busMode = strtoul(argv[++i], nullptr, 8);
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) server = argv[++i];
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) intervalSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--merge-window") == 0 && i + 1 < argc) mergeWindowMs = atof(argv[++i]);
+        else if (strcmp(argv[i], "--http-port") == 0 && i + 1 < argc) httpPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--reset") == 0) reset = true;
+        else if (strcmp(argv[i], "--query") == 0) queryOnly = true;
+        else {
+            cerr << "Usage: " << argv[0] << " [--bus NAME] [--bus-mode OCTAL] [--slots N] [--server URL] [--interval SECONDS]"
+                 << " [--merge-window MS] [--http-port PORT] [--reset]" << endl
+                 << "       " << argv[0] << " --query [--bus NAME]" << endl;
+            return -1;
+        }
+    }
+    if (queryOnly) return query(busName);
+
+    unique_ptr<EdgeBus> bus = EdgeBus::create(busName, slots, busMode);
+    if (!bus) return -1;
+    if (reset) bus->resetCounts();
+
+    unique_ptr<EventUplink> uplink;
+    if (!server.empty()) {
+        UplinkConfig uplinkConfig;
+        uplinkConfig.baseUrl = server;
+        uplinkConfig.batchSize = 1000;
+        uplinkConfig.flushInterval = chrono::milliseconds(static_cast<long>(intervalSeconds * 1000));
+        uplinkConfig.spoolPath = "aggregator.spool";
+        uplink = make_unique<EventUplink>(uplinkConfig);
+    }
+
+    unique_ptr<HttpServer> http;
+    if (httpPort > 0) {
+        http = make_unique<HttpServer>(httpPort);
+        EdgeBus* b = bus.get();
+        http->handle("/occupancy", [b](int fd, const HttpRequest&) {
+            HttpServer::sendResponse(fd, 200, "application/json", snapshotJson(b->snapshot()));
+        });
+        if (http->start()) {
+            cout << "Occupancy on http://0.0.0.0:" << httpPort << "/occupancy" << endl;
+        }
+    }
+
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    cout << "Aggregating on " << busName << endl;
+
+    unordered_map<uint64_t, ReplayWindow> windows;
+    map<pair<int, int>, deque<RecentCrossing>> recent;
+    const int64_t mergeWindowNs = static_cast<int64_t>(mergeWindowMs * 1e6);
+    uint64_t received = 0;
+    uint64_t counted = 0;
+    EdgeEvent event;
+    while (!stopRequested) {
+        bool any = false;
+        while (bus->pop(event)) {
+            any = true;
+            received++;
+            if (!firstTime(windows[event.instance], event.sequence)) {
+                bus->addDuplicate();
+                continue;
+            }
+            if (mergeWindowNs > 0 &&
+                mergeWithOtherCamera(recent[{event.entrance, event.kind}], event, mergeWindowNs)) {
+                bus->addDuplicate();
+                continue;
+            }
+
+            EventKind kind = static_cast<EventKind>(event.kind);
+            bus->count(event.entrance, kind);
+            counted++;
+            if (uplink) {
+                auto time = chrono::system_clock::time_point(
+                    chrono::duration_cast<chrono::system_clock::duration>(chrono::nanoseconds(event.timeNs)));
+                uplink->enqueue({kind, event.entrance, isoTimestamp(time)});
+            }
+        }
+        // Publishers never wait on us, so a millisecond of latency only delays the counts
+        if (!any) this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    if (http) http->stop();
+    if (uplink) uplink->stop();
+    EdgeSnapshot snapshot = bus->snapshot();
+    cout << "Received " << received << " crossings, counted " << counted << ", duplicates " << snapshot.duplicates
+         << ", dropped " << snapshot.dropped << ", occupancy " << snapshot.occupancy << endl;
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include "edge_bus.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+// The segment is shared between processes, so its atomics must not fall back to a lock
+static_assert(atomic<uint64_t>::is_always_lock_free && atomic<int64_t>::is_always_lock_free &&
+              atomic<uint32_t>::is_always_lock_free, "edge bus needs lock-free 64-bit atomics");
+
+static const uint32_t edgeBusMagic = 0x45444745; // "EDGE"
+static const uint32_t edgeBusVersion = 1;
+
+// A slot is free for the producer at position p when turn == p, and holds an event for the
+// consumer when turn == p + 1. Consuming hands it to position p + slotCount.
+struct EdgeBus::Slot {
+    atomic<uint64_t> turn;
+    EdgeEvent event;
+};
+
+namespace {
+
+struct EntranceCounts {
+    atomic<int64_t> entries;
+    atomic<int64_t> exits;
+};
+
+struct PublisherRow {
+    atomic<uint64_t> instance; // 0 when never used
+    atomic<int64_t> activeTracks;
+    atomic<int64_t> seenNs;    // steady_clock, which is CLOCK_MONOTONIC and so the same in every process
+};
+
+}
+
+// Freshly truncated shared memory reads as zeros, which is a valid state for every field here
+struct EdgeBus::Layout {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slotCount;
+    atomic<uint32_t> ready;
+    alignas(64) atomic<uint64_t> tail; // Next position a producer claims
+    alignas(64) atomic<uint64_t> head; // Next position the aggregator reads
+    alignas(64) atomic<uint64_t> duplicates;
+    atomic<uint64_t> dropped;
+    EntranceCounts entrances[edgeMaxEntrances];
+    PublisherRow publishers[edgeMaxPublishers];
+};
+
+size_t EdgeBus::slotsOffset() {
+    return (sizeof(Layout) + 63) & ~size_t(63);
+}
+
+static int64_t steadyNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+EdgeBus::EdgeBus(int fd, void* base, size_t size)
+    : fd(fd), base(base), mappedSize(size), layout(static_cast<Layout*>(base)) {}
+
+EdgeBus::~EdgeBus() {
+    if (base) munmap(base, mappedSize);
+    if (fd >= 0) close(fd);
+}
+
+void* EdgeBus::mapValid(int fd, size_t& size) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < slotsOffset()) return nullptr;
+    size = info.st_size;
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return nullptr;
+
+    auto* layout = static_cast<Layout*>(base);
+    bool valid = layout->ready.load(memory_order_acquire) == 1 && layout->magic == edgeBusMagic &&
+                 layout->version == edgeBusVersion && layout->slotCount > 0 &&
+                 (layout->slotCount & (layout->slotCount - 1)) == 0 &&
+                 size >= slotsOffset() + layout->slotCount * sizeof(Slot);
+    if (!valid) {
+        munmap(base, size);
+        return nullptr;
+    }
+    return base;
+}
+
+unique_ptr<EdgeBus> EdgeBus::create(const string& name, size_t slots, mode_t mode) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd >= 0) {
+        size_t size = 0;
+        if (void* base = mapValid(fd, size)) {
+            fchmod(fd, mode); // A segment from an older build may be world-writable
+            return unique_ptr<EdgeBus>(new EdgeBus(fd, base, size));
+        }
+        // Left by an older build or a crash during setup; publishers still holding it reattach
+        close(fd);
+        shm_unlink(name.c_str());
+    }
+
+    size_t slotCount = 2;
+    while (slotCount < slots) {
+        slotCount <<= 1;
+    }
+    size_t size = slotsOffset() + slotCount * sizeof(Slot);
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, mode);
+    if (fd < 0) {
+        cerr << "Error: Cannot create shared memory " << name << ": " << strerror(errno) << endl;
+        return nullptr;
+    }
+    // The mode passed to shm_open is masked by the umask; set exactly what was asked for, so
+    // onedong can run as another user of the same group
+    fchmod(fd, mode);
+    if (ftruncate(fd, size) != 0) {
+        cerr << "Error: Cannot size shared memory " << name << ": " << strerror(errno) << endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        cerr << "Error: Cannot map shared memory " << name << ": " << strerror(errno) << endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    unique_ptr<EdgeBus> bus(new EdgeBus(fd, base, size));
+    bus->layout->magic = edgeBusMagic;
+    bus->layout->version = edgeBusVersion;
+    bus->layout->slotCount = slotCount;
+    for (size_t i = 0; i < slotCount; i++) {
+        bus->slot(i)->turn.store(i, memory_order_relaxed);
+    }
+    bus->layout->ready.store(1, memory_order_release);
+    return bus;
+}
+
+unique_ptr<EdgeBus> EdgeBus::open(const string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return nullptr;
+    size_t size = 0;
+    void* base = mapValid(fd, size);
+    if (!base) {
+        close(fd);
+        return nullptr;
+    }
+    return unique_ptr<EdgeBus>(new EdgeBus(fd, base, size));
+}
+
+EdgeBus::Slot* EdgeBus::slot(uint64_t position) const {
+    auto* slots = reinterpret_cast<Slot*>(static_cast<char*>(base) + slotsOffset());
+    return slots + (position & (layout->slotCount - 1));
+}
+
+// Bounded multi-producer queue with a turn counter per slot (Vyukov). A producer claims a position
+// with one CAS and publishes it with one release store, so a publisher only stalls the ring if it
+// dies between those two.
+bool EdgeBus::push(const EdgeEvent& event) {
+    uint64_t position = layout->tail.load(memory_order_relaxed);
+    for (;;) {
+        Slot* s = slot(position);
+        uint64_t turn = s->turn.load(memory_order_acquire);
+        int64_t lag = static_cast<int64_t>(turn - position);
+        if (lag == 0) {
+            if (layout->tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                s->event = event;
+                s->turn.store(position + 1, memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            // Still holds an event from the previous lap
+            layout->dropped.fetch_add(1, memory_order_relaxed);
+            return false;
+        } else {
+            position = layout->tail.load(memory_order_relaxed);
+        }
+    }
+}
+
+bool EdgeBus::pop(EdgeEvent& event) {
+    uint64_t position = layout->head.load(memory_order_relaxed);
+    Slot* s = slot(position);
+    if (s->turn.load(memory_order_acquire) != position + 1) return false;
+    event = s->event;
+    layout->head.store(position + 1, memory_order_relaxed);
+    s->turn.store(position + layout->slotCount, memory_order_release);
+    return true;
+}
+
+void EdgeBus::count(int entrance, EventKind kind) {
+    if (entrance < 0 || entrance >= edgeMaxEntrances) return;
+    EntranceCounts& counts = layout->entrances[entrance];
+    (kind == EventKind::Entry ? counts.entries : counts.exits).fetch_add(1, memory_order_relaxed);
+}
+
+void EdgeBus::addDuplicate() {
+    layout->duplicates.fetch_add(1, memory_order_relaxed);
+}
+
+void EdgeBus::resetCounts() {
+    for (auto& counts : layout->entrances) {
+        counts.entries.store(0, memory_order_relaxed);
+        counts.exits.store(0, memory_order_relaxed);
+    }
+}
+
+int EdgeBus::registerPublisher(uint64_t instance) {
+    const int64_t now = steadyNs();
+    const int64_t timeout = chrono::duration_cast<chrono::nanoseconds>(edgePublisherTimeout).count();
+    for (int row = 0; row < edgeMaxPublishers; row++) {
+        PublisherRow& entry = layout->publishers[row];
+        uint64_t current = entry.instance.load(memory_order_acquire);
+        bool available = current == 0 || now - entry.seenNs.load(memory_order_relaxed) > timeout;
+        // Two publishers racing for a row: the CAS lets exactly one have it
+        if (available && entry.instance.compare_exchange_strong(current, instance, memory_order_acq_rel)) {
+            entry.activeTracks.store(0, memory_order_relaxed);
+            entry.seenNs.store(now, memory_order_release);
+            return row;
+        }
+    }
+    return -1;
+}
+
+bool EdgeBus::reportTracks(int row, uint64_t instance, size_t activeTracks) {
+    PublisherRow& entry = layout->publishers[row];
+    if (entry.instance.load(memory_order_acquire) != instance) return false;
+    entry.activeTracks.store(static_cast<int64_t>(activeTracks), memory_order_relaxed);
+    entry.seenNs.store(steadyNs(), memory_order_release);
+    return true;
+}
+
+EdgeSnapshot EdgeBus::snapshot() const {
+    EdgeSnapshot snapshot;
+    for (int e = 0; e < edgeMaxEntrances; e++) {
+        int64_t entries = layout->entrances[e].entries.load(memory_order_relaxed);
+        int64_t exits = layout->entrances[e].exits.load(memory_order_relaxed);
+        if (entries == 0 && exits == 0) continue;
+        snapshot.entrances.push_back({e, entries, exits});
+        snapshot.occupancy += entries - exits;
+    }
+
+    const int64_t now = steadyNs();
+    const int64_t timeout = chrono::duration_cast<chrono::nanoseconds>(edgePublisherTimeout).count();
+    for (const auto& entry : layout->publishers) {
+        if (entry.instance.load(memory_order_acquire) == 0) continue;
+        if (now - entry.seenNs.load(memory_order_acquire) > timeout) continue;
+        snapshot.publishers++;
+        snapshot.inView += entry.activeTracks.load(memory_order_relaxed);
+    }
+    snapshot.duplicates = layout->duplicates.load(memory_order_relaxed);
+    snapshot.dropped = layout->dropped.load(memory_order_relaxed);
+    return snapshot;
+}
+
+bool EdgeBus::unlinked() const {
+    struct stat info;
+    return fstat(fd, &info) != 0 || info.st_nlink == 0;
+}
+
+EdgePublisher::EdgePublisher(string busName) : busName(std::move(busName)) {
+    random_device device;
+    mt19937_64 rng((static_cast<uint64_t>(device()) << 32) ^ device() ^ static_cast<uint64_t>(steadyNs()));
+    do {
+        instance = rng();
+    } while (instance == 0);
+    nextCheck = chrono::steady_clock::now();
+}
+
+void EdgePublisher::checkBus() {
+    auto now = chrono::steady_clock::now();
+    if (now < nextCheck) return;
+    nextCheck = now + chrono::seconds(1);
+
+    if (bus && bus->unlinked()) {
+        cerr << "Warning: Edge aggregator " << busName << " was restarted, reattaching" << endl;
+        bus.reset();
+        row = -1;
+    }
+    if (!bus) {
+        bus = EdgeBus::open(busName);
+        if (bus) cout << "Publishing to edge aggregator " << busName << endl;
+    }
+    if (bus && row < 0) {
+        row = bus->registerPublisher(instance);
+    }
+}
+
+bool EdgePublisher::publish(EventKind kind, int entrance, int trackId, chrono::system_clock::time_point time) {
+    checkBus();
+    if (!bus) return false;
+
+    EdgeEvent event;
+    event.instance = instance;
+    event.sequence = nextSequence;
+    event.timeNs = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+    event.trackId = trackId;
+    event.entrance = static_cast<int16_t>(entrance);
+    event.kind = static_cast<uint8_t>(kind);
+    if (!bus->push(event)) return false;
+    nextSequence++;
+    return true;
+}
+
+void EdgePublisher::setActiveTracks(size_t count) {
+    checkBus();
+    if (bus && row >= 0 && !bus->reportTracks(row, instance, count)) {
+        row = -1; // Timed out, claim a row again on the next check
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "uplink.hpp"
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Shared-memory fan-in from the onedong processes of one site to edge_aggregator.
+// The aggregator creates a POSIX shared memory segment holding a bounded multi-producer ring of
+// crossings, the live counts it keeps, and a table where each publisher reports how many people it
+// is tracking. Publishers and queries only map the segment; nothing goes through a socket.
+
+constexpr const char* defaultEdgeBus = "/onedong-edge";
+constexpr int edgeMaxEntrances = 64;  // Entrance ids 0..63 are counted; others are still uploaded
+constexpr int edgeMaxPublishers = 32;
+constexpr std::chrono::seconds edgePublisherTimeout{10}; // Publishers silent this long are not counted
+
+// One crossing on the ring
+struct EdgeEvent {
+    uint64_t instance = 0; // Publishing process, random per run
+    uint64_t sequence = 0; // Per instance, from 1
+    int64_t timeNs = 0;    // Capture time since the Unix epoch
+    int32_t trackId = -1;
+    int16_t entrance = 1;
+    uint8_t kind = 0;      // EventKind
+    uint8_t reserved = 0;
+};
+
+// Counts as read from the segment
+struct EdgeSnapshot {
+    struct Entrance {
+        int entrance;
+        int64_t entries;
+        int64_t exits;
+    };
+    std::vector<Entrance> entrances; // Only those that have seen a crossing
+    int64_t occupancy = 0;           // Entries minus exits over all entrances
+    int64_t inView = 0;              // People tracked right now by publishers heard from lately
+    int publishers = 0;
+    uint64_t duplicates = 0;
+    uint64_t dropped = 0;            // Lost to a full ring
+};
+
+// A mapping of the segment. Push is lock-free and safe from any number of threads and processes;
+// pop and the counter updates belong to the aggregator alone.
+class EdgeBus {
+    public:
+        // Creates the segment, or reattaches to a compatible one a previous aggregator left behind,
+        // so counts survive a daemon restart. Anyone who can write the segment can push crossings
+        // and reset the counts, so mode should not give write access beyond the onedong group.
+        static std::unique_ptr<EdgeBus> create(const std::string& name, size_t slots, mode_t mode = 0660);
+        // Maps an existing segment; nullptr when no aggregator has created it yet
+        static std::unique_ptr<EdgeBus> open(const std::string& name);
+        ~EdgeBus();
+        EdgeBus(const EdgeBus&) = delete;
+        EdgeBus& operator=(const EdgeBus&) = delete;
+
+        // False when the ring is full; the event is counted as dropped
+        bool push(const EdgeEvent& event);
+        bool pop(EdgeEvent& event);
+
+        void count(int entrance, EventKind kind);
+        void addDuplicate();
+        // Zeroes every entrance, as at the start of a day
+        void resetCounts();
+
+        // Claims a row in the publisher table, reusing rows that timed out. -1 when all are live.
+        int registerPublisher(uint64_t instance);
+        // False when the row timed out and went to another publisher
+        bool reportTracks(int row, uint64_t instance, size_t activeTracks);
+
+        EdgeSnapshot snapshot() const;
+
+        // True once the aggregator has replaced the segment, after which this mapping is orphaned
+        bool unlinked() const;
+
+    private:
+        struct Layout;
+        struct Slot;
+
+        EdgeBus(int fd, void* base, size_t size);
+        // Maps the segment behind fd when it holds a complete, initialised bus
+        static void* mapValid(int fd, size_t& size);
+        static size_t slotsOffset();
+        Slot* slot(uint64_t position) const;
+
+        int fd = -1;
+        void* base = nullptr;
+        size_t mappedSize = 0;
+        Layout* layout = nullptr;
+};
+
+// The onedong side: publishes crossings and the live track count, attaching to the aggregator
+// lazily so either can start first. Used from the frame loop only.
+class EdgePublisher {
+    public:
+        explicit EdgePublisher(std::string busName);
+
+        // False when no aggregator is attached or its ring is full, so the caller can fall back
+        bool publish(EventKind kind, int entrance, int trackId, std::chrono::system_clock::time_point time);
+        void setActiveTracks(size_t count);
+
+        bool attached() const { return bus != nullptr; }
+
+    private:
+        // Attaches or reattaches, at most once a second
+        void checkBus();
+
+        std::string busName;
+        std::unique_ptr<EdgeBus> bus;
+        uint64_t instance;
+        uint64_t nextSequence = 1;
+        int row = -1;
+        std::chrono::steady_clock::time_point nextCheck;
+};
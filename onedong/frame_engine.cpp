@@ -0,0 +1,162 @@
+#include "frame_engine.hpp"
+
+#include "backend.hpp"
+#include "nms.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+bool parseFrameEngineArgs(int argc, const char* const* argv, FrameEngineConfig& config) {
+    // The file first, so flags win wherever they appear
+    for (int i = 0; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && !loadRuntimeConfig(argv[i + 1], config.runtime)) {
+            return false;
+        }
+    }
+
+    RuntimeConfig& runtime = config.runtime;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            i++;
+        } else if (strcmp(argv[i], "--detector") == 0 && i + 1 < argc) {
+            if (!parseDetector(argv[++i], runtime.detector)) {
+                cerr << "Error: Bad detector " << argv[i] << ", expected dnn[:model[:config]] or onnx:model.onnx" << endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (!parseBackend(argv[++i], runtime.detector.backend)) {
+                cerr << "Error: Unknown backend " << argv[i] << ", expected auto, cuda, opencl or cpu" << endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            runtime.detector.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--model-cache") == 0 && i + 1 < argc) {
+            runtime.detector.cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--input-size") == 0 && i + 1 < argc) {
+            if (!parseInputSize(argv[++i], runtime.detector.inputSize)) {
+                cerr << "Error: Bad input size " << argv[i] << ", expected WIDTHxHEIGHT in multiples of 32" << endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "--zone") == 0 && i + 1 < argc) {
+            CountingZone zone;
+            if (!parseZone(argv[++i], zone)) {
+                cerr << "Error: Bad zone " << argv[i] << ", expected entrance:x1,y1,x2,y2[,...]" << endl;
+                return false;
+            }
+            runtime.zones.push_back(zone);
+        } else if (strcmp(argv[i], "--track-param") == 0 && i + 1 < argc) {
+            if (!parseByteTrackParam(argv[++i], runtime.tracker)) {
+                cerr << "Error: Bad tracker parameter " << argv[i]
+                     << ", expected max-kill|iou-high|iou-low|conf-high|conf-low=value" << endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "--nms") == 0 && i + 1 < argc) {
+            if (!parseNmsMethod(argv[++i], runtime.nms.method)) {
+                cerr << "Error: Unknown NMS method " << argv[i] << ", expected greedy, matrix or opencv" << endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "--letterbox") == 0) {
+            config.preprocess.letterbox = true;
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            Rect tile;
+            if (!parseTile(argv[++i], tile)) {
+                cerr << "Error: Bad tile " << argv[i] << ", expected x,y,width,height" << endl;
+                return false;
+            }
+            config.tiles.push_back(tile);
+        } else if (strcmp(argv[i], "--motion-gate") == 0) {
+            config.motionGate.enabled = true;
+        } else if (strcmp(argv[i], "--motion-roi") == 0 && i + 1 < argc) {
+            Rect& roi = config.motionGate.roi;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &roi.x, &roi.y, &roi.width, &roi.height) != 4) {
+                cerr << "Error: Bad motion ROI " << argv[i] << ", expected x,y,width,height" << endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "--keep-alive") == 0 && i + 1 < argc) {
+            config.motionGate.keepAliveFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            config.fps = atof(argv[++i]);
+        } else {
+            cerr << "Error: Unknown option " << argv[i] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The network decides the input size
+static PreprocessConfig sizedFor(PreprocessConfig config, const Detector* detector) {
+    if (detector) config.inputSize = detector->inputSize();
+    return config;
+}
+
+FrameEngine::FrameEngine(const FrameEngineConfig& config)
+    : config(config),
+      detector(createDetector(config.runtime.detector)),
+      motionGate(config.motionGate),
+      preprocessor(sizedFor(config.preprocess, detector.get())),
+      tiledInput(config.tiles, sizedFor(config.preprocess, detector.get())),
+      stage(config.runtime) {
+    stage.tracker().setFramePeriod(config.fps > 0 ? 1.0 / config.fps : 0.0);
+    if (detector) {
+        detector->warmUp(max(1, static_cast<int>(config.tiles.size())));
+    }
+}
+
+static double msSince(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+void FrameEngine::process(const Mat& frame, chrono::system_clock::time_point time) {
+    CV_Assert(frame.type() == CV_8UC3);
+    auto begin = chrono::steady_clock::now();
+    bool inferred = motionGate.shouldInfer(frame, !stage.tracks().empty());
+    if (inferred && tiledInput.enabled()) {
+        tiledInput.run(frame, blob);
+        decodeParams.assign(tiledInput.decodeParams().begin(), tiledInput.decodeParams().end());
+    } else if (inferred) {
+        preprocessor.run(frame, blob);
+        decodeParams.assign(1, preprocessor.decodeParams());
+    }
+    engineStats.preprocessMs += msSince(begin);
+
+    // Without inference the tracks just coast
+    if (inferred) {
+        begin = chrono::steady_clock::now();
+        detector->forward(blob, outputs);
+        engineStats.forwardMs += msSince(begin);
+        engineStats.inferred++;
+
+        begin = chrono::steady_clock::now();
+        stage.detect(*detector, outputs, decodeParams);
+        engineStats.decodeMs += msSince(begin);
+        engineStats.detections += stage.detections().size();
+    }
+
+    // Only the gaps between frames matter to the tracker, so the wall clock stands in for the steady one
+    begin = chrono::steady_clock::now();
+    chrono::steady_clock::time_point timestamp(
+        chrono::duration_cast<chrono::steady_clock::duration>(time.time_since_epoch()));
+    stage.track(frame, timestamp, time);
+    engineStats.trackMs += msSince(begin);
+    engineStats.frames++;
+}
+
+string FrameEngine::detectorName() const {
+    return detector ? detector->name() : string();
+}
+
+void FrameEngine::printStats(ostream& os) const {
+    const FrameEngineStats& s = engineStats;
+    double n = s.frames ? static_cast<double>(s.frames) : 1.0;
+    os << fixed << setprecision(2) << "Frame engine: " << s.frames << " frames, " << s.inferred << " inferred, mean "
+       << s.preprocessMs / n << " ms preprocess, " << s.forwardMs / n << " ms forward, " << s.decodeMs / n
+       << " ms decode, " << s.trackMs / n << " ms track" << endl;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "counter.hpp"
+#include "detector.hpp"
+#include "motion_gate.hpp"
+#include "preprocess.hpp"
+#include "runtime_config.hpp"
+#include "tiling.hpp"
+#include "tracking_stage.hpp"
+#include "yolo_decoder.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct FrameEngineConfig {
+    RuntimeConfig runtime;       // Detector, tracker, NMS and zones; sources and server are not used
+    PreprocessConfig preprocess; // inputSize is taken from the detector
+    std::vector<cv::Rect> tiles;
+    MotionGateConfig motionGate;
+    double fps = 0.0;            // Nominal frame rate for track prediction, 0 when unknown
+};
+
+// Parses the flags main takes for the frame path: --config FILE (read first, the other flags win
+// over it), --detector, --backend, --threads, --model-cache, --input-size, --zone, --track-param,
+// --nms, --letterbox, --tile, --motion-gate, --motion-roi, --keep-alive and --fps.
+// Prints the reason and returns false on a bad or unknown flag.
+bool parseFrameEngineArgs(int argc, const char* const* argv, FrameEngineConfig& config);
+
+struct FrameEngineStats {
+    uint64_t frames = 0;
+    uint64_t inferred = 0; // Frames the motion gate let through to the network
+    uint64_t detections = 0;
+    double preprocessMs = 0.0; // Totals, including the motion gate
+    double forwardMs = 0.0;
+    double decodeMs = 0.0;     // Decode and NMS
+    double trackMs = 0.0;      // Tracking and counting
+};
+
+// The single-source frame path of `main` without capture, threads or display, for embedding:
+// motion gate, preprocessing (or tiles) and the network, then the same TrackingStage main runs,
+// all on the calling thread, one frame per call. Frames are read in place and not kept after the call.
+class FrameEngine {
+    public:
+        explicit FrameEngine(const FrameEngineConfig& config);
+
+        // False when the detector could not be loaded
+        bool ready() const { return detector != nullptr; }
+
+        // frame is 8-bit BGR, time is when it was captured. Tracks and events are those of this frame.
+        void process(const cv::Mat& frame, std::chrono::system_clock::time_point time);
+
+        const TrackView& tracks() const { return stage.tracks(); }
+        const std::vector<CrossingEvent>& events() const { return stage.events(); }
+        int entries() const { return stage.counter().entries(); }
+        int exits() const { return stage.counter().exits(); }
+        const FrameEngineStats& stats() const { return engineStats; }
+        std::string detectorName() const;
+
+        void printStats(std::ostream& os) const;
+
+    private:
+        FrameEngineConfig config;
+        std::unique_ptr<Detector> detector;
+        MotionGate motionGate;
+        Preprocessor preprocessor;
+        TiledInput tiledInput;
+        TrackingStage stage;
+
+        // Reused between frames
+        cv::Mat blob;
+        std::vector<cv::Mat> outputs;
+        std::vector<DecodeParams> decodeParams;
+
+        FrameEngineStats engineStats;
+};
@@ -0,0 +1,181 @@
+#include "http_server.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+// A client silent or stalled for this long is dropped
+static const int ioTimeoutSeconds = 5;
+
+static const char* reasonPhrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+HttpServer::HttpServer(int port) : port(port) {}
+
+HttpServer::~HttpServer() {
+    stop();
+}
+
+void HttpServer::handle(const string& prefix, HttpHandler handler) {
+    routes.emplace_back(prefix, std::move(handler));
+}
+
+bool HttpServer::start() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        cerr << "HTTP server: socket failed: " << strerror(errno) << endl;
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 8) < 0) {
+        cerr << "HTTP server: cannot listen on port " << port << ": " << strerror(errno) << endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    running = true;
+    acceptThread = thread(&HttpServer::acceptLoop, this);
+    return true;
+}
+
+void HttpServer::stop() {
+    if (!running.exchange(false)) return;
+
+    // Shutting the socket down wakes accept() up
+    shutdown(listenFd, SHUT_RDWR);
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    close(listenFd);
+    listenFd = -1;
+
+    // Wake up handlers blocked on a client that sends nothing or reads nothing
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (auto& connection : connections) {
+            if (connection->fd >= 0) shutdown(connection->fd, SHUT_RDWR);
+        }
+    }
+    reapConnections(true);
+}
+
+bool HttpServer::writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool HttpServer::sendResponse(int fd, int status, const string& contentType, const string& body) {
+    ostringstream header;
+    header << "HTTP/1.0 " << status << " " << reasonPhrase(status) << "\r\n"
+           << "Content-Type: " << contentType << "\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: close\r\n\r\n";
+    string text = header.str();
+    return writeAll(fd, text.data(), text.size()) && writeAll(fd, body.data(), body.size());
+}
+
+void HttpServer::acceptLoop() {
+    while (running) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        timeval timeout{ioTimeoutSeconds, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        reapConnections(false);
+        lock_guard<mutex> lock(connectionsMutex);
+        connections.push_back(make_unique<Connection>());
+        Connection* connection = connections.back().get();
+        connection->fd = fd;
+        connection->thread = thread(&HttpServer::serve, this, fd, connection);
+    }
+}
+
+void HttpServer::serve(int fd, Connection* connection) {
+    // Only the request line matters, read until the end of the headers
+    string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == string::npos && request.size() < 8192) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        request.append(buffer, n);
+    }
+
+    HttpRequest parsed;
+    istringstream line(request.substr(0, request.find("\r\n")));
+    line >> parsed.method >> parsed.path;
+
+    bool handled = false;
+    for (const auto& [prefix, handler] : routes) {
+        if (parsed.path.compare(0, prefix.size(), prefix) == 0) {
+            handler(fd, parsed);
+            handled = true;
+            break;
+        }
+    }
+    if (!handled) {
+        sendResponse(fd, 404, "text/plain", "Not found\n");
+    }
+
+    {
+        // Under the lock so stop() never shuts down a descriptor that has been reused
+        lock_guard<mutex> lock(connectionsMutex);
+        close(fd);
+        connection->fd = -1;
+    }
+    connection->done = true;
+}
+
+void HttpServer::reapConnections(bool all) {
+    // Joined outside the lock, which serve() takes to close its socket
+    list<unique_ptr<Connection>> finished;
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (auto it = connections.begin(); it != connections.end(); ) {
+            auto following = next(it);
+            if (all || (*it)->done) finished.splice(finished.end(), connections, it);
+            it = following;
+        }
+    }
+    for (auto& connection : finished) {
+        if (connection->thread.joinable()) connection->thread.join();
+    }
+}
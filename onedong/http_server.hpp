@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+};
+
+// Handlers own the connection for as long as they run; the socket is closed when they return
+using HttpHandler = std::function<void(int fd, const HttpRequest& request)>;
+
+// Tiny blocking HTTP/1.0 server for on-device debugging and monitoring endpoints.
+// One thread accepts, each connection gets its own thread, which suits a handful of clients.
+class HttpServer {
+    public:
+        explicit HttpServer(int port);
+        ~HttpServer();
+
+        // Routes match on path prefix, first registered wins. Register before start().
+        void handle(const std::string& prefix, HttpHandler handler);
+        bool start();
+        void stop();
+        bool isRunning() const { return running; }
+
+        // Never raise SIGPIPE; return false once the client has gone away
+        static bool writeAll(int fd, const void* data, size_t size);
+        static bool sendResponse(int fd, int status, const std::string& contentType, const std::string& body);
+
+    private:
+        struct Connection {
+            std::thread thread;
+            int fd = -1; // Guarded by connectionsMutex, -1 once closed
+            std::atomic<bool> done{false};
+        };
+
+        void acceptLoop();
+        void serve(int fd, Connection* connection);
+        void reapConnections(bool all);
+
+        int port;
+        int listenFd = -1;
+        std::atomic<bool> running{false};
+        std::thread acceptThread;
+        std::vector<std::pair<std::string, HttpHandler>> routes;
+        std::mutex connectionsMutex;
+        std::list<std::unique_ptr<Connection>> connections;
+};
@@ -0,0 +1,87 @@
+#include "kalman.hpp"
+
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+typedef Matx<float, 4, 1> Measurement;
+
+static Measurement toMeasurement(const Rect& box) {
+    float height = max(box.height, 1);
+    return Measurement(box.x + box.width * 0.5f, box.y + box.height * 0.5f, box.width / height, height);
+}
+
+KalmanBoxFilter::KalmanBoxFilter() : motion(KalmanCovariance::eye()) {
+    for (int i = 0; i < 4; i++) {
+        motion(i, 4 + i) = 1.0f;
+    }
+}
+
+KalmanState KalmanBoxFilter::initiate(const Rect& box) const {
+    Measurement z = toMeasurement(box);
+    float h = z(3);
+    const float sigma[8] = {
+        2 * positionWeight * h, 2 * positionWeight * h, 1e-2f, 2 * positionWeight * h,
+        10 * velocityWeight * h, 10 * velocityWeight * h, 1e-5f, 10 * velocityWeight * h,
+    };
+
+    KalmanState state;
+    state.mean = KalmanMean::zeros();
+    state.covariance = KalmanCovariance::zeros();
+    for (int i = 0; i < 4; i++) {
+        state.mean(i) = z(i);
+    }
+    for (int i = 0; i < 8; i++) {
+        state.covariance(i, i) = sigma[i] * sigma[i];
+    }
+    return state;
+}
+
+void KalmanBoxFilter::predict(KalmanState& state, float steps) const {
+    float h = state.mean(3);
+    const float sigma[8] = {
+        positionWeight * h, positionWeight * h, 1e-2f, positionWeight * h,
+        velocityWeight * h, velocityWeight * h, 1e-5f, velocityWeight * h,
+    };
+
+    if (steps == 1.0f) {
+        state.mean = motion * state.mean;
+        state.covariance = motion * state.covariance * motion.t();
+    } else {
+        KalmanCovariance stepped = motion;
+        for (int i = 0; i < 4; i++) {
+            stepped(i, 4 + i) = steps;
+        }
+        state.mean = stepped * state.mean;
+        state.covariance = stepped * state.covariance * stepped.t();
+    }
+    // Process noise is a random walk, so its variance grows linearly with the time step
+    for (int i = 0; i < 8; i++) {
+        state.covariance(i, i) += sigma[i] * sigma[i] * steps;
+    }
+}
+
+void KalmanBoxFilter::update(KalmanState& state, const Rect& box) const {
+    Measurement z = toMeasurement(box);
+    float h = state.mean(3);
+    const float sigma[4] = {positionWeight * h, positionWeight * h, 1e-1f, positionWeight * h};
+
+    // The measurement picks the first four state entries, so H P H^T and P H^T are just blocks of P
+    Matx<float, 8, 4> crossCovariance = state.covariance.get_minor<8, 4>(0, 0);
+    Matx44f innovationCovariance = state.covariance.get_minor<4, 4>(0, 0);
+    for (int i = 0; i < 4; i++) {
+        innovationCovariance(i, i) += sigma[i] * sigma[i];
+    }
+
+    Matx<float, 8, 4> gain = crossCovariance * innovationCovariance.inv(DECOMP_CHOLESKY);
+    state.mean += gain * (z - state.mean.get_minor<4, 1>(0, 0));
+    state.covariance -= gain * crossCovariance.t();
+}
+
+Rect KalmanBoxFilter::toRect(const KalmanState& state) {
+    float height = state.mean(3);
+    float width = state.mean(2) * height;
+    return Rect(static_cast<int>(lround(state.mean(0) - width * 0.5f)), static_cast<int>(lround(state.mean(1) - height * 0.5f)),
+                static_cast<int>(lround(width)), static_cast<int>(lround(height)));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+// State is (center x, center y, aspect ratio w/h, height) followed by their velocities per frame
+typedef cv::Matx<float, 8, 1> KalmanMean;
+typedef cv::Matx<float, 8, 8> KalmanCovariance;
+
+struct KalmanState {
+    KalmanMean mean;
+    KalmanCovariance covariance;
+};
+
+// Constant-velocity Kalman filter for bounding boxes, with the noise model from SORT/ByteTrack:
+// uncertainty scales with box height. Only fixed-size cv::Matx arithmetic, so predicting and
+// correcting thousands of tracks never touches the heap.
+class KalmanBoxFilter {
+    public:
+        KalmanBoxFilter();
+
+        // New track at a box, with unknown velocity
+        KalmanState initiate(const cv::Rect& box) const;
+        // Advances one frame, or `steps` frames (fractional too) when frames were skipped
+        void predict(KalmanState& state, float steps = 1.0f) const;
+        // Corrects with a measured box
+        void update(KalmanState& state, const cv::Rect& box) const;
+
+        static cv::Rect toRect(const KalmanState& state);
+
+    private:
+        KalmanCovariance motion; // x' = x + v
+        float positionWeight = 1.0f / 20;
+        float velocityWeight = 1.0f / 160;
+};
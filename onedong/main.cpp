@@ -1,302 +1,586 @@
 #include "opencv2/videoio.hpp"
 #include <cmath>
+#include <csignal>
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
-#include <opencv2/core/ocl.hpp>
 #include <iostream>
-#include <fstream>
-#include <curl/curl.h>
 #include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+
+#include "backend.hpp"
+#include "bytetracker.hpp"
+#include "capture.hpp"
+#include "counter.hpp"
+#include "debug_stream.hpp"
+#include "detection_log.hpp"
+#include "detector.hpp"
+#include "edge_bus.hpp"
+#include "metrics.hpp"
+#include "model_cache.hpp"
+#include "multicam.hpp"
+#include "nms.hpp"
+#include "pipeline.hpp"
+#include "reid.hpp"
+#include "render.hpp"
+#include "runtime_config.hpp"
+#include "stereo.hpp"
+#include "tiling.hpp"
+#include "tracking_stage.hpp"
+#include "uplink.hpp"
+#include "yolo_decoder.hpp"
 
 using namespace cv;
 using namespace dnn;
 using namespace std;
 
-void sendHttpRequest(const string& url, const string& jsonPayload) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        cerr << "Failed to initialize CURL" << endl;
-        return;
+// Set from SIGINT/SIGTERM so headless units shut down cleanly (stats printed, uplink spooled)
+static volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Everything the frame loops hand their results to
+struct RunContext {
+    EventUplink* uplink = nullptr;
+    EdgePublisher* edge = nullptr; // Takes crossings ahead of the uplink when an aggregator runs
+    bool headless = false;
+    DebugStream* debugStream = nullptr;
+    StartupTimeline* startup = nullptr;
+};
+
+// Hands crossings to the edge aggregator, or to the uplink when none is running; the frame loop
+// never waits on the network
+void publishEvents(const vector<CrossingEvent>& events, const RunContext& context) {
+    for (const auto& event : events) {
+        (event.kind == EventKind::Entry ? hotPathMetrics.entries : hotPathMetrics.exits).add();
+        cout << (event.kind == EventKind::Entry ? "Entry" : "Exit") << " at entrance " << event.entrance
+             << " by track " << event.trackId << endl;
+        if (context.edge && context.edge->publish(event.kind, event.entrance, event.trackId, event.time)) {
+            continue;
+        }
+        if (context.uplink) {
+            context.uplink->enqueue({event.kind, event.entrance, isoTimestamp(event.time)});
+        }
     }
+}
+
+// Draws only when someone will look at the result: the local window, or a debug stream client
+void presentFrame(Mat& frame, const TrackView& tracks, const vector<CountingZone>& zones,
+                  const RunContext& context, int channel, const string& windowName) {
+    bool stream = context.debugStream && context.debugStream->wantsFrame(channel);
+    if (context.headless && !stream) return;
+
+    drawZones(frame, zones);
+    drawTracks(frame, tracks);
+    if (stream) {
+        context.debugStream->publish(frame, channel);
+    }
+    if (!context.headless) {
+        imshow(windowName, frame);
+    }
+}
 
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+// Break on 'q' key press, or on a signal
+bool keepRunning(const RunContext& context) {
+    if (stopRequested) return false;
+    return context.headless || waitKey(1) != 'q';
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonPayload.c_str());
+int runMultiCamera(Detector& detector, const vector<string>& sources, const PipelineConfig& config,
+                   const CaptureConfig& capture, const RuntimeConfig& runtime, const RunContext& context) {
+    MultiCameraEngine engine(detector, sources, runtime, config.motionGate, config.preprocess, capture);
+    if (context.startup) context.startup->mark("sources opened");
 
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        cerr << "CURL request failed: " << curl_easy_strerror(res) << endl;
+    while (engine.tick()) {
+        if (context.startup && !context.startup->reached("first detection")) {
+            context.startup->mark("first detection");
+            context.startup->print(cout);
+        }
+        auto& cams = engine.cameras();
+        size_t activeTracks = 0;
+        for (const auto& cam : cams) {
+            activeTracks += cam.tracks.size();
+        }
+        hotPathMetrics.activeTracks.set(activeTracks);
+        if (context.edge) context.edge->setActiveTracks(activeTracks);
+        for (int i = 0; i < static_cast<int>(cams.size()); i++) {
+            if (!cams[i].live) continue;
+            publishEvents(cams[i].stage.events(), context);
+            presentFrame(cams[i].frame, cams[i].tracks, cams[i].stage.counter().zones(), context, i,
+                         "Human Detection - " + cams[i].source);
+        }
+
+        if (!keepRunning(context)) {
+            break;
+        }
     }
 
-    curl_easy_cleanup(curl);
+    engine.printStats(cout);
+    if (!context.headless) destroyAllWindows();
+    return 0;
 }
 
-struct Detection {
-    int id;
-    Rect bbox;
-    float confidence;
-    bool matched = false;
-    Scalar color;
-    int killCount = 0;
+// Flags that also have a config file key. They win over the file, on every reload too.
+struct Overrides {
+    vector<string> sources;
+    vector<CountingZone> zones;
+    string server;
+    vector<string> trackParams; // name=value, already checked
+    DetectorConfig detector;    // Backend, threads and cache always come from here
+    bool detectorSet = false;   // --detector given, the model too
+    NmsMethod nmsMethod = NmsMethod::Greedy;
+    bool nmsMethodSet = false;
 };
 
-float computeIoU(const Rect& box1, const Rect& box2) {
-    float intersection = (box1 & box2).area();
-    float unionArea = box1.area() + box2.area() - intersection;
-    return intersection / unionArea;
+// With several sources every zone has to say which one it is drawn on
+bool checkZoneSources(const vector<CountingZone>& zones, size_t sourceCount) {
+    for (const auto& zone : zones) {
+        if (zone.source < 0 && sourceCount > 1) {
+            cerr << "Error: Zone for entrance " << zone.entrance << " needs its source with several sources, "
+                 << "expected source:entrance:x1,y1,x2,y2[,...]" << endl;
+            return false;
+        }
+        if (sourceCount > 0 && zone.source >= static_cast<int>(sourceCount)) {
+            cerr << "Error: Zone for entrance " << zone.entrance << " is on source " << zone.source
+                 << ", but there are only " << sourceCount << " sources" << endl;
+            return false;
+        }
+    }
+    return true;
 }
 
-class ByteTrack {
-    private:
-        vector<Detection> activeTracks;
-        int nextID = 1;
-        int maxKillCount = 15;
-        float iouThresholdLow = 0.4;
-        float iouThresholdHigh = 0.3;
-        float confThresholdHigh = 0.6; // Threshold for high-confidence detections
-        float confThresholdLow = 0.1;  // Threshold for low-confidence detections
-    
-    public:
-        vector<Detection> update(vector<Detection>& detections) {
-            vector<Detection> highConfDetections;
-            vector<Detection> lowConfDetections;
-            vector<Detection> unmatchedTracks;
-    
-            // Separate high and low-confidence detections
-            for (auto& det : detections) {
-                if (det.confidence > confThresholdHigh) {
-                    highConfDetections.push_back(det);
-                } else if (det.confidence > confThresholdLow) {
-                    lowConfDetections.push_back(det);
-                }
-            }
-    
-            // Step 1: Match high-confidence detections to existing tracks
-            for (auto& track : activeTracks) {
-                track.matched = false; // Set all of the classes tracks to be unmatched
-
-                float highestIoU = 0.0;
-                Detection* bestDetection;
-                for (auto& det : highConfDetections) {
-                    float IoU = computeIoU(track.bbox, det.bbox);
-                    if (IoU > highestIoU) {
-                        highestIoU = IoU;
-                        bestDetection = &det;
-                    }
-                }
+void applyOverrides(const Overrides& cli, RuntimeConfig& config) {
+    if (!cli.sources.empty()) config.sources = cli.sources;
+    if (!cli.zones.empty()) config.zones = cli.zones;
+    if (!cli.server.empty()) config.server = cli.server;
+    if (cli.nmsMethodSet) config.nms.method = cli.nmsMethod;
+    for (const auto& param : cli.trackParams) {
+        parseByteTrackParam(param, config.tracker);
+    }
+    Size fileInputSize = config.detector.inputSize;
+    if (cli.detectorSet) {
+        config.detector = cli.detector;
+    } else {
+        config.detector.backend = cli.detector.backend;
+        config.detector.threads = cli.detector.threads;
+        config.detector.cacheDir = cli.detector.cacheDir;
+    }
+    config.detector.inputSize = cli.detector.inputSize.empty() ? fileInputSize : cli.detector.inputSize;
+}
 
-                if (highestIoU > iouThresholdHigh) {
-                    track.bbox = bestDetection->bbox;
-                    track.confidence = bestDetection->confidence;
+bool sameModel(const DetectorConfig& a, const DetectorConfig& b) {
+    return a.kind == b.kind && a.model == b.model && a.config == b.config && a.inputSize == b.inputSize;
+}
 
-                    track.killCount = 0;
-                    track.matched = true;
-                    bestDetection->matched = true;
-                }
-                
-                if (!track.matched) {
-                    
-                    highestIoU = 0.0;
-                    // Step 2: Attempt to assign unmatched tracks to low-confidence detections
-                    for (auto& det : lowConfDetections) {
-                        float IoU = computeIoU(track.bbox, det.bbox);
-                        if (IoU > highestIoU) {
-                            highestIoU = IoU;
-                            bestDetection = &det;
-                        }
-                    }
-                    if (highestIoU > iouThresholdLow) {
-                        track.bbox = bestDetection->bbox;
-                        track.confidence = bestDetection->confidence;
-    
-                        track.killCount = 0;
-                        track.matched = true;
-                        bestDetection->matched = true;
-                    }
-                }
-                
+int main(int argc, char* argv[]) {
+    StartupTimeline startup;
+    Overrides cli;
+    string configPath;
+    PipelineConfig pipelineConfig;
+    RunContext context;
+    unique_ptr<EventUplink> uplink;
+    string aggregatorBus;
+    int debugPort = 0;
+    double debugFps = 2.0;
+    int metricsPort = 0;
+    StereoConfig stereoConfig;
+    ReidConfig reidConfig;
+    CaptureConfig captureConfig;
+    string recordPath;
+    bool prepareOnly = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc) {
+            pipelineConfig.queueDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--drop-policy") == 0 && i + 1 < argc) {
+            string policy = argv[++i];
+            pipelineConfig.dropPolicy = policy == "latest" ? DropPolicy::KeepLatest : DropPolicy::KeepAll;
+        } else if (strcmp(argv[i], "--zone") == 0 && i + 1 < argc) {
+            CountingZone zone;
+            if (!parseZone(argv[++i], zone)) {
+                cerr << "Error: Bad zone " << argv[i] << ", expected [source:]entrance:x1,y1,x2,y2[,...]" << endl;
+                return -1;
             }
-    
-            // Step 3: Remove those who have been missing for longer than maxKillCount frames
-            for (auto it = activeTracks.begin(); it != activeTracks.end(); ) {
-                auto& track = *it;
-            
-                if (!track.matched) {
-                    track.killCount++;
-                    
-                    // If the track has been unmatched for too long, remove it
-                    if (track.killCount > maxKillCount) {
-                        // Track should be removed from activeTracks, so we erase it
-                        it = activeTracks.erase(it);  // erase returns the next iterator
-                    } else {
-                        // If not removed, just move to the next track
-                        ++it;
-                    }
-                } else {
-                    // If track is matched, move to the next track
-                    ++it;
-                }
+            cli.zones.push_back(zone);
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            cli.server = argv[++i];
+        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            configPath = argv[++i];
+        } else if (strcmp(argv[i], "--motion-gate") == 0) {
+            pipelineConfig.motionGate.enabled = true;
+        } else if (strcmp(argv[i], "--motion-roi") == 0 && i + 1 < argc) {
+            Rect& roi = pipelineConfig.motionGate.roi;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &roi.x, &roi.y, &roi.width, &roi.height) != 4) {
+                cerr << "Error: Bad motion ROI " << argv[i] << ", expected x,y,width,height" << endl;
+                return -1;
             }
-            
-    
-            // Step 4: Create new tracks for unmatched high-confidence detections
-            for (auto& det : highConfDetections) {
-                if (!det.matched) {
-                    det.id = nextID++;
-                    det.color = Scalar(rand() % 255, rand() % 255, rand() % 255);
-                    activeTracks.push_back(det);
-                }
+        } else if (strcmp(argv[i], "--keep-alive") == 0 && i + 1 < argc) {
+            pipelineConfig.motionGate.keepAliveFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            Rect tile;
+            if (!parseTile(argv[++i], tile)) {
+                cerr << "Error: Bad tile " << argv[i] << ", expected x,y,width,height" << endl;
+                return -1;
+            }
+            pipelineConfig.tiles.push_back(tile);
+        } else if (strcmp(argv[i], "--letterbox") == 0) {
+            pipelineConfig.preprocess.letterbox = true;
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (!parseBackend(argv[++i], cli.detector.backend)) {
+                cerr << "Error: Unknown backend " << argv[i] << ", expected auto, cuda, opencl or cpu" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--detector") == 0 && i + 1 < argc) {
+            if (!parseDetector(argv[++i], cli.detector)) {
+                cerr << "Error: Bad detector " << argv[i] << ", expected dnn[:model[:config]] or onnx:model.onnx" << endl;
+                return -1;
+            }
+            cli.detectorSet = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            cli.detector.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--model-cache") == 0 && i + 1 < argc) {
+            cli.detector.cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--input-size") == 0 && i + 1 < argc) {
+            if (!parseInputSize(argv[++i], cli.detector.inputSize)) {
+                cerr << "Error: Bad input size " << argv[i] << ", expected WIDTHxHEIGHT in multiples of 32" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--prepare") == 0) {
+            prepareOnly = true;
+        } else if (strcmp(argv[i], "--capture-size") == 0 && i + 1 < argc) {
+            if (!parseCaptureSize(argv[++i], captureConfig.width, captureConfig.height)) {
+                cerr << "Error: Bad capture size " << argv[i] << ", expected WIDTHxHEIGHT" << endl;
+                return -1;
             }
-    
-            return activeTracks;
+        } else if (strcmp(argv[i], "--capture-fps") == 0 && i + 1 < argc) {
+            captureConfig.fps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--pixel-format") == 0 && i + 1 < argc) {
+            if (!parsePixelFormat(argv[++i], captureConfig.format)) {
+                cerr << "Error: Unknown pixel format " << argv[i] << ", expected auto, mjpeg or yuyv" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--capture-buffers") == 0 && i + 1 < argc) {
+            captureConfig.buffers = max(2, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--latest-only") == 0) {
+            captureConfig.latestOnly = true;
+        } else if (strcmp(argv[i], "--stereo") == 0 && i + 1 < argc) {
+            stereoConfig.rightSource = argv[++i];
+        } else if (strcmp(argv[i], "--calibration") == 0 && i + 1 < argc) {
+            stereoConfig.calibration = argv[++i];
+        } else if (strcmp(argv[i], "--depth-range") == 0 && i + 1 < argc) {
+            if (!parseDepthRange(argv[++i], stereoConfig.minDepth, stereoConfig.maxDepth)) {
+                cerr << "Error: Bad depth range " << argv[i] << ", expected min,max" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--depth-gap") == 0 && i + 1 < argc) {
+            stereoConfig.maxDepthGap = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--reid") == 0 && i + 1 < argc) {
+            reidConfig.model = argv[++i];
+        } else if (strcmp(argv[i], "--reid-every") == 0 && i + 1 < argc) {
+            reidConfig.every = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--reid-threshold") == 0 && i + 1 < argc) {
+            reidConfig.minSimilarity = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--track-param") == 0 && i + 1 < argc) {
+            ByteTrackConfig check;
+            if (!parseByteTrackParam(argv[++i], check)) {
+                cerr << "Error: Bad tracker parameter " << argv[i]
+                     << ", expected max-kill|iou-high|iou-low|conf-high|conf-low=value" << endl;
+                return -1;
+            }
+            cli.trackParams.push_back(argv[i]);
+        } else if (strcmp(argv[i], "--nms") == 0 && i + 1 < argc) {
+            if (!parseNmsMethod(argv[++i], cli.nmsMethod)) {
+                cerr << "Error: Unknown NMS method " << argv[i] << ", expected greedy, matrix or opencv" << endl;
+                return -1;
+            }
+            cli.nmsMethodSet = true;
+        } else if (strcmp(argv[i], "--aggregator") == 0 && i + 1 < argc) {
+            aggregatorBus = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            context.headless = true;
+        } else if (strcmp(argv[i], "--debug-port") == 0 && i + 1 < argc) {
+            debugPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--debug-fps") == 0 && i + 1 < argc) {
+            debugFps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metricsPort = atoi(argv[++i]);
+        } else {
+            cli.sources.push_back(argv[i]);
+            std::cout << "Received image path: " << argv[i] << '\n';
         }
+    }
 
-    };
+    RuntimeConfig runtime;
+    if (!configPath.empty() && !loadRuntimeConfig(configPath, runtime)) {
+        return -1;
+    }
+    applyOverrides(cli, runtime);
+    vector<string> sources = runtime.sources;
+    if (sources.empty() && !prepareOnly) {
+        cerr << "Error: No source, give a video file, RTSP URL or camera index, or sources in --config" << endl;
+        return -1;
+    }
+    if (!checkZoneSources(runtime.zones, sources.size())) {
+        return -1;
+    }
+    if (!runtime.server.empty()) {
+        UplinkConfig uplinkConfig;
+        uplinkConfig.baseUrl = runtime.server;
+        uplink = make_unique<EventUplink>(uplinkConfig);
+    }
+    context.uplink = uplink.get();
+    unique_ptr<EdgePublisher> edgePublisher;
+    if (!aggregatorBus.empty()) {
+        edgePublisher = make_unique<EdgePublisher>(aggregatorBus);
+        context.edge = edgePublisher.get();
+    }
+    context.startup = &startup;
 
-int main(int argc, char* argv[]) {
-    std::string imagePath = "WIN_20250303_10_21_48_Pro.mp4";
-    if (argc > 1) {
-        imagePath = argv[1];
-        std::cout << "Received image path: " << imagePath << '\n';
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    unique_ptr<DebugStream> debugStream;
+    if (debugPort > 0) {
+        debugStream = make_unique<DebugStream>(debugPort, debugFps, static_cast<int>(sources.size()));
+        if (debugStream->start()) {
+            cout << "Debug stream on http://0.0.0.0:" << debugPort << "/stream" << endl;
+            context.debugStream = debugStream.get();
+        }
     }
 
-    // Load YOLO model
-    Net net = readNet("yolov7-tiny.weights", "yolov7-tiny.cfg");
-
-    // Set the backend and target
-    if (cv::cuda::getCudaEnabledDeviceCount() > 0) {
-        // If CUDA is available, use it
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
-        cout << "Using CUDA backend" << endl;
-    } 
-    else if (cv::ocl::haveOpenCL()) {
-        // If OpenCL is available, use it
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_OPENCL);
-        cout << "Using OpenCL backend" << endl;
-    } 
-    else {
-        // Fall back to CPU if neither CUDA nor OpenCL is available
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-        cout << "Using CPU backend" << endl;
+    // Scraped by Prometheus; the frame loops only ever touch their own counters
+    MetricsRegistry metricsRegistry;
+    unique_ptr<MetricsServer> metricsServer;
+    if (metricsPort > 0) {
+        registerHotPathMetrics(metricsRegistry);
+        if (uplink) {
+            EventUplink* u = uplink.get();
+            metricsRegistry.addGauge("onedong_uplink_pending_events", "Events not yet accepted by the server",
+                                     [u] { return u->pending(); });
+            metricsRegistry.addCounter("onedong_uplink_sent_events_total", "Events accepted by the server",
+                                       [u] { return u->sent(); });
+            metricsRegistry.addCounter("onedong_uplink_dropped_events_total", "Events lost to a full queue or spool",
+                                       [u] { return u->dropped(); });
+        }
+        metricsServer = make_unique<MetricsServer>(metricsPort, metricsRegistry);
+        if (metricsServer->start()) {
+            cout << "Metrics on http://0.0.0.0:" << metricsPort << "/metrics" << endl;
+        }
     }
 
-    vector<string> layerNames = net.getUnconnectedOutLayersNames();
+    // Load YOLO model on the chosen runtime and backend
+    if (!runtime.detector.cacheDir.empty() && !prepareModelCache(runtime.detector.cacheDir)) {
+        return -1;
+    }
+    unique_ptr<Detector> detector = createDetector(runtime.detector);
+    if (!detector) {
+        return -1;
+    }
+    startup.mark("model loaded");
+    pipelineConfig.preprocess.inputSize = detector->inputSize();
+    cout << "Using " << detector->name() << endl;
+    cout << "YOLO decode path: " << decodeSimdName() << endl;
+
+    // Pay for fusion and kernel compilation now, with the batch size the frame loop will use
+    int batchSize = sources.size() > 1 ? static_cast<int>(sources.size())
+                                       : max(1, static_cast<int>(pipelineConfig.tiles.size()));
+    detector->warmUp(batchSize);
+    startup.mark("warmed up");
+    if (prepareOnly) {
+        startup.print(cout);
+        return 0;
+    }
+
+    // Several sources share the one network through batched inference
+    if (sources.size() > 1) {
+        if (!pipelineConfig.tiles.empty()) {
+            cerr << "Warning: --tile applies to a single source, ignoring it" << endl;
+        }
+        if (!stereoConfig.rightSource.empty()) {
+            cerr << "Warning: --stereo applies to a single source, ignoring it" << endl;
+        }
+        if (!reidConfig.model.empty()) {
+            cerr << "Warning: --reid applies to a single source, ignoring it" << endl;
+        }
+        if (!recordPath.empty()) {
+            cerr << "Warning: --record applies to a single source, ignoring it" << endl;
+        }
+        if (!configPath.empty()) {
+            cerr << "Warning: --config is only read at start with several sources" << endl;
+        }
+        return runMultiCamera(*detector, sources, pipelineConfig, captureConfig, runtime, context);
+    }
 
-    // Load class labels (COCO dataset labels)
-    vector<string> classes;
-    ifstream ifs("coco.names");
-    string line;
-    while (getline(ifs, line)) {
-        classes.push_back(line);
+    // Both stereo cameras have to run at the size they were calibrated at
+    unique_ptr<StereoRig> stereoRig;
+    if (!stereoConfig.rightSource.empty()) {
+        stereoRig = make_unique<StereoRig>(stereoConfig);
+        if (!stereoRig->loadCalibration()) {
+            return -1;
+        }
+        captureConfig.width = stereoRig->calibration().imageSize.width;
+        captureConfig.height = stereoRig->calibration().imageSize.height;
     }
 
     // Open the laptop camera (use 0 for default webcam)
-    VideoCapture cap(imagePath, cv::CAP_FFMPEG);
-    if (!cap.isOpened()) {
-        cerr << "Error: Cannot open webcam" << endl;
+    unique_ptr<CaptureSource> capture = openCapture(sources[0], captureConfig);
+    if (!capture) {
         return -1;
     }
+    cout << "Capturing " << capture->describe() << endl;
+    unique_ptr<StereoDepth> stereoDepth;
+    if (stereoRig) {
+        if (!stereoRig->open(captureConfig)) {
+            return -1;
+        }
+        stereoDepth = make_unique<StereoDepth>(*stereoRig);
+    }
+    startup.mark("sources opened");
 
-    ByteTrack tracker;
-    
-    while (true) {
-        Mat frame;
-        cap >> frame;
-        if (frame.empty()) break;
-
-        vector<Detection> detections;
-
-        // Prepare input blob for YOLOv7
-        Mat blob;
-        blobFromImage(frame, blob, 0.00392, Size(640, 640), Scalar(0, 0, 0), true, false);
-        net.setInput(blob);
-
-        // Perform forward pass and get output layers
-        vector<Mat> outputs;
-        net.forward(outputs, layerNames);
-
-        vector<int> classIds;
-        vector<float> confidences;
-        vector<Rect> boxes;
-
-        // Process the outputs
-        for (const auto& output : outputs) {
-            for (int i = 0; i < output.rows; i++) {
-                const float* data = output.ptr<float>(i);
-                vector<float> scores(data + 5, data + output.cols);
-                int classId = max_element(scores.begin(), scores.end()) - scores.begin();
-                float confidence = scores[classId];; // Confidence score for each detected object
-    
-                if (confidence > 0.1 && classId == 0) {
-                    // The data format depends on YOLO model
-                    // YOLOv7 has 4 values for bbox (x_center, y_center, width, height) followed by class scores
-    
-                    int centerX = static_cast<int>(data[0] * frame.cols);
-                    int centerY = static_cast<int>(data[1] * frame.rows);
-                    int width = static_cast<int>(data[2] * frame.cols);
-                    int height = static_cast<int>(data[3] * frame.rows);
-    
-                    // Create a Rect bounding box around the detected object
-                    int x = centerX - width / 2;
-                    int y = centerY - height / 2;
-                    Rect box(x, y, width, height);
-    
-                    // Push detected class IDs, confidence, and bounding box coordinates
-                    confidences.push_back(confidence);
-                    boxes.push_back(box);
-                    classIds.push_back(0);  // Assuming we're detecting "people" (class 0 in COCO dataset)
+    // Detections as they go into the tracker, for replaying tracking and counting without the network
+    DetectionLogWriter detectionLog;
+    if (!recordPath.empty() && !detectionLog.open(recordPath, capture->fps())) {
+        return -1;
+    }
+
+    TrackingStage stage(runtime);
+    // Prediction follows capture timestamps, so frames dropped anywhere upstream still move tracks
+    stage.tracker().setFramePeriod(capture->fps() > 0 ? 1.0 / capture->fps() : 0.0);
+    stage.tracker().setDepthGate(stereoConfig.maxDepthGap);
+    stage.setStereo(stereoDepth.get());
+    if (!recordPath.empty()) stage.setRecorder(&detectionLog);
+    unique_ptr<ReidStage> reid;
+    if (!reidConfig.model.empty()) {
+        reid = make_unique<ReidStage>(reidConfig);
+        if (!reid->ready()) {
+            return -1;
+        }
+        stage.setReid(reid.get());
+    }
+    // An id ReID gives back resumes from the side it was last seen on
+    auto counterRetention = [&reidConfig](const ByteTrackConfig& tracking) {
+        return max<uint64_t>(64, static_cast<uint64_t>(tracking.maxKillCount) + reidConfig.maxLostFrames);
+    };
+    if (reid) stage.counter().setRetention(counterRetention(runtime.tracker));
+    Pipeline pipeline(*capture, *detector, pipelineConfig, stereoRig.get());
+    pipeline.exportMetrics(metricsRegistry);
+    pipeline.start();
+
+    // A saved --config is applied between two frames, tracks and counts carry over. Only a
+    // different model reloads the network, in the background while the old one keeps running.
+    unique_ptr<ConfigWatcher> configWatcher;
+    if (!configPath.empty()) {
+        configWatcher = make_unique<ConfigWatcher>(configPath);
+        if (!configWatcher->start()) configWatcher.reset();
+    }
+    DetectorConfig currentModel = runtime.detector;
+    DetectorConfig loadingModel;
+    future<unique_ptr<Detector>> loadingDetector;
+    unique_ptr<Detector> retiredDetector; // Until the last job it ran on is decoded
+
+    FrameJob job;
+    while (pipeline.next(job)) {
+        auto trackBegin = chrono::steady_clock::now();
+        Mat& frame = job.frame;
+
+        if (configWatcher && configWatcher->changed()) {
+            RuntimeConfig next;
+            bool loaded = loadRuntimeConfig(configPath, next);
+            if (loaded) applyOverrides(cli, next);
+            if (loaded && checkZoneSources(next.zones, sources.size())) {
+                stage.setConfig(next);
+                if (reid) stage.counter().setRetention(counterRetention(next.tracker));
+                if (next.server != runtime.server) {
+                    if (uplink && !next.server.empty()) {
+                        uplink->setBaseUrl(next.server);
+                    } else {
+                        cerr << "Warning: Turning the uplink on or off takes a restart" << endl;
+                        next.server = runtime.server;
+                    }
                 }
+                if (!sameModel(next.detector, currentModel)) {
+                    if (loadingDetector.valid()) {
+                        cerr << "Warning: Still loading " << loadingModel.model << ", save again once it is in use"
+                             << endl;
+                    } else {
+                        loadingModel = next.detector;
+                        loadingDetector = async(launch::async, [model = loadingModel, batchSize] {
+                            unique_ptr<Detector> loaded = createDetector(model);
+                            if (loaded) loaded->warmUp(batchSize);
+                            return loaded;
+                        });
+                    }
+                }
+                runtime = next;
+                cout << "Reloaded " << configPath << endl;
             }
         }
-
-        // Apply Non-Maximum Suppression (NMS) to remove overlapping bounding boxes
-        vector<int> indices;
-        dnn::NMSBoxes(boxes, confidences, 0.1, 0.65, indices);
-
-        // Store final detections with unique IDs
-        for (int i : indices) {
-            Detection detection;
-            detection.bbox = boxes[i];
-            detection.confidence = confidences[i];
-            detection.id = -1;  // ID will be assigned later during tracking
-            detections.push_back(detection);
+        if (loadingDetector.valid() && loadingDetector.wait_for(chrono::seconds(0)) == future_status::ready) {
+            unique_ptr<Detector> loaded = loadingDetector.get();
+            if (loaded && loaded->inputSize() != detector->inputSize()) {
+                cerr << "Warning: " << loadingModel.model << " takes a different input size, restart to use it" << endl;
+            } else if (loaded) {
+                pipeline.replaceDetector(*loaded);
+                retiredDetector = std::move(detector);
+                detector = std::move(loaded);
+                currentModel = loadingModel;
+                cout << "Using " << detector->name() << endl;
+            }
         }
 
-        vector<Detection> trackedObjects = tracker.update(detections);
-
-        for (const auto& obj : trackedObjects) {
-            
-            rectangle(frame, obj.bbox, obj.color, 2);
-            putText(frame, "ID: " + to_string(obj.id), obj.bbox.tl(), FONT_HERSHEY_SIMPLEX, 0.5, obj.color, 2);
+        // Decode person candidates straight out of the output blobs, with the network that made them
+        if (job.inferred) {
+            stage.detect(*job.detector, job.outputs, job.decodeParams);
         }
-
-        // Draw bounding boxes for detected humans
-        /*vector<Person> people;
-        for (int i : indices) {
-            Rect box = boxes[i];
-            Person person = Person({box.x, box.y}, {box.width, box.height});
-            people.push_back(person);
+        if (retiredDetector && job.detector == detector.get()) {
+            retiredDetector.reset();
+        }
+        if (job.inferred && !startup.reached("first detection")) {
+            startup.mark("first detection");
+            startup.print(cout);
         }
-        tracker.update(people);
-        tracker.draw(frame);*/
-
-        // Show the output frame
-        imshow("Human Detection", frame);
 
-        // Break on 'q' key press
-        if (waitKey(1) == 'q') {
+        // Crossings are stamped with when the frame was captured, not when it got through the pipeline
+        stage.track(frame, job.timestamp, wallClockAt(job.timestamp), job.right);
+        const TrackView& trackedObjects = stage.tracks();
+        pipeline.setTracksActive(!trackedObjects.empty());
+        hotPathMetrics.frames.add();
+        if (job.inferred) hotPathMetrics.inferred.add();
+        hotPathMetrics.activeTracks.set(trackedObjects.size());
+        if (context.edge) context.edge->setActiveTracks(trackedObjects.size());
+        publishEvents(stage.events(), context);
+        auto trackEnd = chrono::steady_clock::now();
+        pipeline.stats(Stage::Track).record(trackEnd - trackBegin);
+        pipeline.latency().record(trackEnd - job.grabbed);
+
+        presentFrame(frame, trackedObjects, stage.counter().zones(), context, 0, "Human Detection");
+        if (!keepRunning(context)) {
             break;
         }
     }
 
-    cap.release();
-    destroyAllWindows();
+    pipeline.stop();
+    // Its gauges read the pipeline, which goes away first
+    if (metricsServer) metricsServer->stop();
+    pipeline.printStats(cout);
+    if (stereoDepth) {
+        stereoDepth->printStats(cout);
+    }
+    if (reid) {
+        reid->printStats(cout);
+    }
+    cout << "Entries: " << stage.counter().entries() << ", exits: " << stage.counter().exits() << endl;
+    if (!recordPath.empty()) {
+        cout << "Recorded " << detectionLog.framesWritten() << " frames to " << recordPath << endl;
+    }
+
+    if (!context.headless) destroyAllWindows();
     return 0;
 }
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "http_server.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Counters and latency histograms for the hot path, exported in Prometheus text format.
+// Recording is a couple of relaxed atomic adds on a cache line private to the calling thread, a few
+// nanoseconds against frame times in milliseconds. `make clean && make METRICS=0` defines
+// ONEDONG_NO_METRICS, which turns every recording call into an empty inline function.
+
+// Writers are spread over this many cache-line-sized shards by thread, so stage threads never
+// contend on a counter; scrapes sum the shards
+constexpr int MetricShards = 8;
+
+#ifndef ONEDONG_NO_METRICS
+
+// The shard the calling thread writes to
+inline int metricShard() {
+    static std::atomic<int> nextShard{0};
+    thread_local int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % MetricShards;
+    return shard;
+}
+
+class MetricCounter {
+    public:
+        void add(uint64_t n = 1) { shards[metricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> value{0};
+        };
+        Shard shards[MetricShards];
+};
+
+class MetricGauge {
+    public:
+        void set(double v) { current.store(v, std::memory_order_relaxed); }
+        double value() const { return current.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<double> current{0.0};
+};
+
+// Log-bucketed latencies: one bucket below 16 us, then two per power of two (at 1.5x and 2x)
+// up to 17 s, and an overflow bucket.
+class LatencyHistogram {
+    public:
+        static constexpr int Buckets = 42;
+
+        void record(std::chrono::steady_clock::duration elapsed) {
+            // Clamped, as a negative duration would land in the overflow bucket
+            int64_t signedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            uint64_t ns = signedNs > 0 ? static_cast<uint64_t>(signedNs) : 0;
+            Shard& shard = shards[metricShard()];
+            shard.counts[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+            shard.sumNs.fetch_add(ns, std::memory_order_relaxed);
+        }
+
+        // Upper bound of a bucket in seconds, infinity for the last one
+        static double upperBound(int bucket);
+
+        // Summed over shards; buckets are per bucket, not cumulative
+        struct Snapshot {
+            uint64_t counts[Buckets] = {};
+            uint64_t count = 0;
+            double sumSeconds = 0.0;
+        };
+        Snapshot snapshot() const;
+
+    private:
+        static constexpr int FirstOctave = 14; // 2^14 ns = 16.4 us
+
+        static int bucketOf(uint64_t ns) {
+            if (ns < (uint64_t(1) << FirstOctave)) return 0;
+            int msb = 63 - __builtin_clzll(ns);
+            int half = static_cast<int>((ns >> (msb - 1)) & 1);
+            int bucket = 1 + 2 * (msb - FirstOctave) + half;
+            return bucket < Buckets - 1 ? bucket : Buckets - 1;
+        }
+
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> counts[Buckets] = {};
+            std::atomic<uint64_t> sumNs{0};
+        };
+        Shard shards[MetricShards];
+};
+
+#else
+
+class MetricCounter {
+    public:
+        void add(uint64_t = 1) {}
+        uint64_t value() const { return 0; }
+};
+
+class MetricGauge {
+    public:
+        void set(double) {}
+        double value() const { return 0.0; }
+};
+
+class LatencyHistogram {
+    public:
+        void record(std::chrono::steady_clock::duration) {}
+};
+
+#endif
+
+// Records the time until the end of the enclosing scope
+class ScopedLatency {
+    public:
+#ifndef ONEDONG_NO_METRICS
+        explicit ScopedLatency(LatencyHistogram& histogram)
+            : histogram(histogram), begin(std::chrono::steady_clock::now()) {}
+        ~ScopedLatency() { histogram.record(std::chrono::steady_clock::now() - begin); }
+
+    private:
+        LatencyHistogram& histogram;
+        std::chrono::steady_clock::time_point begin;
+#else
+        explicit ScopedLatency(LatencyHistogram&) {}
+#endif
+};
+
+// The instruments the frame loops write to, one set per process
+struct HotPathMetrics {
+    // Per stage, exported as onedong_stage_seconds{stage="..."}
+    LatencyHistogram capture;
+    LatencyHistogram preprocess;
+    LatencyHistogram forward;
+    LatencyHistogram decode;
+    LatencyHistogram nms;
+    LatencyHistogram track;
+    LatencyHistogram uplink; // One batch POST
+    LatencyHistogram captureToTracked;
+
+    MetricCounter frames;      // Through tracking
+    MetricCounter inferred;    // Of those, through the network
+    MetricCounter detections;  // After NMS
+    MetricCounter entries;
+    MetricCounter exits;
+    MetricGauge activeTracks;  // Including coasting tracks, summed over cameras
+};
+
+extern HotPathMetrics hotPathMetrics;
+
+// Named series for a scrape. Counters and gauges owned elsewhere are read through callbacks
+// at scrape time, so their owners don't do anything extra per frame.
+class MetricsRegistry {
+    public:
+        // labels is Prometheus label syntax without the braces, e.g. `queue="captured"`
+        void addCounter(const std::string& name, const std::string& help, std::function<double()> read,
+                        const std::string& labels = "");
+        void addGauge(const std::string& name, const std::string& help, std::function<double()> read,
+                      const std::string& labels = "");
+        void addHistogram(const std::string& name, const std::string& help, const LatencyHistogram& histogram,
+                          const std::string& labels = "");
+
+        // Series sharing a name are written as one family, in registration order
+        std::string render() const;
+
+    private:
+        struct Series {
+            std::string name;
+            std::string help;
+            const char* type;
+            std::string labels;
+            std::function<double()> read;
+            const LatencyHistogram* histogram = nullptr;
+        };
+
+        void renderSeries(std::string& out, const Series& series) const;
+
+        mutable std::mutex mutex; // Series can be added while a scrape is running
+        std::vector<Series> series;
+};
+
+// Adds everything in hotPathMetrics; adds nothing under ONEDONG_NO_METRICS
+void registerHotPathMetrics(MetricsRegistry& registry);
+
+// Serves GET /metrics in Prometheus text format
+class MetricsServer {
+    public:
+        MetricsServer(int port, const MetricsRegistry& registry);
+        ~MetricsServer();
+
+        bool start();
+        void stop();
+
+    private:
+        HttpServer server;
+};
@@ -0,0 +1,101 @@
+#include "model_cache.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    // Parsers read the whole file front to back. Advice values are not flags, so one call each.
+    madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    madvise(mapped, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+    addr = mapped;
+    length = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (addr) {
+        munmap(addr, length);
+        addr = nullptr;
+        length = 0;
+    }
+}
+
+static bool makeDirectory(const string& path) {
+    if (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST) return true;
+    cerr << "Error: Cannot create " << path << ": " << strerror(errno) << endl;
+    return false;
+}
+
+bool prepareModelCache(const string& dir) {
+    if (!makeDirectory(dir) || !makeDirectory(dir + "/opencl") || !makeDirectory(dir + "/ocl4dnn")) {
+        return false;
+    }
+    // The default OpenCL cache lives under $HOME, which service users often don't have
+    setenv("OPENCV_OPENCL_CACHE_DIR", (dir + "/opencl").c_str(), 0);
+    setenv("OPENCV_OCL4DNN_CONFIG_PATH", (dir + "/ocl4dnn").c_str(), 0);
+    return true;
+}
+
+string cachedModelPath(const string& dir, const string& model, const string& tag, const char* extension) {
+    struct stat st;
+    if (stat(model.c_str(), &st) != 0) return "";
+
+    size_t slash = model.find_last_of('/');
+    string base = slash == string::npos ? model : model.substr(slash + 1);
+    size_t dot = base.find_last_of('.');
+    if (dot != string::npos && dot > 0) base.resize(dot);
+
+    ostringstream path;
+    path << dir << '/' << base << '-' << tag << '-' << hex << static_cast<unsigned long long>(st.st_size) << '-'
+         << static_cast<unsigned long long>(st.st_mtime) << extension;
+    return path.str();
+}
+
+void StartupTimeline::mark(const char* milestone) {
+    if (reached(milestone)) return;
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    milestones.emplace_back(milestone, ms);
+}
+
+bool StartupTimeline::reached(const char* milestone) const {
+    for (const auto& entry : milestones) {
+        if (strcmp(entry.first, milestone) == 0) return true;
+    }
+    return false;
+}
+
+void StartupTimeline::print(ostream& os) const {
+    os << "Startup:";
+    for (size_t i = 0; i < milestones.size(); i++) {
+        os << (i == 0 ? " " : ", ") << milestones[i].first << " " << llround(milestones[i].second) << " ms";
+    }
+    os << endl;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A whole file mapped read-only, for handing model bytes to a runtime without reading them
+// through a stream first. The mapping lives as long as the object.
+class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const { return addr != nullptr; }
+        const char* data() const { return static_cast<const char*>(addr); }
+        size_t size() const { return length; }
+
+    private:
+        void* addr = nullptr;
+        size_t length = 0;
+};
+
+// Creates the cache directory and points OpenCV's OpenCL program cache and the OCL4DNN kernel
+// configs into it, so compiled kernels survive restarts. Must run before anything touches
+// OpenCL; environment variables the service already sets win.
+bool prepareModelCache(const std::string& dir);
+
+// Where the pre-optimized copy of `model` lives in the cache. The name carries the model's
+// size and mtime, so replacing the model misses the cache instead of loading a stale artifact.
+std::string cachedModelPath(const std::string& dir, const std::string& model, const std::string& tag,
+                            const char* extension);
+
+// Milestones since process start, printed as one line once the first detection is in
+class StartupTimeline {
+    public:
+        StartupTimeline() : start(std::chrono::steady_clock::now()) {}
+
+        // Records the first occurrence of a milestone, later ones are ignored
+        void mark(const char* milestone);
+        bool reached(const char* milestone) const;
+
+        void print(std::ostream& os) const;
+
+    private:
+        std::chrono::steady_clock::time_point start;
+        std::vector<std::pair<const char*, double>> milestones; // name, ms since start
+};
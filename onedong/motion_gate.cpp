@@ -0,0 +1,52 @@
+#include "motion_gate.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+MotionGate::MotionGate(const MotionGateConfig& config) : config(config) {
+    sinceMotion = config.holdFrames + 1;
+}
+
+bool MotionGate::detectMotion(const Mat& frame) {
+    Rect roi = config.roi.empty() ? Rect(0, 0, frame.cols, frame.rows) : (config.roi & Rect(0, 0, frame.cols, frame.rows));
+    if (roi.empty()) return true;
+
+    Mat region = frame(roi);
+    int width = min(config.downscaleWidth, roi.width);
+    int height = max(1, roi.height * width / roi.width);
+    resize(region, small, Size(width, height), 0, 0, INTER_AREA);
+    if (small.channels() > 1) {
+        cvtColor(small, gray, COLOR_BGR2GRAY);
+    } else {
+        small.copyTo(gray);
+    }
+
+    if (previous.size() != gray.size()) {
+        gray.copyTo(previous);
+        return true;
+    }
+
+    absdiff(gray, previous, diff);
+    swap(gray, previous);
+    threshold(diff, diff, config.pixelThreshold, 255, THRESH_BINARY);
+    return countNonZero(diff) > config.minChangedFraction * diff.total();
+}
+
+bool MotionGate::shouldInfer(const Mat& frame, bool force) {
+    seen++;
+    if (!config.enabled) return true;
+
+    // Keep the reference frame current even when the result doesn't matter
+    bool motion = detectMotion(frame);
+    sinceMotion = motion ? 0 : sinceMotion + 1;
+
+    bool infer = force || sinceMotion <= config.holdFrames || ++sinceInference >= config.keepAliveFrames;
+    if (infer) {
+        sinceInference = 0;
+    } else {
+        skipped++;
+    }
+    return infer;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+
+struct MotionGateConfig {
+    bool enabled = false;
+    cv::Rect roi;                       // Frame pixels around the entrance, empty means the whole frame
+    int downscaleWidth = 160;           // Differencing runs on a tiny grayscale copy
+    int pixelThreshold = 25;            // Grey level change that counts as a changed pixel
+    double minChangedFraction = 0.002;  // Share of ROI pixels that must change to count as motion
+    int keepAliveFrames = 15;           // Infer at least every N frames even when nothing moves
+    int holdFrames = 30;                // Keep inferring this long after the last motion
+};
+
+// Decides per frame whether the detector needs to run, by differencing a downscaled grayscale
+// ROI against the previous frame. Buffers are reused, so the gate costs a fraction of a millisecond.
+class MotionGate {
+    public:
+        explicit MotionGate(const MotionGateConfig& config = MotionGateConfig());
+
+        // force is for callers that know inference is needed anyway, e.g. while tracks are alive
+        bool shouldInfer(const cv::Mat& frame, bool force = false);
+
+        uint64_t framesSeen() const { return seen; }
+        uint64_t framesSkipped() const { return skipped; }
+        double skipRatio() const { return seen ? static_cast<double>(skipped) / seen : 0.0; }
+
+    private:
+        bool detectMotion(const cv::Mat& frame);
+
+        MotionGateConfig config;
+        cv::Mat small;
+        cv::Mat gray;
+        cv::Mat previous;
+        cv::Mat diff;
+        int sinceInference = 0;
+        int sinceMotion = 0;
+        uint64_t seen = 0;
+        uint64_t skipped = 0;
+};
@@ -0,0 +1,113 @@
+#include "multicam.hpp"
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+MultiCameraEngine::MultiCameraEngine(Detector& detector, const vector<string>& sources, const RuntimeConfig& runtime,
+                                     const MotionGateConfig& motionGate, const PreprocessConfig& preprocess,
+                                     const CaptureConfig& capture)
+    : detector(detector),
+      inputSize(preprocess.inputSize),
+      cams(sources.size()) {
+    for (size_t i = 0; i < sources.size(); i++) {
+        RuntimeConfig own = runtime;
+        own.zones = zonesForSource(runtime.zones, static_cast<int>(i));
+        cams[i].source = sources[i];
+        cams[i].stage = TrackingStage(own);
+        cams[i].motionGate = MotionGate(motionGate);
+        cams[i].preprocessor = Preprocessor(preprocess);
+        cams[i].cap = openCapture(sources[i], capture);
+        cams[i].live = cams[i].cap != nullptr;
+        if (cams[i].live) {
+            cams[i].stage.tracker().setFramePeriod(cams[i].cap->fps() > 0 ? 1.0 / cams[i].cap->fps() : 0.0);
+        }
+    }
+    const int shape[] = {static_cast<int>(cams.size()), 3, inputSize.height, inputSize.width};
+    blob.create(4, shape, CV_32F);
+    startTime = chrono::steady_clock::now();
+}
+
+bool MultiCameraEngine::tick() {
+    // Grab everything first and decode afterwards, so the frames in a batch are as close in time as possible
+    for (auto& cam : cams) {
+        if (cam.live && !cam.cap->grab()) {
+            cam.live = false;
+        }
+    }
+
+    batch.clear();
+    bool anyLive = false;
+    for (int i = 0; i < static_cast<int>(cams.size()); i++) {
+        Camera& cam = cams[i];
+        bool tracksActive = !cam.tracks.empty();
+        cam.tracks = TrackView();
+        if (!cam.live) continue;
+        if (!cam.cap->retrieve(cam.frame)) {
+            cam.live = false;
+            continue;
+        }
+        cam.timestamp = cam.cap->timestamp();
+        anyLive = true;
+        frames++;
+        hotPathMetrics.frames.add();
+
+        // Static cameras stay out of the batch; their tracks just age
+        if (!cam.motionGate.shouldInfer(cam.frame, tracksActive)) {
+            cam.stage.track(cam.frame, cam.timestamp, wallClockAt(cam.timestamp));
+            cam.tracks = cam.stage.tracks();
+            continue;
+        }
+        batch.push_back(i);
+    }
+    if (!anyLive) return false;
+    if (batch.empty()) return true;
+
+    // Each camera writes straight into its slot of the batch
+    auto begin = chrono::steady_clock::now();
+    const int batchSize = static_cast<int>(batch.size());
+    const size_t imageSize = static_cast<size_t>(3) * inputSize.width * inputSize.height;
+    for (int b = 0; b < batchSize; b++) {
+        ScopedLatency timer(hotPathMetrics.preprocess);
+        cams[batch[b]].preprocessor.run(cams[batch[b]].frame, blob.ptr<float>() + b * imageSize);
+    }
+    const int shape[] = {batchSize, 3, inputSize.height, inputSize.width};
+    {
+        ScopedLatency timer(hotPathMetrics.forward);
+        detector.forward(Mat(4, shape, CV_32F, blob.ptr<float>()), outputs);
+    }
+    forwardTime += chrono::steady_clock::now() - begin;
+    hotPathMetrics.inferred.add(batchSize);
+
+    // Each camera decodes and tracks its own slice of the outputs
+    for (int b = 0; b < batchSize; b++) {
+        Camera& cam = cams[batch[b]];
+        imageParams.assign(1, cam.preprocessor.decodeParams());
+        cam.stage.detect(detector, outputs, imageParams, b, batchSize);
+        cam.stage.track(cam.frame, cam.timestamp, wallClockAt(cam.timestamp));
+        cam.tracks = cam.stage.tracks();
+    }
+
+    ticks++;
+    return true;
+}
+
+void MultiCameraEngine::printStats(ostream& os) const {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    double forwardMs = chrono::duration<double, milli>(forwardTime).count();
+    os << fixed << setprecision(2)
+       << "Multi-camera: " << cams.size() << " sources, " << frames << " frames in " << ticks << " batches, "
+       << (seconds > 0 ? frames / seconds : 0.0) << " fps total, "
+       << (ticks ? forwardMs / ticks : 0.0) << " ms per batched forward" << endl;
+    for (const auto& cam : cams) {
+        if (cam.motionGate.framesSkipped() == 0) continue;
+        os << "  " << cam.source << ": motion gate skipped " << cam.motionGate.framesSkipped() << " of "
+           << cam.motionGate.framesSeen() << " frames (" << cam.motionGate.skipRatio() * 100 << "%)" << endl;
+    }
+}
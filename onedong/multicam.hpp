@@ -0,0 +1,64 @@
+#pragma once
+
+#include "capture.hpp"
+#include "detector.hpp"
+#include "motion_gate.hpp"
+#include "preprocess.hpp"
+#include "runtime_config.hpp"
+#include "tracking_stage.hpp"
+#include "yolo_decoder.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Camera {
+    std::string source;
+    std::unique_ptr<CaptureSource> cap;
+    TrackingStage stage; // Its tracker, counter and the events of the last tick
+    MotionGate motionGate;
+    Preprocessor preprocessor; // Per camera, sources can differ in resolution
+    bool live = false;
+
+    // Results of the last tick, valid while live
+    cv::Mat frame;
+    std::chrono::steady_clock::time_point timestamp; // Capture time of frame
+    TrackView tracks; // Into the stage's tracker, including coasting tracks
+};
+
+// Runs every camera through one shared network: each tick grabs a frame from all live sources,
+// stacks them into a single NCHW blob, does one forward pass, and hands each camera's slice
+// of the output to that camera's own TrackingStage.
+class MultiCameraEngine {
+    public:
+        // Every camera tracks, decodes and gates on motion the same way, and counts against the
+        // zones bound to its index in sources
+        MultiCameraEngine(Detector& detector, const std::vector<std::string>& sources,
+                          const RuntimeConfig& runtime = RuntimeConfig(),
+                          const MotionGateConfig& motionGate = MotionGateConfig(),
+                          const PreprocessConfig& preprocess = PreprocessConfig(),
+                          const CaptureConfig& capture = CaptureConfig());
+
+        // Processes one batch. Returns false once every source has ended.
+        bool tick();
+
+        std::vector<Camera>& cameras() { return cams; }
+        void printStats(std::ostream& os) const;
+
+    private:
+        Detector& detector;
+        cv::Size inputSize;
+        std::vector<Camera> cams;
+
+        // Reused between ticks
+        std::vector<int> batch;
+        cv::Mat blob; // Sized for every camera at once, smaller batches use its front
+        std::vector<cv::Mat> outputs;
+        std::vector<DecodeParams> imageParams; // One camera's image
+
+        uint64_t ticks = 0;
+        uint64_t frames = 0;
+        std::chrono::steady_clock::duration forwardTime{};
+        std::chrono::steady_clock::time_point startTime;
+};
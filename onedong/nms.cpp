@@ -0,0 +1,485 @@
+#include "nms.hpp"
+
+#include <opencv2/dnn.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NMS_HAVE_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NMS_HAVE_NEON 1
+#endif
+
+using namespace cv;
+using namespace std;
+
+bool parseNmsMethod(const string& name, NmsMethod& method) {
+    if (name == "greedy") method = NmsMethod::Greedy;
+    else if (name == "matrix") method = NmsMethod::Matrix;
+    else if (name == "opencv") method = NmsMethod::Reference;
+    else return false;
+    return true;
+}
+
+namespace {
+
+// Per-thread scratch. Boxes placed in the grid are stored per cell as CSR with SoA coordinates:
+// a cell's entries are cellStart[c]..cellFill[c], with room reserved up to cellStart[c + 1]
+struct NmsScratch {
+    vector<int> order;      // Candidates above the score threshold, best first
+    vector<Rect> boxes;     // Integer boxes as cv::dnn::NMSBoxes sees them, by candidate index
+    vector<int> kept;       // Greedy: every kept candidate
+    vector<int> keptEmpty;  // Greedy: kept candidates with no area, which stay out of the grid
+
+    int originX = 0;
+    int originY = 0;
+    int cellSize = 64;
+    int gridCols = 0;
+    vector<int> cellStart;
+    vector<int> cellFill;
+    vector<float> x1, y1, x2, y2, area;
+    vector<float> comp;     // Matrix: squared largest IoU of the entry with any better box
+    vector<int> item;       // Candidate index of the entry
+};
+
+// The box being tested, in the same float form as the grid entries
+struct Probe {
+    Rect rect;
+    float x1, y1, x2, y2, area;
+    float threshold;
+};
+
+}
+
+// Float IoU tests this close to the threshold, as a fraction of the union, are redone exactly
+static const float ambiguousMargin = 1e-4f;
+
+static bool hasNoArea(const Rect& box) {
+    return box.width <= 0 || box.height <= 0;
+}
+
+// The overlap cv::dnn::NMSBoxes computes, rounding included
+static inline float exactOverlap(const Rect& a, const Rect& b) {
+    return 1.f - static_cast<float>(jaccardDistance(a, b));
+}
+
+static Probe makeProbe(const Rect& box, float threshold) {
+    return {box, static_cast<float>(box.x), static_cast<float>(box.y), static_cast<float>(box.x + box.width),
+            static_cast<float>(box.y + box.height), static_cast<float>(box.width) * static_cast<float>(box.height),
+            threshold};
+}
+
+static inline bool suppressesScalar(const NmsScratch& s, const Probe& p, int k) {
+    float iw = max(0.0f, min(p.x2, s.x2[k]) - max(p.x1, s.x1[k]));
+    float ih = max(0.0f, min(p.y2, s.y2[k]) - max(p.y1, s.y1[k]));
+    float inter = iw * ih;
+    float uni = p.area + s.area[k] - inter;
+    float distance = inter - p.threshold * uni;
+    float margin = ambiguousMargin * uni;
+    if (distance > margin) return true;
+    if (distance < -margin) return false;
+    return exactOverlap(p.rect, s.boxes[s.item[k]]) > p.threshold;
+}
+
+static inline void matrixScalar(const NmsScratch& s, const Probe& p, int k, float& maxIou, float& minExponent) {
+    float iw = max(0.0f, min(p.x2, s.x2[k]) - max(p.x1, s.x1[k]));
+    float ih = max(0.0f, min(p.y2, s.y2[k]) - max(p.y1, s.y1[k]));
+    float inter = iw * ih;
+    float iou = inter / (p.area + s.area[k] - inter);
+    maxIou = max(maxIou, iou);
+    minExponent = min(minExponent, s.comp[k] - iou * iou);
+}
+
+#if NMS_HAVE_AVX2
+
+static bool cpuHasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+__attribute__((target("avx2")))
+static bool overlapsAvx2(const NmsScratch& s, const Probe& p, int begin, int end) {
+    const __m256 px1 = _mm256_set1_ps(p.x1), py1 = _mm256_set1_ps(p.y1);
+    const __m256 px2 = _mm256_set1_ps(p.x2), py2 = _mm256_set1_ps(p.y2);
+    const __m256 parea = _mm256_set1_ps(p.area);
+    const __m256 threshold = _mm256_set1_ps(p.threshold);
+    const __m256 margin = _mm256_set1_ps(ambiguousMargin);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int k = begin;
+    for (; k + 8 <= end; k += 8) {
+        __m256 iw = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(px2, _mm256_loadu_ps(s.x2.data() + k)),
+                                                      _mm256_max_ps(px1, _mm256_loadu_ps(s.x1.data() + k))));
+        __m256 ih = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(py2, _mm256_loadu_ps(s.y2.data() + k)),
+                                                      _mm256_max_ps(py1, _mm256_loadu_ps(s.y1.data() + k))));
+        __m256 inter = _mm256_mul_ps(iw, ih);
+        __m256 uni = _mm256_sub_ps(_mm256_add_ps(parea, _mm256_loadu_ps(s.area.data() + k)), inter);
+        __m256 distance = _mm256_sub_ps(inter, _mm256_mul_ps(threshold, uni));
+        __m256 tolerance = _mm256_mul_ps(margin, uni);
+        if (_mm256_movemask_ps(_mm256_cmp_ps(distance, tolerance, _CMP_GT_OQ))) return true;
+
+        // Too close to call in float
+        int unsure = _mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_sub_ps(zero, tolerance), _CMP_GE_OQ));
+        while (unsure) {
+            int lane = __builtin_ctz(unsure);
+            unsure &= unsure - 1;
+            if (exactOverlap(p.rect, s.boxes[s.item[k + lane]]) > p.threshold) return true;
+        }
+    }
+    for (; k < end; k++) {
+        if (suppressesScalar(s, p, k)) return true;
+    }
+    return false;
+}
+
+__attribute__((target("avx2")))
+static void matrixAvx2(const NmsScratch& s, const Probe& p, int begin, int end, float& maxIou, float& minExponent) {
+    const __m256 px1 = _mm256_set1_ps(p.x1), py1 = _mm256_set1_ps(p.y1);
+    const __m256 px2 = _mm256_set1_ps(p.x2), py2 = _mm256_set1_ps(p.y2);
+    const __m256 parea = _mm256_set1_ps(p.area);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 best = _mm256_set1_ps(maxIou);
+    __m256 lowest = _mm256_set1_ps(minExponent);
+
+    int k = begin;
+    for (; k + 8 <= end; k += 8) {
+        __m256 iw = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(px2, _mm256_loadu_ps(s.x2.data() + k)),
+                                                      _mm256_max_ps(px1, _mm256_loadu_ps(s.x1.data() + k))));
+        __m256 ih = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(py2, _mm256_loadu_ps(s.y2.data() + k)),
+                                                      _mm256_max_ps(py1, _mm256_loadu_ps(s.y1.data() + k))));
+        __m256 inter = _mm256_mul_ps(iw, ih);
+        __m256 uni = _mm256_sub_ps(_mm256_add_ps(parea, _mm256_loadu_ps(s.area.data() + k)), inter);
+        __m256 iou = _mm256_div_ps(inter, uni);
+        best = _mm256_max_ps(best, iou);
+        lowest = _mm256_min_ps(lowest, _mm256_sub_ps(_mm256_loadu_ps(s.comp.data() + k), _mm256_mul_ps(iou, iou)));
+    }
+
+    __m128 hi = _mm_max_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+    hi = _mm_max_ps(hi, _mm_movehl_ps(hi, hi));
+    hi = _mm_max_ss(hi, _mm_shuffle_ps(hi, hi, 1));
+    maxIou = _mm_cvtss_f32(hi);
+    __m128 lo = _mm_min_ps(_mm256_castps256_ps128(lowest), _mm256_extractf128_ps(lowest, 1));
+    lo = _mm_min_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_min_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    minExponent = _mm_cvtss_f32(lo);
+
+    for (; k < end; k++) {
+        matrixScalar(s, p, k, maxIou, minExponent);
+    }
+}
+
+#endif
+
+#if NMS_HAVE_NEON
+
+static bool overlapsNeon(const NmsScratch& s, const Probe& p, int begin, int end) {
+    const float32x4_t px1 = vdupq_n_f32(p.x1), py1 = vdupq_n_f32(p.y1);
+    const float32x4_t px2 = vdupq_n_f32(p.x2), py2 = vdupq_n_f32(p.y2);
+    const float32x4_t parea = vdupq_n_f32(p.area);
+    const float32x4_t threshold = vdupq_n_f32(p.threshold);
+    const float32x4_t margin = vdupq_n_f32(ambiguousMargin);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    int k = begin;
+    for (; k + 4 <= end; k += 4) {
+        float32x4_t iw = vmaxq_f32(zero, vsubq_f32(vminq_f32(px2, vld1q_f32(s.x2.data() + k)),
+                                                   vmaxq_f32(px1, vld1q_f32(s.x1.data() + k))));
+        float32x4_t ih = vmaxq_f32(zero, vsubq_f32(vminq_f32(py2, vld1q_f32(s.y2.data() + k)),
+                                                   vmaxq_f32(py1, vld1q_f32(s.y1.data() + k))));
+        float32x4_t inter = vmulq_f32(iw, ih);
+        float32x4_t uni = vsubq_f32(vaddq_f32(parea, vld1q_f32(s.area.data() + k)), inter);
+        float32x4_t distance = vsubq_f32(inter, vmulq_f32(threshold, uni));
+        float32x4_t tolerance = vmulq_f32(margin, uni);
+        if (vmaxvq_u32(vcgtq_f32(distance, tolerance))) return true;
+
+        // Too close to call in float
+        uint32x4_t unsure = vcgeq_f32(distance, vnegq_f32(tolerance));
+        if (vmaxvq_u32(unsure) == 0) continue;
+        uint32_t lanes[4];
+        vst1q_u32(lanes, unsure);
+        for (int lane = 0; lane < 4; lane++) {
+            if (lanes[lane] && exactOverlap(p.rect, s.boxes[s.item[k + lane]]) > p.threshold) return true;
+        }
+    }
+    for (; k < end; k++) {
+        if (suppressesScalar(s, p, k)) return true;
+    }
+    return false;
+}
+
+static void matrixNeon(const NmsScratch& s, const Probe& p, int begin, int end, float& maxIou, float& minExponent) {
+    const float32x4_t px1 = vdupq_n_f32(p.x1), py1 = vdupq_n_f32(p.y1);
+    const float32x4_t px2 = vdupq_n_f32(p.x2), py2 = vdupq_n_f32(p.y2);
+    const float32x4_t parea = vdupq_n_f32(p.area);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t best = vdupq_n_f32(maxIou);
+    float32x4_t lowest = vdupq_n_f32(minExponent);
+
+    int k = begin;
+    for (; k + 4 <= end; k += 4) {
+        float32x4_t iw = vmaxq_f32(zero, vsubq_f32(vminq_f32(px2, vld1q_f32(s.x2.data() + k)),
+                                                   vmaxq_f32(px1, vld1q_f32(s.x1.data() + k))));
+        float32x4_t ih = vmaxq_f32(zero, vsubq_f32(vminq_f32(py2, vld1q_f32(s.y2.data() + k)),
+                                                   vmaxq_f32(py1, vld1q_f32(s.y1.data() + k))));
+        float32x4_t inter = vmulq_f32(iw, ih);
+        float32x4_t uni = vsubq_f32(vaddq_f32(parea, vld1q_f32(s.area.data() + k)), inter);
+        float32x4_t iou = vdivq_f32(inter, uni);
+        best = vmaxq_f32(best, iou);
+        lowest = vminq_f32(lowest, vsubq_f32(vld1q_f32(s.comp.data() + k), vmulq_f32(iou, iou)));
+    }
+    maxIou = vmaxvq_f32(best);
+    minExponent = vminvq_f32(lowest);
+
+    for (; k < end; k++) {
+        matrixScalar(s, p, k, maxIou, minExponent);
+    }
+}
+
+#endif
+
+// True when an entry in begin..end overlaps the probe by more than its threshold
+static bool overlapsAny(const NmsScratch& s, const Probe& p, int begin, int end) {
+#if NMS_HAVE_AVX2
+    if (cpuHasAvx2()) return overlapsAvx2(s, p, begin, end);
+#elif NMS_HAVE_NEON
+    return overlapsNeon(s, p, begin, end);
+#endif
+    for (int k = begin; k < end; k++) {
+        if (suppressesScalar(s, p, k)) return true;
+    }
+    return false;
+}
+
+// Folds the entries in begin..end into the probe's largest IoU and smallest decay exponent
+static void matrixDecay(const NmsScratch& s, const Probe& p, int begin, int end, float& maxIou, float& minExponent) {
+#if NMS_HAVE_AVX2
+    if (cpuHasAvx2()) {
+        matrixAvx2(s, p, begin, end, maxIou, minExponent);
+        return;
+    }
+#elif NMS_HAVE_NEON
+    matrixNeon(s, p, begin, end, maxIou, minExponent);
+    return;
+#endif
+    for (int k = begin; k < end; k++) {
+        matrixScalar(s, p, k, maxIou, minExponent);
+    }
+}
+
+template <typename Visit>
+static void forEachCell(const NmsScratch& s, const Rect& box, Visit visit) {
+    int x0 = (box.x - s.originX) / s.cellSize;
+    int y0 = (box.y - s.originY) / s.cellSize;
+    int x1 = (box.x + box.width - s.originX) / s.cellSize;
+    int y1 = (box.y + box.height - s.originY) / s.cellSize;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (!visit(y * s.gridCols + x)) return;
+        }
+    }
+}
+
+// Reserves room in every cell for each box with area in order. Boxes that don't share a cell
+// can't overlap, so a probe only visits its own cells.
+static void buildGrid(NmsScratch& s) {
+    bool any = false;
+    int minX = 0, minY = 0, maxX = 0, maxY = 0;
+    long long sizeSum = 0;
+    int sized = 0;
+    for (int i : s.order) {
+        const Rect& box = s.boxes[i];
+        if (hasNoArea(box)) continue;
+        if (!any) {
+            minX = box.x;
+            minY = box.y;
+            maxX = box.x + box.width;
+            maxY = box.y + box.height;
+            any = true;
+        }
+        minX = min(minX, box.x);
+        minY = min(minY, box.y);
+        maxX = max(maxX, box.x + box.width);
+        maxY = max(maxY, box.y + box.height);
+        sizeSum += max(box.width, box.height);
+        sized++;
+    }
+
+    // Cells roughly one box wide, as in IoUMatcher
+    const int maxCellsPerAxis = 128;
+    s.originX = minX;
+    s.originY = minY;
+    s.cellSize = sized ? max(16, static_cast<int>(sizeSum / sized)) : 64;
+    s.cellSize = max(s.cellSize, (max(maxX - minX, maxY - minY) + maxCellsPerAxis - 1) / maxCellsPerAxis);
+    s.gridCols = (maxX - minX) / s.cellSize + 1;
+    int gridRows = (maxY - minY) / s.cellSize + 1;
+
+    s.cellStart.assign(s.gridCols * gridRows + 1, 0);
+    for (int i : s.order) {
+        if (hasNoArea(s.boxes[i])) continue;
+        forEachCell(s, s.boxes[i], [&](int cell) {
+            s.cellStart[cell + 1]++;
+            return true;
+        });
+    }
+    for (size_t c = 1; c < s.cellStart.size(); c++) {
+        s.cellStart[c] += s.cellStart[c - 1];
+    }
+    s.cellFill.assign(s.cellStart.begin(), s.cellStart.end() - 1);
+
+    size_t entries = s.cellStart.back();
+    if (s.item.size() < entries) {
+        s.x1.resize(entries);
+        s.y1.resize(entries);
+        s.x2.resize(entries);
+        s.y2.resize(entries);
+        s.area.resize(entries);
+        s.comp.resize(entries);
+        s.item.resize(entries);
+    }
+}
+
+static void addToGrid(NmsScratch& s, const Probe& p, int index, float comp) {
+    forEachCell(s, p.rect, [&](int cell) {
+        int k = s.cellFill[cell]++;
+        s.x1[k] = p.x1;
+        s.y1[k] = p.y1;
+        s.x2[k] = p.x2;
+        s.y2[k] = p.y2;
+        s.area[k] = p.area;
+        s.comp[k] = comp;
+        s.item[k] = index;
+        return true;
+    });
+}
+
+static void appendDetection(const Rect& box, float confidence, vector<Detection>& detections) {
+    Detection detection;
+    detection.bbox = box;
+    detection.confidence = confidence;
+    detection.id = -1;  // ID will be assigned later during tracking
+    detections.push_back(detection);
+}
+
+// Same boxes and order as NMSBoxes: a candidate survives when it overlaps no better survivor by
+// more than the threshold. Only survivors sharing a grid cell are tested, eight at a time.
+static void greedyNms(NmsScratch& s, const DecodeBuffer& candidates, float iouThreshold, vector<Detection>& detections) {
+    s.kept.clear();
+    s.keptEmpty.clear();
+    for (int i : s.order) {
+        const Rect& box = s.boxes[i];
+        bool keep = true;
+        if (hasNoArea(box)) {
+            // NMSBoxes counts two boxes with no area as a full overlap, wherever they are
+            for (size_t k = 0; k < s.kept.size() && keep; k++) {
+                keep = exactOverlap(box, s.boxes[s.kept[k]]) <= iouThreshold;
+            }
+        } else {
+            for (size_t k = 0; k < s.keptEmpty.size() && keep; k++) {
+                keep = exactOverlap(box, s.boxes[s.keptEmpty[k]]) <= iouThreshold;
+            }
+            Probe probe = makeProbe(box, iouThreshold);
+            if (keep) {
+                forEachCell(s, box, [&](int cell) {
+                    keep = !overlapsAny(s, probe, s.cellStart[cell], s.cellFill[cell]);
+                    return keep;
+                });
+            }
+            if (keep) addToGrid(s, probe, i, 0.0f);
+        }
+        if (!keep) continue;
+
+        s.kept.push_back(i);
+        if (hasNoArea(box)) s.keptEmpty.push_back(i);
+        appendDetection(box, candidates.conf[i], detections);
+    }
+}
+
+// Matrix NMS with a Gaussian kernel: each box's score is multiplied by the smallest
+// exp(-sigma * (iou^2 - comp^2)) over every better box, where comp is that better box's own largest
+// IoU with a box above it. Nothing is dropped outright, so people partly hidden behind someone else
+// keep a low score for ByteTrack's second association stage.
+static void matrixNms(NmsScratch& s, const DecodeBuffer& candidates, const NmsParams& params,
+                      vector<Detection>& detections) {
+    for (int i : s.order) {
+        const Rect& box = s.boxes[i];
+        if (hasNoArea(box)) continue;
+
+        Probe probe = makeProbe(box, params.iouThreshold);
+        float maxIou = 0.0f;
+        float minExponent = 0.0f; // Caps the decay at 1
+        forEachCell(s, box, [&](int cell) {
+            matrixDecay(s, probe, s.cellStart[cell], s.cellFill[cell], maxIou, minExponent);
+            return true;
+        });
+        addToGrid(s, probe, i, maxIou * maxIou);
+
+        float score = candidates.conf[i] * exp(params.matrixSigma * minExponent);
+        if (score >= params.matrixMinScore) {
+            appendDetection(box, score, detections);
+        }
+    }
+}
+
+static void referenceNms(const DecodeBuffer& candidates, const NmsParams& params, vector<Detection>& detections) {
+    vector<float> confidences(candidates.conf.begin(), candidates.conf.begin() + candidates.count);
+    vector<Rect> boxes(candidates.count);
+    for (size_t i = 0; i < candidates.count; i++) {
+        boxes[i] = candidates.box(i);
+    }
+
+    vector<int> indices;
+    dnn::NMSBoxes(boxes, confidences, params.scoreThreshold, params.iouThreshold, indices, 1.f, params.topK);
+    for (int i : indices) {
+        appendDetection(boxes[i], confidences[i], detections);
+    }
+}
+
+void suppressToDetections(const DecodeBuffer& candidates, const NmsParams& params, vector<Detection>& detections) {
+    // A negative threshold suppresses boxes that don't touch at all, which the grid can't see
+    if (params.method == NmsMethod::Reference || !(params.iouThreshold >= 0.0f)) {
+        referenceNms(candidates, params, detections);
+        return;
+    }
+
+    static thread_local NmsScratch s;
+    const float* conf = candidates.conf.data();
+    s.order.clear();
+    for (size_t i = 0; i < candidates.count; i++) {
+        if (conf[i] > params.scoreThreshold) s.order.push_back(static_cast<int>(i));
+    }
+    if (s.order.empty()) return;
+
+    // Ties go to the lower index, matching the stable sort inside NMSBoxes
+    auto better = [conf](int a, int b) { return conf[a] > conf[b] || (conf[a] == conf[b] && a < b); };
+    if (params.topK > 0 && static_cast<size_t>(params.topK) < s.order.size()) {
+        partial_sort(s.order.begin(), s.order.begin() + params.topK, s.order.end(), better);
+        s.order.resize(params.topK);
+    } else {
+        sort(s.order.begin(), s.order.end(), better);
+    }
+
+    if (s.boxes.size() < candidates.count) s.boxes.resize(candidates.count);
+    for (int i : s.order) {
+        s.boxes[i] = candidates.box(i);
+    }
+    buildGrid(s);
+
+    if (params.method == NmsMethod::Matrix) {
+        matrixNms(s, candidates, params, detections);
+    } else {
+        greedyNms(s, candidates, params.iouThreshold, detections);
+    }
+}
+
+const char* nmsSimdName() {
+#if NMS_HAVE_AVX2
+    return cpuHasAvx2() ? "avx2" : "scalar";
+#elif NMS_HAVE_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
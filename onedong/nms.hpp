@@ -0,0 +1,34 @@
+#pragma once
+
+#include "detection.hpp"
+#include "yolo_decoder.hpp"
+
+#include <string>
+#include <vector>
+
+enum class NmsMethod {
+    Greedy,     // Keeps exactly the boxes cv::dnn::NMSBoxes keeps, in the same order
+    Matrix,     // Decays the confidence of overlapped boxes instead of dropping them (Matrix NMS)
+    Reference,  // cv::dnn::NMSBoxes itself, for checking and benchmarking the other two
+};
+
+// Parses greedy, matrix or opencv
+bool parseNmsMethod(const std::string& name, NmsMethod& method);
+
+struct NmsParams {
+    float scoreThreshold = 0.1f;
+    float iouThreshold = 0.65f;
+    NmsMethod method = NmsMethod::Greedy;
+    int topK = 0;               // Only the best topK candidates take part, 0 for all of them
+    float matrixSigma = 2.0f;   // Matrix: a box overlapping a better one by iou keeps exp(-sigma * iou^2) of its score
+    float matrixMinScore = 0.1f; // Matrix: decayed boxes below this are dropped
+};
+
+// Runs non-maximum suppression over decoded candidates and appends the survivors to detections,
+// unassigned (id -1), ready for ByteTrack::update, best score first. Candidates are read in place; the
+// scratch arrays belong to the calling thread and only ever grow. Matrix reports the decayed score
+// as the confidence and skips boxes with no area.
+void suppressToDetections(const DecodeBuffer& candidates, const NmsParams& params, std::vector<Detection>& detections);
+
+// Name of the SIMD path used for the overlap tests on this machine
+const char* nmsSimdName();
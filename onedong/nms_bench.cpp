@@ -0,0 +1,98 @@
+// Microbenchmark for non-maximum suppression.
+// Sweeps crowd size over synthetic YOLO candidates, a cluster of jittered boxes per person plus
+// low-score clutter, and checks the fast greedy NMS keeps exactly what cv::dnn::NMSBoxes keeps.
+#include "nms.hpp"
+#include "synthetic_crowd.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace cv;
+using namespace std;
+
+// Roughly what the decoder hands NMS at a 0.1 threshold: many overlapping boxes per person
+static void makeCandidates(const vector<Person>& crowd, int perPerson, int clutter, mt19937& rng, DecodeBuffer& out) {
+    uniform_int_distribution<int> noise(-4, 4), posX(0, 1880), posY(0, 980), size(20, 90);
+    uniform_real_distribution<float> strong(0.3f, 0.95f), weak(0.1f, 0.3f);
+    out.reserve(crowd.size() * perPerson + clutter);
+    out.count = 0;
+    for (const auto& p : crowd) {
+        for (int c = 0; c < perPerson; c++) {
+            size_t i = out.count++;
+            out.x[i] = static_cast<float>(static_cast<int>(p.x) + noise(rng));
+            out.y[i] = static_cast<float>(static_cast<int>(p.y) + noise(rng));
+            out.w[i] = static_cast<float>(p.width + noise(rng));
+            out.h[i] = static_cast<float>(p.height + noise(rng));
+            out.conf[i] = strong(rng);
+        }
+    }
+    for (int c = 0; c < clutter; c++) {
+        size_t i = out.count++;
+        out.x[i] = static_cast<float>(posX(rng));
+        out.y[i] = static_cast<float>(posY(rng));
+        out.w[i] = static_cast<float>(size(rng));
+        out.h[i] = static_cast<float>(size(rng) * 2);
+        out.conf[i] = weak(rng);
+    }
+}
+
+static double timeNms(const DecodeBuffer& candidates, const NmsParams& params, int repeats, vector<Detection>& detections) {
+    auto begin = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        detections.clear();
+        suppressToDetections(candidates, params, detections);
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count() / repeats;
+}
+
+static bool sameDetections(const vector<Detection>& a, const vector<Detection>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].bbox != b[i].bbox || a[i].confidence != b[i].confidence) return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int maxPeople = 500;
+    int perPerson = 20;
+    int repeats = 20;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) maxPeople = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--per-person") == 0 && i + 1 < argc) perPerson = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) repeats = atoi(argv[++i]);
+    }
+
+    mt19937 rng(42);
+    NmsParams greedy;
+    NmsParams reference;
+    reference.method = NmsMethod::Reference;
+    NmsParams matrix;
+    matrix.method = NmsMethod::Matrix;
+
+    cout << "simd: " << nmsSimdName() << endl;
+    cout << fixed << setprecision(3);
+    cout << "people  candidates  kept  opencv_ms  greedy_ms  speedup  identical  matrix_ms  matrix_kept" << endl;
+    for (int people : {5, 20, 50, 100, 200, 500, 1000, 2000}) {
+        if (people > maxPeople) break;
+
+        vector<Person> crowd = makeCrowd(people, rng);
+        DecodeBuffer candidates;
+        makeCandidates(crowd, perPerson, people * 5, rng, candidates);
+
+        vector<Detection> fast, slow, decayed;
+        double referenceMs = timeNms(candidates, reference, repeats, slow);
+        double greedyMs = timeNms(candidates, greedy, repeats, fast);
+        double matrixMs = timeNms(candidates, matrix, repeats, decayed);
+
+        cout << setw(6) << people << setw(12) << candidates.count << setw(6) << fast.size()
+             << setw(11) << referenceMs << setw(11) << greedyMs << setw(9) << referenceMs / greedyMs
+             << setw(11) << (sameDetections(fast, slow) ? "yes" : "NO")
+             << setw(11) << matrixMs << setw(13) << decayed.size() << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef ONEDONG_H
+#define ONEDONG_H
+
+/* C interface to the onedong frame path (libonedong.a / libonedong.so), for embedding the detector,
+ * tracker and counter in other services and for binding them from Python (see onedong.py).
+ *
+ * A pipeline runs every frame it is given on the calling thread: motion gate, preprocessing, the
+ * network, decode, NMS, tracking and counting, the same code `main` runs. Frames are read in place
+ * from the caller's buffer and not kept after onedong_push_frame returns. One pipeline must not be
+ * used from two threads at once; separate pipelines are independent.
+ *
+ * Functions returning int return -1 on error; onedong_last_error() then says why. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define ONEDONG_API __attribute__((visibility("default")))
+#else
+#define ONEDONG_API
+#endif
+
+/* Bumped whenever a struct below or a function's meaning changes */
+#define ONEDONG_API_VERSION 1
+
+#define ONEDONG_ENTRY 0
+#define ONEDONG_EXIT 1
+
+typedef struct onedong_pipeline onedong_pipeline;
+
+typedef struct onedong_track {
+    int32_t id;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float confidence;
+    int32_t lost_frames; /* 0 when matched on this frame, otherwise frames it has been coasting */
+} onedong_track;
+
+typedef struct onedong_event {
+    int32_t track_id;
+    int32_t entrance;
+    int32_t kind;    /* ONEDONG_ENTRY or ONEDONG_EXIT */
+    int64_t time_ns; /* Capture time of the frame, ns since the Unix epoch */
+} onedong_event;
+
+typedef struct onedong_stats {
+    uint64_t frames;
+    uint64_t inferred; /* Frames the motion gate let through to the network */
+    uint64_t detections;
+    uint64_t events_dropped; /* Crossings lost because nobody polled for them */
+    int64_t entries;
+    int64_t exits;
+    double preprocess_ms; /* Means per frame */
+    double forward_ms;
+    double decode_ms;
+    double track_ms;
+} onedong_stats;
+
+/* The ONEDONG_API_VERSION the library was built with */
+ONEDONG_API int onedong_api_version(void);
+
+/* Why the last failing call on this thread failed */
+ONEDONG_API const char* onedong_last_error(void);
+
+/* Creates a pipeline from the flags main takes for the frame path, e.g.
+ * {"--config", "site.yaml", "--zone", "1:100,400,540,400", "--detector", "onnx:model.onnx", "--fps", "30"}.
+ * Also takes --backend, --threads, --model-cache, --input-size, --track-param, --nms, --letterbox,
+ * --tile, --motion-gate, --motion-roi and --keep-alive. Loads and warms up the network.
+ * Returns NULL when a flag is bad or the model can't be loaded. */
+ONEDONG_API onedong_pipeline* onedong_create(int argc, const char* const* argv);
+
+ONEDONG_API void onedong_destroy(onedong_pipeline* pipeline);
+
+/* Runs one 8-bit BGR frame, rows `stride` bytes apart, through the pipeline without copying it.
+ * time_ns is the capture time since the Unix epoch, 0 for now. */
+ONEDONG_API int onedong_push_frame(onedong_pipeline* pipeline, const uint8_t* bgr, int width, int height,
+                                   size_t stride, int64_t time_ns);
+
+/* Copies up to capacity tracks of the last frame into out and returns how many there are */
+ONEDONG_API int onedong_tracks(onedong_pipeline* pipeline, onedong_track* out, int capacity);
+
+/* Moves up to capacity crossings, oldest first, into out and returns how many were moved.
+ * Crossings wait between polls, up to a few thousand. */
+ONEDONG_API int onedong_poll_events(onedong_pipeline* pipeline, onedong_event* out, int capacity);
+
+/* Fills the first `size` bytes of out, so callers built against an older, smaller struct still work */
+ONEDONG_API int onedong_get_stats(onedong_pipeline* pipeline, onedong_stats* out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,137 @@
+"""ctypes binding for libonedong.so (onedong.h): the production frame path from Python.
+
+    from onedong import Pipeline
+    with Pipeline("--zone", "1:100,400,540,400", "--detector", "onnx:model.onnx", "--fps", "30") as pipeline:
+        pipeline.push(frame)            # numpy uint8 BGR, as cv2 reads it; not copied
+        tracks = pipeline.tracks()      # [(id, x, y, w, h, confidence, lost_frames), ...]
+        events = pipeline.poll_events() # [(track_id, entrance, "entry" | "exit", time_ns), ...]
+
+Run directly to count a video: python onedong.py video.mp4 --zone 1:100,400,540,400 [flags]
+"""
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+API_VERSION = 1
+
+
+class Track(ctypes.Structure):
+    _fields_ = [("id", ctypes.c_int32), ("x", ctypes.c_int32), ("y", ctypes.c_int32),
+                ("width", ctypes.c_int32), ("height", ctypes.c_int32), ("confidence", ctypes.c_float),
+                ("lost_frames", ctypes.c_int32)]
+
+
+class Event(ctypes.Structure):
+    _fields_ = [("track_id", ctypes.c_int32), ("entrance", ctypes.c_int32), ("kind", ctypes.c_int32),
+                ("time_ns", ctypes.c_int64)]
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [("frames", ctypes.c_uint64), ("inferred", ctypes.c_uint64), ("detections", ctypes.c_uint64),
+                ("events_dropped", ctypes.c_uint64), ("entries", ctypes.c_int64), ("exits", ctypes.c_int64),
+                ("preprocess_ms", ctypes.c_double), ("forward_ms", ctypes.c_double),
+                ("decode_ms", ctypes.c_double), ("track_ms", ctypes.c_double)]
+
+
+def load_library(path=None):
+    """Loads libonedong.so from path, $ONEDONG_LIB, or next to this file."""
+    path = path or os.environ.get("ONEDONG_LIB") or os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                                 "libonedong.so")
+    lib = ctypes.CDLL(path)
+    lib.onedong_api_version.restype = ctypes.c_int
+    lib.onedong_last_error.restype = ctypes.c_char_p
+    lib.onedong_create.restype = ctypes.c_void_p
+    lib.onedong_create.argtypes = [ctypes.c_int, ctypes.POINTER(ctypes.c_char_p)]
+    lib.onedong_destroy.argtypes = [ctypes.c_void_p]
+    lib.onedong_push_frame.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int,
+                                       ctypes.c_size_t, ctypes.c_int64]
+    lib.onedong_tracks.argtypes = [ctypes.c_void_p, ctypes.POINTER(Track), ctypes.c_int]
+    lib.onedong_poll_events.argtypes = [ctypes.c_void_p, ctypes.POINTER(Event), ctypes.c_int]
+    lib.onedong_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(Stats), ctypes.c_size_t]
+    if lib.onedong_api_version() != API_VERSION:
+        raise RuntimeError(f"{path} has API version {lib.onedong_api_version()}, this binding needs {API_VERSION}")
+    return lib
+
+
+class Pipeline:
+    """One pipeline; takes the same flags as main for the frame path (see onedong.h)."""
+
+    def __init__(self, *flags, library=None):
+        self._handle = None
+        self._lib = load_library(library)
+        argv = (ctypes.c_char_p * len(flags))(*[str(flag).encode() for flag in flags])
+        self._handle = self._lib.onedong_create(len(flags), argv)
+        if not self._handle:
+            raise RuntimeError(self._lib.onedong_last_error().decode())
+        self._tracks = (Track * 256)()
+        self._events = (Event * 256)()
+
+    def push(self, frame, time_ns=0):
+        """Runs one HxWx3 uint8 BGR frame. Row padding is fine; other layouts are copied once."""
+        # Rows must go forwards and not overlap; a flipped view (frame[::-1]) has a negative stride
+        if (frame.dtype != np.uint8 or frame.ndim != 3 or frame.shape[2] != 3 or frame.strides[1:] != (3, 1)
+                or frame.strides[0] < 3 * frame.shape[1]):
+            frame = np.ascontiguousarray(frame, dtype=np.uint8)
+        height, width = frame.shape[:2]
+        if self._lib.onedong_push_frame(self._handle, frame.ctypes.data, width, height, frame.strides[0],
+                                        time_ns) != 0:
+            raise RuntimeError(self._lib.onedong_last_error().decode())
+
+    def tracks(self):
+        count = self._lib.onedong_tracks(self._handle, self._tracks, len(self._tracks))
+        if count > len(self._tracks):
+            self._tracks = (Track * count)()
+            count = self._lib.onedong_tracks(self._handle, self._tracks, count)
+        return [(t.id, t.x, t.y, t.width, t.height, t.confidence, t.lost_frames) for t in self._tracks[:count]]
+
+    def poll_events(self):
+        events = []
+        while True:
+            count = self._lib.onedong_poll_events(self._handle, self._events, len(self._events))
+            events += [(e.track_id, e.entrance, "entry" if e.kind == 0 else "exit", e.time_ns)
+                       for e in self._events[:count]]
+            if count < len(self._events):
+                return events
+
+    def stats(self):
+        stats = Stats()
+        self._lib.onedong_get_stats(self._handle, ctypes.byref(stats), ctypes.sizeof(stats))
+        return {name: getattr(stats, name) for name, _ in Stats._fields_}
+
+    def close(self):
+        if self._handle:
+            self._lib.onedong_destroy(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+
+if __name__ == "__main__":
+    import time
+
+    import cv2
+
+    if len(sys.argv) < 2:
+        print("Usage: python onedong.py video.mp4 [--zone entrance:x1,y1,x2,y2 ...] [flags for main]")
+        sys.exit(1)
+    video = cv2.VideoCapture(sys.argv[1])
+    fps = video.get(cv2.CAP_PROP_FPS)
+    start_ns = time.time_ns()  # Crossings are stamped as if the video started now
+    with Pipeline(*sys.argv[2:], "--fps", fps) as pipeline:
+        while True:
+            ok, frame = video.read()
+            if not ok:
+                break
+            pipeline.push(frame, start_ns + int(video.get(cv2.CAP_PROP_POS_MSEC) * 1e6))
+            for track_id, entrance, kind, _ in pipeline.poll_events():
+                print(f"{kind} at entrance {entrance} by track {track_id}")
+        print(pipeline.stats())
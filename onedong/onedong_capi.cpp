@@ -0,0 +1,139 @@
+// The C interface in onedong.h, over FrameEngine. No exception crosses it: every entry point
+// catches and turns failures into -1 or NULL plus a message for onedong_last_error().
+#include "onedong.h"
+
+#include "frame_engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+static const size_t maxPendingEvents = 4096;
+
+struct onedong_pipeline {
+    unique_ptr<FrameEngine> engine;
+    deque<onedong_event> pending;
+    uint64_t eventsDropped = 0;
+};
+
+static thread_local string lastError;
+
+static int fail(const string& message) {
+    lastError = message;
+    return -1;
+}
+
+int onedong_api_version(void) {
+    return ONEDONG_API_VERSION;
+}
+
+const char* onedong_last_error(void) {
+    return lastError.c_str();
+}
+
+onedong_pipeline* onedong_create(int argc, const char* const* argv) {
+    try {
+        FrameEngineConfig config;
+        if (!parseFrameEngineArgs(argc, argv, config)) {
+            fail("Bad options, see stderr");
+            return nullptr;
+        }
+        auto pipeline = make_unique<onedong_pipeline>();
+        pipeline->engine = make_unique<FrameEngine>(config);
+        if (!pipeline->engine->ready()) {
+            fail("Cannot load the detector " + config.runtime.detector.model + ", see stderr");
+            return nullptr;
+        }
+        return pipeline.release();
+    } catch (const exception& e) {
+        fail(e.what());
+        return nullptr;
+    }
+}
+
+void onedong_destroy(onedong_pipeline* pipeline) {
+    delete pipeline;
+}
+
+int onedong_push_frame(onedong_pipeline* pipeline, const uint8_t* bgr, int width, int height, size_t stride,
+                       int64_t time_ns) {
+    if (!pipeline || !bgr || width <= 0 || height <= 0 || stride < static_cast<size_t>(width) * 3) {
+        return fail("Bad frame: expected 8-bit BGR with stride >= 3 * width");
+    }
+    try {
+        // A header over the caller's pixels; nothing is copied before preprocessing reads them
+        Mat frame(height, width, CV_8UC3, const_cast<uint8_t*>(bgr), stride);
+        auto time = time_ns > 0 ? chrono::system_clock::time_point(
+                                      chrono::duration_cast<chrono::system_clock::duration>(chrono::nanoseconds(time_ns)))
+                                : chrono::system_clock::now();
+        pipeline->engine->process(frame, time);
+
+        for (const CrossingEvent& event : pipeline->engine->events()) {
+            if (pipeline->pending.size() == maxPendingEvents) {
+                pipeline->pending.pop_front();
+                pipeline->eventsDropped++;
+            }
+            onedong_event out;
+            out.track_id = event.trackId;
+            out.entrance = event.entrance;
+            out.kind = event.kind == EventKind::Entry ? ONEDONG_ENTRY : ONEDONG_EXIT;
+            out.time_ns = chrono::duration_cast<chrono::nanoseconds>(event.time.time_since_epoch()).count();
+            pipeline->pending.push_back(out);
+        }
+        return 0;
+    } catch (const exception& e) {
+        return fail(e.what());
+    }
+}
+
+int onedong_tracks(onedong_pipeline* pipeline, onedong_track* out, int capacity) {
+    if (!pipeline || capacity < 0 || (capacity > 0 && !out)) return fail("Bad arguments");
+    const TrackView& tracks = pipeline->engine->tracks();
+    int count = static_cast<int>(tracks.size());
+    for (int i = 0; i < min(count, capacity); i++) {
+        const Rect& box = tracks.bbox(i);
+        out[i].id = tracks.id(i);
+        out[i].x = box.x;
+        out[i].y = box.y;
+        out[i].width = box.width;
+        out[i].height = box.height;
+        out[i].confidence = tracks.confidence(i);
+        out[i].lost_frames = tracks.killCount(i);
+    }
+    return count;
+}
+
+int onedong_poll_events(onedong_pipeline* pipeline, onedong_event* out, int capacity) {
+    if (!pipeline || capacity < 0 || (capacity > 0 && !out)) return fail("Bad arguments");
+    int count = min(capacity, static_cast<int>(pipeline->pending.size()));
+    copy(pipeline->pending.begin(), pipeline->pending.begin() + count, out);
+    pipeline->pending.erase(pipeline->pending.begin(), pipeline->pending.begin() + count);
+    return count;
+}
+
+int onedong_get_stats(onedong_pipeline* pipeline, onedong_stats* out, size_t size) {
+    if (!pipeline || !out) return fail("Bad arguments");
+    const FrameEngine& engine = *pipeline->engine;
+    const FrameEngineStats& s = engine.stats();
+    double n = s.frames ? static_cast<double>(s.frames) : 1.0;
+    onedong_stats stats;
+    stats.frames = s.frames;
+    stats.inferred = s.inferred;
+    stats.detections = s.detections;
+    stats.events_dropped = pipeline->eventsDropped;
+    stats.entries = engine.entries();
+    stats.exits = engine.exits();
+    stats.preprocess_ms = s.preprocessMs / n;
+    stats.forward_ms = s.forwardMs / n;
+    stats.decode_ms = s.decodeMs / n;
+    stats.track_ms = s.trackMs / n;
+    memcpy(out, &stats, min(size, sizeof(stats)));
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include "pipeline.hpp"
+
+#include "alloc_check.hpp"
+
+#include <iomanip>
+
+using namespace cv;
+using namespace std;
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Capture: return "capture";
+        case Stage::Preprocess: return "preprocess";
+        case Stage::Inference: return "inference";
+        case Stage::Track: return "track";
+        default: return "unknown";
+    }
+}
+
+void StageStats::record(chrono::steady_clock::duration elapsed) {
+    if (elapsed < chrono::steady_clock::duration::zero()) elapsed = chrono::steady_clock::duration::zero();
+    uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    frames.fetch_add(1, memory_order_relaxed);
+    totalNs.fetch_add(ns, memory_order_relaxed);
+    // Only the owning stage thread writes, so a plain compare is enough
+    if (ns > maxNs.load(memory_order_relaxed)) {
+        maxNs.store(ns, memory_order_relaxed);
+    }
+    if (histogram) {
+        histogram->record(elapsed);
+    }
+}
+
+double StageStats::meanMs() const {
+    uint64_t n = frames.load(memory_order_relaxed);
+    return n ? totalNs.load(memory_order_relaxed) / 1e6 / n : 0.0;
+}
+
+double StageStats::maxMs() const {
+    return maxNs.load(memory_order_relaxed) / 1e6;
+}
+
+Pipeline::Pipeline(CaptureSource& source, Detector& detector, const PipelineConfig& config, StereoRig* stereo)
+    : source(source),
+      stereo(stereo),
+      detector(&detector),
+      config(config),
+      captured(config.queueDepth),
+      preprocessed(config.queueDepth),
+      inferred(config.queueDepth),
+      // Enough jobs to fill every queue with one more in hand at each stage
+      recycled(3 * config.queueDepth + 4),
+      discarded(3 * config.queueDepth + 4),
+      poolSize(3 * config.queueDepth + 4),
+      motionGate(config.motionGate),
+      preprocessor(config.preprocess),
+      tiledInput(config.tiles, config.preprocess) {
+    stats(Stage::Capture).histogram = &hotPathMetrics.capture;
+    stats(Stage::Preprocess).histogram = &hotPathMetrics.preprocess;
+    stats(Stage::Inference).histogram = &hotPathMetrics.forward;
+    stats(Stage::Track).histogram = &hotPathMetrics.track;
+    captureToTracked.histogram = &hotPathMetrics.captureToTracked;
+    for (size_t i = 0; i < poolSize; i++) {
+        FrameJob job;
+        job.pooled = true;
+        recycled.tryPush(job);
+    }
+}
+
+Pipeline::~Pipeline() {
+    stop();
+}
+
+void Pipeline::start() {
+    running = true;
+    startTime = chrono::steady_clock::now();
+    threads.emplace_back(&Pipeline::captureLoop, this);
+    threads.emplace_back(&Pipeline::preprocessLoop, this);
+    threads.emplace_back(&Pipeline::inferenceLoop, this);
+}
+
+void Pipeline::stop() {
+    running = false;
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads.clear();
+}
+
+// Blocking push: waits for room, gives up once the pipeline is stopped
+template <typename T>
+bool Pipeline::push(SpscQueue<T>& queue, T& item) {
+    int spins = 0;
+    while (!queue.tryPush(item)) {
+        if (!running) return false;
+        if (++spins < 64) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+    }
+    return true;
+}
+
+// Blocking pop: waits for an item, gives up once the pipeline is stopped
+template <typename T>
+bool Pipeline::pop(SpscQueue<T>& queue, T& item) {
+    int spins = 0;
+    while (!queue.tryPop(item)) {
+        if (!running) return false;
+        if (++spins < 64) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+    }
+    return true;
+}
+
+// Takes a free job from the pool, preferring ones preprocessing dropped
+bool Pipeline::acquire(FrameJob& job) {
+    return discarded.tryPop(job) || pop(recycled, job);
+}
+
+void Pipeline::captureLoop() {
+    uint64_t index = 0;
+    FrameJob job;
+    if (!acquire(job)) return;
+    while (running) {
+        auto begin = chrono::steady_clock::now();
+        bool grabbed = stereo ? stereo->read(source, job.frame, job.right) : source.read(job.frame);
+        if (!grabbed) {
+            job.frame.release();
+        }
+        job.timestamp = source.timestamp();
+        job.grabbed = source.grabbedAt();
+        job.index = index++;
+        job.endOfStream = job.frame.empty();
+        stats(Stage::Capture).record(chrono::steady_clock::now() - begin);
+
+        bool endOfStream = job.endOfStream;
+        if (endOfStream || config.dropPolicy == DropPolicy::KeepAll) {
+            if (!push(captured, job)) return;
+        } else if (!captured.tryPush(job)) {
+            // Keep the job and overwrite its frame with the next one
+            dropped.fetch_add(1, memory_order_relaxed);
+            continue;
+        }
+        if (endOfStream || !acquire(job)) return;
+    }
+}
+
+void Pipeline::preprocessLoop() {
+    FrameJob job;
+    while (pop(captured, job)) {
+        // Under KeepLatest, skip straight to the newest queued frame
+        if (config.dropPolicy == DropPolicy::KeepLatest) {
+            FrameJob newer;
+            while (!job.endOfStream && captured.tryPop(newer)) {
+                dropped.fetch_add(1, memory_order_relaxed);
+                swap(job, newer);
+                discarded.tryPush(newer); // Never full, it can't hold more than the whole pool
+            }
+        }
+
+        if (!job.endOfStream) {
+            auto begin = chrono::steady_clock::now();
+            bool warm = !job.blob.empty(); // This job has been through preprocessing before
+            uint64_t allocationsBefore = threadAllocations();
+            uint64_t reallocationsBefore = preprocessor.reallocations() + tiledInput.reallocations();
+            if (stereo) {
+                // Detect on the rectified view, so boxes line up with the rows the disparity search uses
+                swap(job.frame, job.unrectified);
+                stereo->rectifyLeft(job.unrectified, job.frame);
+            }
+            job.inferred = motionGate.shouldInfer(job.frame, tracksActive.load(memory_order_relaxed));
+            if (job.inferred && tiledInput.enabled()) {
+                tiledInput.run(job.frame, job.blob);
+                job.decodeParams.assign(tiledInput.decodeParams().begin(), tiledInput.decodeParams().end());
+            } else if (job.inferred) {
+                preprocessor.run(job.frame, job.blob);
+                job.decodeParams.assign(1, preprocessor.decodeParams());
+            }
+            stats(Stage::Preprocess).record(chrono::steady_clock::now() - begin);
+
+            // Every pooled job fills its buffers once, after that a frame must not touch the heap
+            if (warm) {
+                preprocessAllocations.fetch_add(threadAllocations() - allocationsBefore
+                                                + preprocessor.reallocations() + tiledInput.reallocations()
+                                                - reallocationsBefore,
+                                                memory_order_relaxed);
+                steadyFrames.fetch_add(1, memory_order_relaxed);
+            }
+        }
+
+        bool endOfStream = job.endOfStream;
+        if (!push(preprocessed, job) || endOfStream) return;
+    }
+}
+
+void Pipeline::inferenceLoop() {
+    FrameJob job;
+    while (pop(preprocessed, job)) {
+        if (Detector* next = nextDetector.exchange(nullptr, memory_order_acquire)) {
+            detector = next;
+        }
+        job.detector = detector;
+        if (!job.inferred) {
+            job.outputs.clear();
+        } else if (!job.endOfStream) {
+            auto begin = chrono::steady_clock::now();
+            detector->forward(job.blob, job.outputs);
+            stats(Stage::Inference).record(chrono::steady_clock::now() - begin);
+        }
+
+        bool endOfStream = job.endOfStream;
+        if (!push(inferred, job) || endOfStream) return;
+    }
+}
+
+bool Pipeline::next(FrameJob& job) {
+    if (job.pooled) {
+        recycled.tryPush(job);
+    }
+    if (!pop(inferred, job)) return false;
+    return !job.endOfStream;
+}
+
+StageStats& Pipeline::stats(Stage stage) {
+    return stageStats[static_cast<int>(stage)];
+}
+
+uint64_t Pipeline::droppedFrames() const {
+    return dropped.load(memory_order_relaxed);
+}
+
+void Pipeline::printStats(ostream& os) const {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    uint64_t tracked = stageStats[static_cast<int>(Stage::Track)].frames.load(memory_order_relaxed);
+
+    os << fixed << setprecision(2);
+    for (int i = 0; i < static_cast<int>(Stage::Count); i++) {
+        const StageStats& s = stageStats[i];
+        os << setw(10) << stageName(static_cast<Stage>(i))
+           << ": mean " << s.meanMs() << " ms, max " << s.maxMs() << " ms, "
+           << s.frames.load(memory_order_relaxed) << " frames" << '\n';
+    }
+    os << "Pipeline: " << (seconds > 0 ? tracked / seconds : 0.0) << " fps end-to-end, "
+       << droppedFrames() << " frames dropped" << endl;
+    if (captureToTracked.frames.load(memory_order_relaxed) > 0) {
+        os << "Capture to tracked: mean " << captureToTracked.meanMs() << " ms, max " << captureToTracked.maxMs()
+           << " ms" << endl;
+    }
+    if (source.drained() > 0) {
+        os << "Capture: " << source.drained() << " stale frames drained" << endl;
+    }
+    if (allocationCountingEnabled()) {
+        os << "Preprocess: " << preprocessAllocations.load(memory_order_relaxed) << " heap allocations in "
+           << steadyFrames.load(memory_order_relaxed) << " steady-state frames" << endl;
+    }
+    if (config.motionGate.enabled) {
+        os << "Motion gate: skipped inference on " << motionGate.framesSkipped() << " of "
+           << motionGate.framesSeen() << " frames (" << motionGate.skipRatio() * 100 << "%)" << endl;
+    }
+}
+
+void Pipeline::exportMetrics(MetricsRegistry& registry) const {
+    const char* queueHelp = "Frames waiting between pipeline stages";
+    registry.addGauge("onedong_queue_depth", queueHelp, [this] { return captured.size(); }, "queue=\"captured\"");
+    registry.addGauge("onedong_queue_depth", queueHelp, [this] { return preprocessed.size(); },
+                      "queue=\"preprocessed\"");
+    registry.addGauge("onedong_queue_depth", queueHelp, [this] { return inferred.size(); }, "queue=\"inferred\"");
+    registry.addCounter("onedong_dropped_frames_total", "Frames dropped by the pipeline's drop policy",
+                        [this] { return droppedFrames(); });
+    registry.addCounter("onedong_drained_frames_total", "Stale frames drained from the camera under --latest-only",
+                        [this] { return source.drained(); });
+}
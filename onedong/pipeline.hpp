@@ -0,0 +1,145 @@
+#pragma once
+
+#include "capture.hpp"
+#include "detector.hpp"
+#include "metrics.hpp"
+#include "motion_gate.hpp"
+#include "preprocess.hpp"
+#include "spsc_queue.hpp"
+#include "stereo.hpp"
+#include "tiling.hpp"
+#include "yolo_decoder.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What the capture stage does when the preprocessing queue is full.
+enum class DropPolicy {
+    KeepAll,    // Block capture until there is room, every frame gets processed (files)
+    KeepLatest, // Drop frames that can't be queued and always hand out the newest one (live cameras)
+};
+
+struct PipelineConfig {
+    size_t queueDepth = 2;
+    DropPolicy dropPolicy = DropPolicy::KeepAll;
+    PreprocessConfig preprocess;
+    std::vector<cv::Rect> tiles; // When set, infer on these frame regions instead of the whole frame
+    MotionGateConfig motionGate;
+};
+
+enum class Stage {
+    Capture,
+    Preprocess,
+    Inference,
+    Track,
+    Count,
+};
+
+const char* stageName(Stage stage);
+
+// Timing for one stage. Written by the stage's own thread, read by anyone.
+struct StageStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    LatencyHistogram* histogram = nullptr; // Also fed with every sample when set
+
+    void record(std::chrono::steady_clock::duration elapsed);
+    double meanMs() const;
+    double maxMs() const;
+};
+
+// A frame travelling through the pipeline. Each stage fills in its part.
+// Jobs come from a fixed pool and are recycled, so their Mats keep their buffers between frames.
+struct FrameJob {
+    uint64_t index = 0;
+    bool endOfStream = false;
+    bool inferred = true; // False when the motion gate skipped the network for this frame
+    bool pooled = false;  // Owned by a pipeline, goes back to it on the next call to next()
+    std::chrono::steady_clock::time_point timestamp; // When the camera captured the frame
+    std::chrono::steady_clock::time_point grabbed;   // When capture got it, which latency is measured from
+    Detector* detector = nullptr; // The network that produced outputs, decode with the same one
+    cv::Mat frame;
+    cv::Mat right;       // Raw right view with a stereo rig; frame is then the rectified left view
+    cv::Mat unrectified; // Swapped with frame when rectifying, so both buffers stay with the job
+    cv::Mat blob;
+    std::vector<cv::Mat> outputs;
+    std::vector<DecodeParams> decodeParams; // Per image in the blob (the frame, or each tile), back to frame pixels
+};
+
+// Runs capture, preprocessing and inference on their own threads, connected by bounded SPSC queues.
+// The last stage (decode, tracking and drawing) runs on the thread that calls next(), so that
+// highgui calls stay on the main thread.
+class Pipeline {
+    public:
+        // With a stereo rig, source is its left camera and frames come in synchronized pairs
+        Pipeline(CaptureSource& source, Detector& detector, const PipelineConfig& config, StereoRig* stereo = nullptr);
+        ~Pipeline();
+
+        void start();
+        void stop();
+
+        // Blocks until the next inferred frame is ready. Returns false at end of stream or after stop().
+        // A job handed out by a previous call is taken back for reuse, so keep passing the same FrameJob.
+        bool next(FrameJob& job);
+
+        // Runs inference on next from the following frame on; jobs say which detector they went
+        // through, so the old one has to stay alive until a job from next comes out of next().
+        // next must take the same input size.
+        void replaceDetector(Detector& next) { nextDetector.store(&next, std::memory_order_release); }
+
+        // Called by the tracking stage; live tracks keep the motion gate open
+        void setTracksActive(bool active) { tracksActive.store(active, std::memory_order_relaxed); }
+
+        StageStats& stats(Stage stage);
+        // Grab to the end of tracking, recorded by the tracking stage
+        StageStats& latency() { return captureToTracked; }
+        uint64_t droppedFrames() const;
+        void printStats(std::ostream& os) const;
+        // Queue depths and dropped frames, read at scrape time
+        void exportMetrics(MetricsRegistry& registry) const;
+
+    private:
+        void captureLoop();
+        void preprocessLoop();
+        void inferenceLoop();
+        bool acquire(FrameJob& job);
+
+        template <typename T>
+        bool push(SpscQueue<T>& queue, T& item);
+        template <typename T>
+        bool pop(SpscQueue<T>& queue, T& item);
+
+        CaptureSource& source;
+        StereoRig* stereo;
+        Detector* detector; // Inference thread only
+        std::atomic<Detector*> nextDetector{nullptr};
+        PipelineConfig config;
+
+        SpscQueue<FrameJob> captured;
+        SpscQueue<FrameJob> preprocessed;
+        SpscQueue<FrameJob> inferred;
+        // Free jobs flowing back to capture, from the consumer and from frames dropped in preprocessing
+        SpscQueue<FrameJob> recycled;
+        SpscQueue<FrameJob> discarded;
+        size_t poolSize;
+
+        MotionGate motionGate;     // Preprocessing thread only
+        Preprocessor preprocessor; // Preprocessing thread only
+        TiledInput tiledInput;     // Preprocessing thread only
+        std::atomic<uint64_t> preprocessAllocations{0};
+        std::atomic<uint64_t> steadyFrames{0};
+        std::atomic<bool> tracksActive{false};
+
+        std::vector<std::thread> threads;
+        std::atomic<bool> running{false};
+        std::atomic<uint64_t> dropped{0};
+        StageStats stageStats[static_cast<int>(Stage::Count)];
+        StageStats captureToTracked;
+        std::chrono::steady_clock::time_point startTime;
+};
@@ -0,0 +1,164 @@
+#include "preprocess.hpp"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+Preprocessor::Preprocessor(const PreprocessConfig& config)
+    : input(config.inputSize), letterbox(config.letterbox), padValue(config.padValue) {}
+
+// Builds the interpolation tables with the same pixel-centre convention as cv::resize INTER_LINEAR
+static void buildAxis(int srcSize, int dstSize, vector<int>& offset0, vector<int>& offset1, vector<float>& weight, int stride) {
+    offset0.resize(dstSize);
+    offset1.resize(dstSize);
+    weight.resize(dstSize);
+    double scale = static_cast<double>(srcSize) / dstSize;
+    for (int d = 0; d < dstSize; d++) {
+        double s = (d + 0.5) * scale - 0.5;
+        int i = static_cast<int>(floor(s));
+        float f = static_cast<float>(s - i);
+        if (i < 0) {
+            i = 0;
+            f = 0;
+        }
+        if (i >= srcSize - 1) {
+            i = srcSize - 1;
+            f = 0;
+        }
+        offset0[d] = i * stride;
+        offset1[d] = min(i + 1, srcSize - 1) * stride;
+        weight[d] = f;
+    }
+}
+
+void Preprocessor::configure(Size frameSize) {
+    frame = frameSize;
+    if (letterbox) {
+        double scale = min(static_cast<double>(input.width) / frame.width, static_cast<double>(input.height) / frame.height);
+        scaled = Size(max(1, static_cast<int>(lround(frame.width * scale))), max(1, static_cast<int>(lround(frame.height * scale))));
+    } else {
+        scaled = input;
+    }
+    padX = (input.width - scaled.width) / 2;
+    padY = (input.height - scaled.height) / 2;
+
+    buildAxis(frame.width, scaled.width, xOffset0, xOffset1, xWeight, 3);
+    buildAxis(frame.height, scaled.height, yOffset0, yOffset1, yWeight, 1);
+    for (auto& row : rows) {
+        row.resize(static_cast<size_t>(scaled.width) * 3 + 32); // Slack for vector loads
+    }
+    rowSource[0] = rowSource[1] = -1;
+    reallocationCount++;
+}
+
+void Preprocessor::resizeRow(const uint8_t* src, float* dst) const {
+    for (int x = 0; x < scaled.width; x++) {
+        const uint8_t* a = src + xOffset0[x];
+        const uint8_t* b = src + xOffset1[x];
+        float w1 = xWeight[x];
+        float w0 = 1.0f - w1;
+        dst[3 * x] = a[0] * w0 + b[0] * w1;
+        dst[3 * x + 1] = a[1] * w0 + b[1] * w1;
+        dst[3 * x + 2] = a[2] * w0 + b[2] * w1;
+    }
+}
+
+void Preprocessor::run(const Mat& src, Mat& blob) {
+    const int shape[] = {1, 3, input.height, input.width};
+    const uchar* previous = blob.data;
+    blob.create(4, shape, CV_32F); // No-op once the blob has this shape
+    if (blob.data != previous) {
+        reallocationCount++;
+    }
+    run(src, blob.ptr<float>());
+}
+
+void Preprocessor::run(const Mat& src, float* dst) {
+    CV_Assert(src.type() == CV_8UC3);
+    if (src.cols != frame.width || src.rows != frame.height) {
+        configure(src.size());
+    }
+
+    const size_t planeSize = static_cast<size_t>(input.width) * input.height;
+    float* planes[3] = {dst, dst + planeSize, dst + 2 * planeSize}; // R, G, B
+    const float scale = 1.0f / 255.0f;
+
+    // Letterbox borders; plain stores, cheaper than tracking which blobs were padded before
+    if (letterbox && (padX > 0 || padY > 0)) {
+        for (int c = 0; c < 3; c++) {
+            float* plane = planes[c];
+            fill(plane, plane + static_cast<size_t>(padY) * input.width, padValue);
+            fill(plane + static_cast<size_t>(padY + scaled.height) * input.width, plane + planeSize, padValue);
+            for (int y = padY; y < padY + scaled.height; y++) {
+                float* row = plane + static_cast<size_t>(y) * input.width;
+                fill(row, row + padX, padValue);
+                fill(row + padX + scaled.width, row + input.width, padValue);
+            }
+        }
+    }
+
+    for (int y = 0; y < scaled.height; y++) {
+        // Fetch the two source rows, reusing whatever the previous output row already resized
+        const int sources[2] = {yOffset0[y], yOffset1[y]};
+        float* cached[2];
+        int taken = -1;
+        for (int k = 0; k < 2; k++) {
+            int slot = rowSource[0] == sources[k] ? 0 : rowSource[1] == sources[k] ? 1 : -1;
+            if (slot < 0) {
+                // Replace a slot the other source row isn't using
+                slot = (taken == 0 || (k == 0 && rowSource[0] == sources[1])) ? 1 : 0;
+                resizeRow(src.ptr<uint8_t>(sources[k]), rows[slot].data());
+                rowSource[slot] = sources[k];
+            }
+            taken = slot;
+            cached[k] = rows[slot].data();
+        }
+
+        const float w1 = yWeight[y] * scale;
+        const float w0 = (1.0f - yWeight[y]) * scale;
+        const size_t outOffset = static_cast<size_t>(padY + y) * input.width + padX;
+        float* r = planes[0] + outOffset;
+        float* g = planes[1] + outOffset;
+        float* b = planes[2] + outOffset;
+        const float* h0 = cached[0];
+        const float* h1 = cached[1];
+
+        // Vertical blend, scale and deinterleave into the three planes
+        int x = 0;
+#if CV_SIMD
+        const int lanes = CV_SIMD_WIDTH / sizeof(float);
+        const v_float32 vw0 = vx_setall_f32(w0);
+        const v_float32 vw1 = vx_setall_f32(w1);
+        const v_float32 zero = vx_setzero_f32();
+        for (; x + lanes <= scaled.width; x += lanes) {
+            v_float32 b0, g0, r0, b1, g1, r1;
+            v_load_deinterleave(h0 + 3 * x, b0, g0, r0);
+            v_load_deinterleave(h1 + 3 * x, b1, g1, r1);
+            v_store(r + x, v_fma(vw1, r1, v_fma(vw0, r0, zero)));
+            v_store(g + x, v_fma(vw1, g1, v_fma(vw0, g0, zero)));
+            v_store(b + x, v_fma(vw1, b1, v_fma(vw0, b0, zero)));
+        }
+#endif
+        for (; x < scaled.width; x++) {
+            b[x] = h0[3 * x] * w0 + h1[3 * x] * w1;
+            g[x] = h0[3 * x + 1] * w0 + h1[3 * x + 1] * w1;
+            r[x] = h0[3 * x + 2] * w0 + h1[3 * x + 2] * w1;
+        }
+    }
+    rowSource[0] = rowSource[1] = -1; // Next frame has new pixels
+}
+
+DecodeParams Preprocessor::decodeParams(float confThreshold) const {
+    DecodeParams params;
+    params.confThreshold = confThreshold;
+    // Network coordinates are normalised to the input, undo the padding and the resize
+    params.scaleX = static_cast<float>(input.width) * frame.width / scaled.width;
+    params.scaleY = static_cast<float>(input.height) * frame.height / scaled.height;
+    params.offsetX = -static_cast<float>(padX) * frame.width / scaled.width;
+    params.offsetY = -static_cast<float>(padY) * frame.height / scaled.height;
+    return params;
+}
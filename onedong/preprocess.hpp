@@ -0,0 +1,62 @@
+#pragma once
+
+#include "yolo_decoder.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct PreprocessConfig {
+    cv::Size inputSize = cv::Size(640, 640);
+    bool letterbox = false; // Keep the aspect ratio and pad, instead of stretching to inputSize
+    float padValue = 0.5f;
+};
+
+// Turns a BGR frame into the network's NCHW float input in a single pass: bilinear resize,
+// BGR -> RGB, scaling to [0, 1] and the HWC -> NCHW transpose are fused, working from a cache
+// of two horizontally resized rows. Lookup tables and row buffers live in the preprocessor and
+// are only rebuilt when the frame size changes, so steady state does no heap allocation.
+class Preprocessor {
+    public:
+        explicit Preprocessor(const PreprocessConfig& config = PreprocessConfig());
+
+        // Writes a 1x3xHxW blob, reusing blob's buffer when it already has that shape
+        void run(const cv::Mat& frame, cv::Mat& blob);
+        // Writes the three planes of one image at dst, e.g. one slot of a batched blob
+        void run(const cv::Mat& frame, float* dst);
+
+        // Maps output coordinates of the last frame back to frame pixels
+        DecodeParams decodeParams(float confThreshold = 0.1f) const;
+
+        cv::Size inputSize() const { return input; }
+        // Times tables, row buffers or an output blob had to be (re)allocated.
+        // Stops moving once the frame size is stable and every blob has been seen once.
+        uint64_t reallocations() const { return reallocationCount; }
+
+    private:
+        void configure(cv::Size frameSize);
+        void resizeRow(const uint8_t* src, float* dst) const;
+
+        cv::Size input;
+        bool letterbox;
+        float padValue;
+
+        // Geometry for the current frame size
+        cv::Size frame;
+        cv::Size scaled;
+        int padX = 0;
+        int padY = 0;
+        std::vector<int> xOffset0;
+        std::vector<int> xOffset1;
+        std::vector<float> xWeight;
+        std::vector<int> yOffset0;
+        std::vector<int> yOffset1;
+        std::vector<float> yWeight;
+
+        // Horizontally resized source rows, interleaved BGR, tagged with their source row
+        std::vector<float> rows[2];
+        int rowSource[2] = {-1, -1};
+        uint64_t reallocationCount = 0;
+};
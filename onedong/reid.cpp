@@ -0,0 +1,321 @@
+#include "reid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REID_HAVE_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define REID_HAVE_NEON 1
+#endif
+
+using namespace cv;
+using namespace std;
+
+static float dotScalar(const float* a, const float* b, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#if REID_HAVE_AVX2
+
+static bool cpuHasAvx2Fma() {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+
+__attribute__((target("avx2,fma")))
+static float dotAvx2(const float* a, const float* b, int n) {
+    // Two accumulators hide the FMA latency
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    }
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float total = _mm_cvtss_f32(half);
+    for (; i < n; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+#endif
+
+#if REID_HAVE_NEON
+
+static float dotNeon(const float* a, const float* b, int n) {
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sum = vfmaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float total = vaddvq_f32(sum);
+    for (; i < n; i++) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+#endif
+
+static float dot(const float* a, const float* b, int n) {
+#if REID_HAVE_AVX2
+    if (cpuHasAvx2Fma()) return dotAvx2(a, b, n);
+#elif REID_HAVE_NEON
+    return dotNeon(a, b, n);
+#endif
+    return dotScalar(a, b, n);
+}
+
+static void normalize(float* v, int n) {
+    float norm = sqrt(dot(v, v, n));
+    if (norm <= 0.0f) return;
+    float inverse = 1.0f / norm;
+    for (int i = 0; i < n; i++) {
+        v[i] *= inverse;
+    }
+}
+
+void ReidGallery::reset(size_t capacity, int dims) {
+    this->capacity = capacity;
+    this->dims = dims;
+    rows.assign(capacity * dims, 0.0f);
+    ids.clear();
+    lostAt.clear();
+    ids.reserve(capacity);
+    lostAt.reserve(capacity);
+}
+
+void ReidGallery::add(int id, const float* embedding, uint64_t frame) {
+    if (capacity == 0) return;
+    size_t row = ids.size();
+    if (row == capacity) {
+        row = min_element(lostAt.begin(), lostAt.end()) - lostAt.begin();
+        ids[row] = id;
+        lostAt[row] = frame;
+    } else {
+        ids.push_back(id);
+        lostAt.push_back(frame);
+    }
+    copy(embedding, embedding + dims, rows.begin() + row * dims);
+}
+
+int ReidGallery::take(const float* embedding, float minSimilarity, uint64_t frame, uint64_t maxAge) {
+    for (size_t i = 0; i < ids.size(); ) {
+        if (frame - lostAt[i] > maxAge) {
+            removeAt(i); // The last entry moves into i and is looked at next
+        } else {
+            i++;
+        }
+    }
+
+    int best = -1;
+    float bestSimilarity = minSimilarity;
+    for (size_t i = 0; i < ids.size(); i++) {
+        float similarity = dot(embedding, rows.data() + i * dims, dims);
+        if (similarity >= bestSimilarity) {
+            bestSimilarity = similarity;
+            best = static_cast<int>(i);
+        }
+    }
+    if (best < 0) return -1;
+    int id = ids[best];
+    removeAt(best);
+    return id;
+}
+
+// Swap-and-pop, so the rows in use stay contiguous
+void ReidGallery::removeAt(size_t i) {
+    size_t last = ids.size() - 1;
+    if (i != last) {
+        copy(rows.begin() + last * dims, rows.begin() + (last + 1) * dims, rows.begin() + i * dims);
+        ids[i] = ids[last];
+        lostAt[i] = lostAt[last];
+    }
+    ids.pop_back();
+    lostAt.pop_back();
+}
+
+ReidStage::ReidStage(const ReidConfig& config) : config(config), cropLimit(max(1, config.maxCropsPerFrame)) {
+    try {
+        net = dnn::readNet(config.model);
+    } catch (const cv::Exception& e) {
+        cerr << "Error: Cannot load ReID model " << config.model << ": " << e.what() << endl;
+        return;
+    }
+    if (net.empty()) {
+        cerr << "Error: Cannot load ReID model " << config.model << endl;
+        return;
+    }
+    // The detector has the accelerator; crops are small enough to batch on the CPU
+    net.setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(dnn::DNN_TARGET_CPU);
+}
+
+// The part of the frame to embed for a box. Boxes below 8x16 are grown around their centre,
+// so a new track is checked against the gallery even while it is still small or at the edge.
+static Rect cropFor(const Rect& box, const Rect& bounds) {
+    Rect crop = box & bounds;
+    if (crop.empty() || (crop.width >= 8 && crop.height >= 16)) return crop;
+    Point center(crop.x + crop.width / 2, crop.y + crop.height / 2);
+    int width = max(crop.width, 8);
+    int height = max(crop.height, 16);
+    return Rect(center.x - width / 2, center.y - height / 2, width, height) & bounds;
+}
+
+void ReidStage::update(const Mat& frame, ByteTrack& tracker) {
+    auto begin = chrono::steady_clock::now();
+    frameIndex++;
+    TrackView tracks = tracker.tracks();
+
+    // Tracks the tracker has dropped since the last frame go to the gallery
+    for (size_t i = 0; i < tracks.size(); i++) {
+        known[tracks.id(i)].seenAt = frameIndex;
+    }
+    for (auto it = known.begin(); it != known.end(); ) {
+        if (it->second.seenAt == frameIndex) {
+            ++it;
+            continue;
+        }
+        if (!it->second.embedding.empty()) {
+            gallery.add(it->first, it->second.embedding.data(), frameIndex);
+        }
+        it = known.erase(it);
+    }
+
+    // Only tracks matched this frame have a box worth cropping. Tracks without an embedding go
+    // first, whatever their size, so someone coming back is recognised on the frame they
+    // reappear, before the counter sees their new id.
+    const Rect bounds(0, 0, frame.cols, frame.rows);
+    due.clear();
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks.killCount(i) != 0 || cropFor(tracks.bbox(i), bounds).empty()) continue;
+        if (known[tracks.id(i)].embedding.empty()) due.push_back(i);
+    }
+    size_t fresh = due.size();
+    bool overBudget = cropLimit == 1 && intervalEmaMs > 0 && stageEmaMs > config.budget * intervalEmaMs;
+    if (!overBudget) {
+        for (size_t i = 0; i < tracks.size(); i++) {
+            Rect box = tracks.bbox(i) & bounds;
+            if (tracks.killCount(i) != 0 || box.width < 8 || box.height < 16) continue;
+            const TrackAppearance& appearance = known[tracks.id(i)];
+            if (!appearance.embedding.empty() && frameIndex - appearance.embeddedAt >= static_cast<uint64_t>(config.every)) {
+                due.push_back(i);
+            }
+        }
+        // Stalest first
+        sort(due.begin() + fresh, due.end(), [&](size_t a, size_t b) {
+            return known[tracks.id(a)].embeddedAt < known[tracks.id(b)].embeddedAt;
+        });
+    }
+    // The budget only limits refreshes; every new track is embedded on its first frame
+    size_t limit = max(fresh, static_cast<size_t>(cropLimit));
+    if (due.size() > limit) due.resize(limit);
+    if (!due.empty()) embed(frame, tracks, tracker);
+
+    // Adjust the crops per frame so the average cost stays within budget
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(end - begin).count();
+    totalMs += ms;
+    frames++;
+    if (lastCall.time_since_epoch().count() != 0) {
+        double interval = chrono::duration<double, milli>(end - lastCall).count();
+        wallMs += interval;
+        intervalEmaMs = intervalEmaMs == 0.0 ? interval : 0.9 * intervalEmaMs + 0.1 * interval;
+    }
+    lastCall = end;
+    stageEmaMs = 0.9 * stageEmaMs + 0.1 * ms;
+    if (intervalEmaMs > 0) {
+        if (stageEmaMs > config.budget * intervalEmaMs && cropLimit > 1) {
+            cropLimit--;
+        } else if (stageEmaMs < 0.5 * config.budget * intervalEmaMs && cropLimit < config.maxCropsPerFrame) {
+            cropLimit++;
+        }
+    }
+}
+
+// One forward pass for every due crop
+void ReidStage::embed(const Mat& frame, const TrackView& tracks, ByteTrack& tracker) {
+    const Rect bounds(0, 0, frame.cols, frame.rows);
+    crops.clear();
+    for (size_t i : due) {
+        crops.push_back(frame(cropFor(tracks.bbox(i), bounds))); // Views, blobFromImages does the resize
+    }
+    dnn::blobFromImages(crops, blob, 1.0 / 255.0, config.inputSize, Scalar(), true, false);
+
+    // ImageNet normalisation, which person ReID networks are trained with
+    static const float mean[3] = {0.485f, 0.456f, 0.406f};
+    static const float stdev[3] = {0.229f, 0.224f, 0.225f};
+    const size_t plane = static_cast<size_t>(config.inputSize.area());
+    float* data = blob.ptr<float>();
+    for (size_t n = 0; n < crops.size(); n++) {
+        for (int c = 0; c < 3; c++) {
+            float* p = data + (n * 3 + c) * plane;
+            const float m = mean[c];
+            const float inverse = 1.0f / stdev[c];
+            for (size_t k = 0; k < plane; k++) {
+                p[k] = (p[k] - m) * inverse;
+            }
+        }
+    }
+
+    net.setInput(blob);
+    net.forward(outputs);
+    Mat features = outputs[0].reshape(1, static_cast<int>(crops.size()));
+    CV_Assert(features.type() == CV_32F && features.isContinuous());
+    if (dims == 0) {
+        dims = features.cols;
+        gallery.reset(config.gallerySize, dims);
+    }
+
+    for (size_t k = 0; k < due.size(); k++) {
+        float* feature = features.ptr<float>(static_cast<int>(k));
+        normalize(feature, dims);
+        size_t i = due[k];
+        int id = tracks.id(i);
+        TrackAppearance& appearance = known[id];
+
+        if (appearance.embedding.empty()) {
+            appearance.embedding.assign(feature, feature + dims);
+            appearance.embeddedAt = frameIndex;
+            int lostId = gallery.take(feature, config.minSimilarity, frameIndex, config.maxLostFrames);
+            if (lostId >= 0) {
+                tracker.reassignId(i, lostId);
+                TrackAppearance moved = std::move(appearance);
+                known.erase(id);
+                known[lostId] = std::move(moved);
+                restored++;
+            }
+        } else {
+            // Smoothed, so one crop of someone walking past in front can't replace the appearance
+            for (int j = 0; j < dims; j++) {
+                appearance.embedding[j] = 0.9f * appearance.embedding[j] + 0.1f * feature[j];
+            }
+            normalize(appearance.embedding.data(), dims);
+            appearance.embeddedAt = frameIndex;
+        }
+    }
+    embedded += due.size();
+}
+
+void ReidStage::printStats(ostream& os) const {
+    os << fixed << setprecision(2) << "ReID: mean " << (frames ? totalMs / frames : 0.0) << " ms per frame, "
+       << setprecision(1) << (wallMs > 0 ? 100.0 * totalMs / wallMs : 0.0) << "% of frame time, " << embedded
+       << " crops embedded, " << restored << " ids given back, up to " << cropLimit << " crops per frame" << endl;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "bytetracker.hpp"
+
+#include <opencv2/dnn.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ReidConfig {
+    std::string model;                  // Person embedding network, e.g. an OSNet ONNX export
+    cv::Size inputSize{128, 256};       // Width x height the network takes
+    int every = 10;                     // Frames between refreshes of one track's embedding
+    float minSimilarity = 0.6f;         // Cosine similarity needed to give a lost track's id back
+    size_t gallerySize = 64;            // Lost tracks remembered
+    uint64_t maxLostFrames = 300;       // How long a lost track can be given back
+    int maxCropsPerFrame = 8;           // Upper bound; the budget below lowers it on slow machines
+    float budget = 0.2f;                // Share of frame time the stage may use on average
+};
+
+// Embeddings of recently lost tracks as rows of one contiguous float matrix, searched with SIMD
+// dot products (rows are unit length, so the dot product is the cosine similarity)
+class ReidGallery {
+    public:
+        void reset(size_t capacity, int dims);
+
+        // Replaces the oldest entry when full
+        void add(int id, const float* embedding, uint64_t frame);
+        // Removes and returns the id of the most similar entry lost within maxAge frames, or -1
+        // when none reaches minSimilarity
+        int take(const float* embedding, float minSimilarity, uint64_t frame, uint64_t maxAge);
+
+        size_t size() const { return ids.size(); }
+
+    private:
+        void removeAt(size_t i);
+
+        size_t capacity = 0;
+        int dims = 0;
+        std::vector<float> rows; // capacity x dims, the first size() rows in use
+        std::vector<int> ids;
+        std::vector<uint64_t> lostAt;
+};
+
+// Optional re-identification after the tracker: embeds crops of visible tracks, at most every
+// `every` frames per track and in one batched forward pass per frame, and gives a new track the id
+// of a lost track that looks the same, so someone occluded for longer than maxKillCount keeps
+// their id and isn't counted twice. Runs on the CPU, within `budget` of the frame time.
+class ReidStage {
+    public:
+        explicit ReidStage(const ReidConfig& config);
+
+        // False when the model could not be loaded
+        bool ready() const { return !net.empty(); }
+
+        // Call right after ByteTrack::update on the frame its detections came from, before the
+        // tracks are counted
+        void update(const cv::Mat& frame, ByteTrack& tracker);
+
+        void printStats(std::ostream& os) const;
+
+    private:
+        struct TrackAppearance {
+            std::vector<float> embedding; // Empty until first embedded
+            uint64_t embeddedAt = 0;
+            uint64_t seenAt = 0;
+        };
+
+        void embed(const cv::Mat& frame, const TrackView& tracks, ByteTrack& tracker);
+
+        ReidConfig config;
+        cv::dnn::Net net;
+        int dims = 0;
+        ReidGallery gallery;
+        std::unordered_map<int, TrackAppearance> known; // By track id
+        uint64_t frameIndex = 0;
+
+        // Scratch reused between frames
+        std::vector<size_t> due;
+        std::vector<cv::Mat> crops;
+        cv::Mat blob;
+        std::vector<cv::Mat> outputs;
+
+        // Keeps the stage within budget: fewer crops per frame while it runs over
+        int cropLimit;
+        double stageEmaMs = 0.0;
+        double intervalEmaMs = 0.0;
+        std::chrono::steady_clock::time_point lastCall;
+
+        uint64_t frames = 0;
+        uint64_t embedded = 0;
+        uint64_t restored = 0;
+        double totalMs = 0.0;
+        double wallMs = 0.0;
+};
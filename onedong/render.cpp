@@ -0,0 +1,27 @@
+#include "render.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+void drawZones(Mat& frame, const vector<CountingZone>& zones) {
+    for (const auto& zone : zones) {
+        if (zone.polygon.empty()) {
+            line(frame, zone.a, zone.b, Scalar(0, 255, 255), 2);
+        } else {
+            vector<Point> points(zone.polygon.begin(), zone.polygon.end());
+            polylines(frame, points, true, Scalar(0, 255, 255), 2);
+        }
+    }
+}
+
+void drawTracks(Mat& frame, const TrackView& tracks) {
+    for (size_t i = 0; i < tracks.size(); i++) {
+        const Rect& box = tracks.bbox(i);
+        rectangle(frame, box, tracks.color(i), 2);
+        putText(frame, "ID: " + to_string(tracks.id(i)), box.tl(), FONT_HERSHEY_SIMPLEX, 0.5, tracks.color(i), 2);
+    }
+}
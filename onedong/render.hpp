@@ -0,0 +1,11 @@
+#pragma once
+
+#include "counter.hpp"
+#include "track_pool.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+void drawZones(cv::Mat& frame, const std::vector<CountingZone>& zones);
+void drawTracks(cv::Mat& frame, const TrackView& tracks);
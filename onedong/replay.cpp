@@ -0,0 +1,226 @@
+// Re-runs tracking and counting over detections recorded with `main --record`, without the network.
+// Every combination of --sweep values is one ByteTrack configuration; configurations run in
+// parallel, each on its own cursor over the same mapped log, and their counts are compared
+// against the true counts when --truth gives them.
+#include "bytetracker.hpp"
+#include "counter.hpp"
+#include "detection_log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+struct Sweep {
+    string name;
+    vector<float> values;
+};
+
+struct ReplayResult {
+    ByteTrackConfig config;
+    string label;
+    int entries = 0;
+    int exits = 0;
+    uint64_t frames = 0;
+    uint64_t detections = 0;
+    double seconds = 0.0;
+};
+
+// Parses "name=v1,v2,..."
+static bool parseSweep(const string& text, Sweep& sweep) {
+    size_t eq = text.find('=');
+    if (eq == string::npos) return false;
+    sweep.name = text.substr(0, eq);
+    ByteTrackConfig probe;
+    if (!setByteTrackParam(probe, sweep.name, 0.0f)) return false;
+
+    stringstream values(text.substr(eq + 1));
+    string value;
+    while (getline(values, value, ',')) {
+        char* end = nullptr;
+        float v = strtof(value.c_str(), &end);
+        if (end == value.c_str() || *end != '\0') return false;
+        sweep.values.push_back(v);
+    }
+    return !sweep.values.empty();
+}
+
+// Every combination of the sweeps' values, applied on top of base
+static vector<ReplayResult> expandSweeps(const ByteTrackConfig& base, const vector<Sweep>& sweeps) {
+    vector<ReplayResult> runs(1);
+    runs[0].config = base;
+    for (const auto& sweep : sweeps) {
+        vector<ReplayResult> expanded;
+        for (const auto& run : runs) {
+            for (float value : sweep.values) {
+                ReplayResult next = run;
+                setByteTrackParam(next.config, sweep.name, value);
+                ostringstream label;
+                label << next.label << (next.label.empty() ? "" : " ") << sweep.name << "=" << value;
+                next.label = label.str();
+                expanded.push_back(next);
+            }
+        }
+        runs.swap(expanded);
+    }
+    if (runs[0].label.empty()) runs[0].label = "defaults";
+    return runs;
+}
+
+static void replay(const DetectionLogReader& log, const vector<CountingZone>& zones, float depthGap,
+                   ReplayResult& result) {
+    auto begin = chrono::steady_clock::now();
+    ByteTrack tracker(result.config);
+    if (log.fps() > 0) tracker.setFramePeriod(1.0 / log.fps());
+    // Depth is in the log; with the live run's gate the association is the same as it was live
+    tracker.setDepthGate(depthGap);
+    LineCounter counter(zones);
+    vector<CrossingEvent> events;
+
+    DetectionLogFrame frame;
+    DetectionLogReader::Cursor cursor = log.frames();
+    while (cursor.next(frame)) {
+        // Only the gaps between frames matter to the tracker, so the wall clock stands in for the steady one
+        chrono::steady_clock::time_point timestamp(
+            chrono::duration_cast<chrono::steady_clock::duration>(frame.time.time_since_epoch()));
+        result.detections += frame.detections.size();
+        TrackView tracks = tracker.update(frame.detections, timestamp);
+        events.clear();
+        counter.update(tracks, frame.time, events);
+        result.frames++;
+    }
+    result.entries = counter.entries();
+    result.exits = counter.exits();
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+static void writeJson(const string& path, const string& logPath, const vector<ReplayResult>& results,
+                      int trueEntries, int trueExits) {
+    ofstream json(path);
+    json << "{\n  \"log\": \"" << logPath << "\",\n";
+    if (trueEntries >= 0) {
+        json << "  \"truth\": {\"entries\": " << trueEntries << ", \"exits\": " << trueExits << "},\n";
+    }
+    json << "  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const ReplayResult& r = results[i];
+        const ByteTrackConfig& c = r.config;
+        json << "    {\"max_kill\": " << c.maxKillCount << ", \"iou_high\": " << c.iouThresholdHigh
+             << ", \"iou_low\": " << c.iouThresholdLow << ", \"conf_high\": " << c.confThresholdHigh
+             << ", \"conf_low\": " << c.confThresholdLow << ", \"entries\": " << r.entries
+             << ", \"exits\": " << r.exits << ", \"frames\": " << r.frames << ", \"seconds\": " << r.seconds
+             << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    string logPath;
+    vector<CountingZone> zones;
+    ByteTrackConfig base;
+    vector<Sweep> sweeps;
+    int trueEntries = -1, trueExits = -1;
+    int jobs = static_cast<int>(thread::hardware_concurrency());
+    string jsonPath;
+    float depthGap = 0.0f;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--zone") == 0 && i + 1 < argc) {
+            CountingZone zone;
+            if (!parseZone(argv[++i], zone)) {
+                cerr << "Error: Bad zone " << argv[i] << ", expected entrance:x1,y1,x2,y2[,...]" << endl;
+                return -1;
+            }
+            zones.push_back(zone);
+        } else if (strcmp(argv[i], "--track-param") == 0 && i + 1 < argc) {
+            if (!parseByteTrackParam(argv[++i], base)) {
+                cerr << "Error: Bad tracker parameter " << argv[i] << ", expected name=value" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            Sweep sweep;
+            if (!parseSweep(argv[++i], sweep)) {
+                cerr << "Error: Bad sweep " << argv[i]
+                     << ", expected max-kill|iou-high|iou-low|conf-high|conf-low=v1,v2,..." << endl;
+                return -1;
+            }
+            sweeps.push_back(sweep);
+        } else if (strcmp(argv[i], "--truth") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d", &trueEntries, &trueExits) != 2) {
+                cerr << "Error: Bad truth " << argv[i] << ", expected entries,exits" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth-gap") == 0 && i + 1 < argc) {
+            depthGap = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            logPath = argv[i];
+        }
+    }
+    if (logPath.empty()) {
+        cerr << "Usage: replay detections.log [--zone ...] [--track-param name=value] [--sweep name=v1,v2,...] "
+                "[--truth entries,exits] [--depth-gap D] [--jobs N] [--json out.json]" << endl;
+        return -1;
+    }
+    if (zones.empty()) {
+        cerr << "Warning: No --zone given, nothing will be counted" << endl;
+    }
+
+    DetectionLogReader log;
+    if (!log.open(logPath)) {
+        return -1;
+    }
+
+    vector<ReplayResult> results = expandSweeps(base, sweeps);
+    jobs = max(1, min(jobs, static_cast<int>(results.size())));
+    auto begin = chrono::steady_clock::now();
+    atomic<size_t> nextRun{0};
+    vector<thread> workers;
+    for (int j = 0; j < jobs; j++) {
+        workers.emplace_back([&] {
+            for (size_t r = nextRun++; r < results.size(); r = nextRun++) {
+                replay(log, zones, depthGap, results[r]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    // Best first when the true counts are known
+    auto error = [&](const ReplayResult& r) { return abs(r.entries - trueEntries) + abs(r.exits - trueExits); };
+    if (trueEntries >= 0) {
+        stable_sort(results.begin(), results.end(),
+                    [&](const ReplayResult& a, const ReplayResult& b) { return error(a) < error(b); });
+    }
+
+    uint64_t detections = 0;
+    cout << fixed << setprecision(2);
+    cout << "entries  exits" << (trueEntries >= 0 ? "  error" : "") << "  Mdet/s  config" << endl;
+    for (const auto& r : results) {
+        cout << setw(7) << r.entries << setw(7) << r.exits;
+        if (trueEntries >= 0) cout << setw(7) << error(r);
+        cout << setw(8) << (r.seconds > 0 ? r.detections / r.seconds / 1e6 : 0.0) << "  " << r.label << endl;
+        detections += r.detections;
+    }
+    cout << results.size() << " runs over " << results[0].frames << " frames in " << seconds << " s on " << jobs
+         << " threads, " << (seconds > 0 ? detections / seconds / 1e6 : 0.0) << " M detections/s" << endl;
+
+    if (!jsonPath.empty()) {
+        writeJson(jsonPath, logPath, results, trueEntries, trueExits);
+    }
+    return 0;
+}
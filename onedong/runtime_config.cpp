@@ -0,0 +1,124 @@
+#include "runtime_config.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using namespace cv;
+using namespace std;
+
+// Reads node into value when it is there
+template <typename T>
+static void readIfPresent(const FileNode& node, T& value) {
+    if (!node.isNone()) node >> value;
+}
+
+bool loadRuntimeConfig(const string& path, RuntimeConfig& config) {
+    FileStorage fs;
+    try {
+        if (!fs.open(path, FileStorage::READ)) {
+            cerr << "Error: Cannot open config " << path << endl;
+            return false;
+        }
+    } catch (const cv::Exception& e) {
+        // Also what a half-saved file looks like
+        cerr << "Error: Cannot parse config " << path << ": " << e.what() << endl;
+        return false;
+    }
+
+    FileNode sources = fs["sources"];
+    if (!sources.isNone()) {
+        config.sources.clear();
+        for (const auto& source : sources) {
+            config.sources.push_back(source.string());
+        }
+    }
+
+    FileNode detector = fs["detector"];
+    if (!detector.isNone() && !parseDetector(detector.string(), config.detector)) {
+        cerr << "Error: Bad detector " << detector.string() << " in " << path << endl;
+        return false;
+    }
+
+    FileNode inputSize = fs["inputSize"];
+    if (!inputSize.isNone() && !parseInputSize(inputSize.string(), config.detector.inputSize)) {
+        cerr << "Error: Bad input size " << inputSize.string() << " in " << path << ", expected WIDTHxHEIGHT" << endl;
+        return false;
+    }
+
+    FileNode tracker = fs["tracker"];
+    readIfPresent(tracker["maxKill"], config.tracker.maxKillCount);
+    readIfPresent(tracker["iouHigh"], config.tracker.iouThresholdHigh);
+    readIfPresent(tracker["iouLow"], config.tracker.iouThresholdLow);
+    readIfPresent(tracker["confHigh"], config.tracker.confThresholdHigh);
+    readIfPresent(tracker["confLow"], config.tracker.confThresholdLow);
+
+    FileNode nms = fs["nms"];
+    readIfPresent(nms["score"], config.nms.scoreThreshold);
+    readIfPresent(nms["iou"], config.nms.iouThreshold);
+    readIfPresent(nms["topK"], config.nms.topK);
+    readIfPresent(nms["sigma"], config.nms.matrixSigma);
+    readIfPresent(nms["minScore"], config.nms.matrixMinScore);
+    FileNode method = nms["method"];
+    if (!method.isNone() && !parseNmsMethod(method.string(), config.nms.method)) {
+        cerr << "Error: Bad NMS method " << method.string() << " in " << path << endl;
+        return false;
+    }
+    readIfPresent(fs["decodeConfidence"], config.decodeConfidence);
+
+    FileNode zones = fs["zones"];
+    if (!zones.isNone()) {
+        config.zones.clear();
+        for (const auto& node : zones) {
+            CountingZone zone;
+            if (!parseZone(node.string(), zone)) {
+                cerr << "Error: Bad zone " << node.string() << " in " << path << endl;
+                return false;
+            }
+            config.zones.push_back(zone);
+        }
+    }
+
+    readIfPresent(fs["server"], config.server);
+    return true;
+}
+
+ConfigWatcher::ConfigWatcher(const string& path) {
+    size_t slash = path.rfind('/');
+    directory = slash == string::npos ? "." : path.substr(0, slash + 1);
+    fileName = slash == string::npos ? path : path.substr(slash + 1);
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    if (fd >= 0) close(fd);
+}
+
+bool ConfigWatcher::start() {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        cerr << "Error: Cannot watch " << directory << " for config changes: " << strerror(errno) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool ConfigWatcher::changed() {
+    if (fd < 0) return false;
+
+    bool hit = false;
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            if (event->len > 0 && fileName == event->name) {
+                hit = true;
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return hit;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bytetracker.hpp"
+#include "counter.hpp"
+#include "detector.hpp"
+#include "nms.hpp"
+
+#include <string>
+#include <vector>
+
+// What a site tunes, read from --config (YAML or JSON, through cv::FileStorage). Keys that are
+// missing keep their defaults, so a file only needs what differs:
+//
+//   sources: [ "0" ]
+//   detector: "onnx:model.int8.onnx"
+//   inputSize: "416x416"
+//   tracker: { maxKill: 15, iouHigh: 0.3, iouLow: 0.4, confHigh: 0.6, confLow: 0.1 }
+//   nms: { score: 0.1, iou: 0.65, method: "greedy", topK: 0, sigma: 2.0, minScore: 0.1 }
+//   decodeConfidence: 0.1
+//   zones: [ "1:100,400,540,400" ]
+//   server: "http://host:8000/api/v1/"
+//
+// Zones and the detector use the same syntax as --zone and --detector; with several sources each
+// zone starts with its source's index ("1:2:100,400,540,400").
+struct RuntimeConfig {
+    std::vector<std::string> sources;
+    DetectorConfig detector;
+    ByteTrackConfig tracker;
+    NmsParams nms;
+    float decodeConfidence = 0.1f; // Candidates below this never reach NMS
+    std::vector<CountingZone> zones;
+    std::string server; // Empty for no uplink
+};
+
+// Fills in the keys present in path. Prints the reason and returns false on a file that can't
+// be read or has a bad value, leaving config partly updated.
+bool loadRuntimeConfig(const std::string& path, RuntimeConfig& config);
+
+// Watches the config file through inotify on its directory, so editors that save by writing a new
+// file and renaming it over the old one are seen too. Polled from the frame loop, never blocks.
+class ConfigWatcher {
+    public:
+        explicit ConfigWatcher(const std::string& path);
+        ~ConfigWatcher();
+        ConfigWatcher(const ConfigWatcher&) = delete;
+        ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+        bool start();
+        // True once per burst of writes to the file since the last call
+        bool changed();
+
+    private:
+        std::string directory;
+        std::string fileName;
+        int fd = -1;
+};
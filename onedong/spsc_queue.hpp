@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Holds at most `depth` items; slots are rounded up to a power of two so indices wrap with a mask.
+template <typename T>
+class SpscQueue {
+    public:
+        explicit SpscQueue(size_t depth) : depth(depth < 1 ? 1 : depth) {
+            size_t slotCount = 1;
+            while (slotCount < this->depth) {
+                slotCount <<= 1;
+            }
+            slots.resize(slotCount);
+            mask = slotCount - 1;
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // Producer side. Returns false (and leaves item untouched) when the queue is full.
+        bool tryPush(T& item) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) >= depth) {
+                return false;
+            }
+            slots[t & mask] = std::move(item);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Returns false when the queue is empty.
+        bool tryPop(T& item) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = std::move(slots[h & mask]);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Approximate when called from a third thread; exact from producer or consumer.
+        size_t size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const {
+            return depth;
+        }
+
+    private:
+        std::vector<T> slots;
+        size_t mask;
+        size_t depth;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+};
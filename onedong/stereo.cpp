@@ -0,0 +1,192 @@
+#include "stereo.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+bool parseDepthRange(const string& text, float& minDepth, float& maxDepth) {
+    float low, high;
+    if (sscanf(text.c_str(), "%f,%f", &low, &high) != 2 || low < 0 || (high > 0 && high <= low)) {
+        return false;
+    }
+    minDepth = low;
+    maxDepth = high;
+    return true;
+}
+
+bool StereoCalibration::load(const string& path) {
+    FileStorage fs;
+    if (!fs.open(path, FileStorage::READ)) {
+        cerr << "Error: Cannot open stereo calibration " << path << endl;
+        return false;
+    }
+
+    int width = 0, height = 0;
+    Mat leftCamera, leftDistortion, leftRectification, leftProjection;
+    Mat rightCamera, rightDistortion, rightRectification, rightProjection;
+    Mat q;
+    fs["imageWidth"] >> width;
+    fs["imageHeight"] >> height;
+    fs["leftCameraMatrix"] >> leftCamera;
+    fs["leftDistortion"] >> leftDistortion;
+    fs["leftRectification"] >> leftRectification;
+    fs["leftProjection"] >> leftProjection;
+    fs["rightCameraMatrix"] >> rightCamera;
+    fs["rightDistortion"] >> rightDistortion;
+    fs["rightRectification"] >> rightRectification;
+    fs["rightProjection"] >> rightProjection;
+    fs["disparityToDepth"] >> q;
+    if (width <= 0 || height <= 0 || leftCamera.empty() || leftRectification.empty() || leftProjection.empty() ||
+        rightCamera.empty() || rightRectification.empty() || rightProjection.empty() || q.rows != 4 || q.cols != 4) {
+        cerr << "Error: " << path << " is incomplete, rerun calibration.py" << endl;
+        return false;
+    }
+
+    imageSize = Size(width, height);
+    initUndistortRectifyMap(leftCamera, leftDistortion, leftRectification, leftProjection, imageSize, CV_16SC2,
+                            leftMap1, leftMap2);
+    initUndistortRectifyMap(rightCamera, rightDistortion, rightRectification, rightProjection, imageSize, CV_16SC2,
+                            rightMap1, rightMap2);
+    q.convertTo(q, CV_64F);
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            disparityToDepth(r, c) = q.at<double>(r, c);
+        }
+    }
+    return true;
+}
+
+float StereoCalibration::depthAt(float disparity) const {
+    // Z = f / (d / -Tx + (cx - cx') / Tx), with f, Tx and the principal points folded into Q
+    double w = disparityToDepth(3, 2) * disparity + disparityToDepth(3, 3);
+    if (disparity <= 0 || w <= 0) return 0.0f;
+    return static_cast<float>(disparityToDepth(2, 3) / w);
+}
+
+StereoRig::StereoRig(const StereoConfig& config) : settings(config) {}
+
+bool StereoRig::loadCalibration() {
+    return calib.load(settings.calibration);
+}
+
+bool StereoRig::open(const CaptureConfig& capture) {
+    right = openCapture(settings.rightSource, capture);
+    if (!right) {
+        cerr << "Error: Cannot open right camera " << settings.rightSource << endl;
+        return false;
+    }
+    double fps = right->fps();
+    regrabSkewMs = 500.0 / (fps > 0 ? fps : 30.0);
+    return true;
+}
+
+bool StereoRig::read(CaptureSource& left, Mat& leftFrame, Mat& rightFrame) {
+    if (!left.grab() || !right->grab()) return false;
+
+    // The cameras aren't hardware-triggered, so when one of them delivered a frame more than half
+    // a period earlier than the other, its next one is the better match
+    double skew = chrono::duration<double, milli>(left.timestamp() - right->timestamp()).count();
+    if (skew < -regrabSkewMs) {
+        if (!left.grab()) return false;
+        regrabbed.fetch_add(1, memory_order_relaxed);
+    } else if (skew > regrabSkewMs) {
+        if (!right->grab()) return false;
+        regrabbed.fetch_add(1, memory_order_relaxed);
+    }
+
+    if (!left.retrieve(leftFrame) || !right->retrieve(rightFrame)) {
+        return false;
+    }
+    if (leftFrame.size() != calib.imageSize || rightFrame.size() != calib.imageSize) {
+        cerr << "Error: Stereo cameras deliver " << leftFrame.cols << "x" << leftFrame.rows << " and "
+             << rightFrame.cols << "x" << rightFrame.rows << ", calibration is for " << calib.imageSize.width
+             << "x" << calib.imageSize.height << endl;
+        return false;
+    }
+    paired.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void StereoRig::rectifyLeft(const Mat& raw, Mat& rectified) const {
+    remap(raw, rectified, calib.leftMap1, calib.leftMap2, INTER_LINEAR);
+}
+
+StereoDepth::StereoDepth(const StereoRig& rig)
+    : rig(rig),
+      calib(rig.calibration()),
+      config(rig.config()),
+      matcher(StereoBM::create(config.numDisparities, config.blockSize)) {}
+
+float StereoDepth::boxDepth(const Mat& leftRectified, const Mat& rightRaw, const Rect& box) {
+    const Rect frameRect(Point(0, 0), leftRectified.size());
+    // The middle half of the box: head and shoulders from overhead, without the floor around them
+    Rect core = Rect(box.x + box.width / 4, box.y + box.height / 4, box.width / 2, box.height / 2) & frameRect;
+    if (core.empty()) return 0.0f;
+
+    // Matching a pixel needs its block, and the right view up to numDisparities columns to its left
+    const int half = config.blockSize / 2;
+    Rect window = Rect(core.x - config.numDisparities - half, core.y - half,
+                       core.width + config.numDisparities + 2 * half, core.height + 2 * half) & frameRect;
+    if (window.width <= config.numDisparities + config.blockSize || window.height <= config.blockSize) {
+        return 0.0f;
+    }
+
+    // Only the window of the right view is rectified; the maps are indexed by destination pixel
+    cvtColor(leftRectified(window), leftGray, COLOR_BGR2GRAY);
+    remap(rightRaw, rightRectified, calib.rightMap1(window), calib.rightMap2(window), INTER_LINEAR);
+    cvtColor(rightRectified, rightGray, COLOR_BGR2GRAY);
+    matcher->compute(leftGray, rightGray, disparity);
+
+    // Median of the valid disparities (16ths of a pixel, negative when unmatched)
+    samples.clear();
+    const Rect inner = core - window.tl();
+    for (int y = inner.y; y < inner.y + inner.height; y++) {
+        const short* row = disparity.ptr<short>(y);
+        for (int x = inner.x; x < inner.x + inner.width; x++) {
+            if (row[x] > 0) samples.push_back(row[x]);
+        }
+    }
+    // Too little texture to trust
+    if (samples.size() * 10 < static_cast<size_t>(inner.area())) return 0.0f;
+
+    auto middle = samples.begin() + samples.size() / 2;
+    nth_element(samples.begin(), middle, samples.end());
+    return calib.depthAt(*middle / 16.0f);
+}
+
+void StereoDepth::estimate(const Mat& leftRectified, const Mat& rightRaw, vector<Detection>& detections) {
+    auto begin = chrono::steady_clock::now();
+    for (auto& det : detections) {
+        det.depth = boxDepth(leftRectified, rightRaw, det.bbox);
+        boxes++;
+        if (det.depth > 0) measured++;
+    }
+    frames++;
+    totalMs += chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+void StereoDepth::gate(vector<Detection>& detections) {
+    if (config.minDepth <= 0 && config.maxDepth <= 0) return;
+
+    size_t before = detections.size();
+    detections.erase(remove_if(detections.begin(), detections.end(),
+                               [this](const Detection& det) {
+                                   return det.depth > 0 && ((config.minDepth > 0 && det.depth < config.minDepth) ||
+                                                            (config.maxDepth > 0 && det.depth > config.maxDepth));
+                               }),
+                     detections.end());
+    rejected += before - detections.size();
+}
+
+void StereoDepth::printStats(ostream& os) const {
+    os << fixed << setprecision(2) << "Stereo: mean " << (frames ? totalMs / frames : 0.0) << " ms per frame, depth for "
+       << measured << " of " << boxes << " boxes, " << rejected << " rejected by the depth gate, "
+       << rig.regrabs() << " of " << rig.pairs() << " pairs regrabbed to stay in sync" << endl;
+}
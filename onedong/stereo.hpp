@@ -0,0 +1,115 @@
+#pragma once
+
+#include "capture.hpp"
+#include "detection.hpp"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct StereoConfig {
+    std::string rightSource; // Second camera of the pair; empty disables stereo
+    std::string calibration = "calibration_data.yml";
+    int numDisparities = 80; // Search range, a multiple of 16 (stereo.py uses 16 * 5)
+    int blockSize = 15;      // Odd matching window
+    // Occupancy gate in calibration units (cm from calibration.py): detections whose depth is known
+    // and outside it are dropped. 0 leaves that side open.
+    float minDepth = 0.0f;
+    float maxDepth = 0.0f;
+    // Tracks and detections further apart in depth than this never match, 0 disables
+    float maxDepthGap = 0.0f;
+};
+
+// Parses "min,max" in calibration units
+bool parseDepthRange(const std::string& text, float& minDepth, float& maxDepth);
+
+// Rectification for a calibrated pair, read from the calibration_data.yml calibration.py writes.
+// The remap tables are built once at load and kept in fixed-point form, which remap() runs
+// several times faster than the float maps stereo.py uses.
+struct StereoCalibration {
+    cv::Size imageSize;
+    cv::Mat leftMap1, leftMap2;
+    cv::Mat rightMap1, rightMap2;
+    cv::Matx44d disparityToDepth; // Q from stereoRectify
+
+    bool load(const std::string& path);
+    // Depth along the optical axis for a disparity in pixels, 0 when it can't be one
+    float depthAt(float disparity) const;
+};
+
+// The two V4L2 cameras of a stereo pair. The left one is the pipeline's own capture; the rig
+// opens the right one and grabs both back to back before decoding either, so the pair is as
+// close in time as the driver allows. Read from the capture thread only.
+class StereoRig {
+    public:
+        explicit StereoRig(const StereoConfig& config);
+
+        // Both cameras have to run at the calibrated size: open the left one with this
+        bool loadCalibration();
+        // Opens the right camera like the left one
+        bool open(const CaptureConfig& capture);
+
+        // Grabs a synchronized pair. Both frames are raw; see rectifyLeft. The left camera's
+        // timestamp is the pair's.
+        bool read(CaptureSource& left, cv::Mat& leftFrame, cv::Mat& rightFrame);
+
+        // Full-frame rectification of the left view, which detection runs on. The right view is
+        // only ever rectified inside person boxes, by StereoDepth.
+        void rectifyLeft(const cv::Mat& raw, cv::Mat& rectified) const;
+
+        const StereoCalibration& calibration() const { return calib; }
+        const StereoConfig& config() const { return settings; }
+        uint64_t regrabs() const { return regrabbed.load(std::memory_order_relaxed); }
+        uint64_t pairs() const { return paired.load(std::memory_order_relaxed); }
+
+    private:
+        StereoConfig settings;
+        StereoCalibration calib;
+        std::unique_ptr<CaptureSource> right;
+        double regrabSkewMs = 0.0; // Half a frame period: past that, the lagging camera's next frame is closer
+        std::atomic<uint64_t> regrabbed{0};
+        std::atomic<uint64_t> paired{0};
+};
+
+// Gives each Detection a depth from block matching inside its box, instead of over the full
+// frame: for a handful of people that is a few percent of the pixels, which is what keeps it at
+// camera rate on a CPU. Runs on the tracking thread; scratch buffers are reused between frames.
+class StereoDepth {
+    public:
+        explicit StereoDepth(const StereoRig& rig);
+
+        // leftRectified is the frame the boxes are in, rightRaw the unrectified right frame
+        void estimate(const cv::Mat& leftRectified, const cv::Mat& rightRaw, std::vector<Detection>& detections);
+
+        // Drops detections whose depth is known and outside the configured range: a person on a
+        // poster or reflected in the floor sits at the floor's depth or beyond it
+        void gate(std::vector<Detection>& detections);
+
+        void printStats(std::ostream& os) const;
+
+    private:
+        float boxDepth(const cv::Mat& leftRectified, const cv::Mat& rightRaw, const cv::Rect& box);
+
+        const StereoRig& rig;
+        const StereoCalibration& calib;
+        StereoConfig config;
+        cv::Ptr<cv::StereoBM> matcher;
+
+        cv::Mat leftGray;
+        cv::Mat rightRectified;
+        cv::Mat rightGray;
+        cv::Mat disparity;
+        std::vector<short> samples;
+
+        uint64_t frames = 0;
+        uint64_t boxes = 0;
+        uint64_t measured = 0;
+        uint64_t rejected = 0;
+        double totalMs = 0.0;
+};
@@ -0,0 +1,49 @@
+#include "synthetic_crowd.hpp"
+
+using namespace cv;
+using namespace std;
+
+vector<Person> makeCrowd(int count, mt19937& rng) {
+    uniform_real_distribution<float> posX(0, 1920), posY(0, 1080), vel(-6, 6);
+    uniform_int_distribution<int> width(30, 70);
+    vector<Person> crowd(count);
+    for (auto& p : crowd) {
+        p.width = width(rng);
+        p.height = p.width * 5 / 2;
+        p.x = posX(rng);
+        p.y = posY(rng);
+        p.vx = vel(rng);
+        p.vy = vel(rng);
+    }
+    return crowd;
+}
+
+void stepCrowd(vector<Person>& crowd) {
+    for (auto& p : crowd) {
+        p.x += p.vx;
+        p.y += p.vy;
+        if (p.x < 0 || p.x > 1920) p.vx = -p.vx;
+        if (p.y < 0 || p.y > 1080) p.vy = -p.vy;
+    }
+}
+
+vector<Rect> observeCrowd(const vector<Person>& crowd, mt19937& rng, int jitter) {
+    uniform_int_distribution<int> noise(-jitter, jitter);
+    vector<Rect> boxes;
+    boxes.reserve(crowd.size());
+    for (const auto& p : crowd) {
+        boxes.emplace_back(static_cast<int>(p.x) + noise(rng), static_cast<int>(p.y) + noise(rng), p.width, p.height);
+    }
+    return boxes;
+}
+
+void crowdDetections(const vector<Person>& crowd, mt19937& rng, int jitter, vector<Detection>& detections) {
+    detections.clear();
+    for (const auto& box : observeCrowd(crowd, rng, jitter)) {
+        Detection det;
+        det.id = -1;
+        det.bbox = box;
+        det.confidence = 0.8f;
+        detections.push_back(det);
+    }
+}
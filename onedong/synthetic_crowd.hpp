@@ -0,0 +1,24 @@
+#pragma once
+
+#include "detection.hpp"
+
+#include <random>
+#include <vector>
+
+// Synthetic pedestrians for the tracker benchmarks
+struct Person {
+    float x, y, vx, vy;
+    int width, height;
+};
+
+// People of roughly pedestrian size walking around a 1080p frame
+std::vector<Person> makeCrowd(int count, std::mt19937& rng);
+
+// Moves everyone one frame, bouncing off the frame edges
+void stepCrowd(std::vector<Person>& crowd);
+
+// Boxes as a detector would see them, with up to `jitter` pixels of noise
+std::vector<cv::Rect> observeCrowd(const std::vector<Person>& crowd, std::mt19937& rng, int jitter);
+
+// Fills detections with one confident, unassigned detection per observed person
+void crowdDetections(const std::vector<Person>& crowd, std::mt19937& rng, int jitter, std::vector<Detection>& detections);
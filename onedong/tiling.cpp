@@ -0,0 +1,45 @@
+#include "tiling.hpp"
+
+#include <cstdio>
+
+using namespace cv;
+using namespace std;
+
+bool parseTile(const string& text, Rect& tile) {
+    return sscanf(text.c_str(), "%d,%d,%d,%d", &tile.x, &tile.y, &tile.width, &tile.height) == 4 &&
+           tile.width > 0 && tile.height > 0;
+}
+
+TiledInput::TiledInput(vector<Rect> tiles, const PreprocessConfig& config)
+    : tiles(std::move(tiles)),
+      inputSize(config.inputSize),
+      preprocessors(this->tiles.size(), Preprocessor(config)),
+      params(this->tiles.size()) {}
+
+void TiledInput::run(const Mat& frame, Mat& blob) {
+    const int shape[] = {static_cast<int>(tiles.size()), 3, inputSize.height, inputSize.width};
+    blob.create(4, shape, CV_32F);
+    const size_t imageSize = static_cast<size_t>(3) * inputSize.width * inputSize.height;
+
+    const Rect bounds(0, 0, frame.cols, frame.rows);
+    for (size_t i = 0; i < tiles.size(); i++) {
+        // A tile that misses the frame entirely (wrong camera?) falls back to the whole frame
+        Rect roi = tiles[i] & bounds;
+        if (roi.empty()) {
+            roi = bounds;
+        }
+
+        preprocessors[i].run(frame(roi), blob.ptr<float>() + i * imageSize);
+        params[i] = preprocessors[i].decodeParams();
+        params[i].offsetX += roi.x;
+        params[i].offsetY += roi.y;
+    }
+}
+
+uint64_t TiledInput::reallocations() const {
+    uint64_t total = 0;
+    for (const auto& preprocessor : preprocessors) {
+        total += preprocessor.reallocations();
+    }
+    return total;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "preprocess.hpp"
+#include "yolo_decoder.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parses a tile as "x,y,width,height" in frame pixels
+bool parseTile(const std::string& text, cv::Rect& tile);
+
+// Runs the network on fixed regions of the frame (say, the doorway of a 4K camera) instead of
+// the whole frame squashed into the input size. Every tile is preprocessed into one slot of a
+// single batched blob, so they all go through one forward pass; decodeParams() maps each slot's
+// boxes back to frame pixels, and NMS over the merged boxes removes duplicates where tiles overlap.
+class TiledInput {
+    public:
+        explicit TiledInput(std::vector<cv::Rect> tiles = {}, const PreprocessConfig& config = PreprocessConfig());
+
+        bool enabled() const { return !tiles.empty(); }
+        size_t size() const { return tiles.size(); }
+
+        // Writes an Nx3xHxW blob with one image per tile, reusing blob's buffer
+        void run(const cv::Mat& frame, cv::Mat& blob);
+
+        // One mapping per tile, for decodeBatch, valid for the last frame run
+        const std::vector<DecodeParams>& decodeParams() const { return params; }
+
+        // Sum over the tiles' preprocessors, see Preprocessor::reallocations()
+        uint64_t reallocations() const;
+
+    private:
+        std::vector<cv::Rect> tiles;
+        cv::Size inputSize;
+        std::vector<Preprocessor> preprocessors; // Per tile, tiles can differ in size
+        std::vector<DecodeParams> params;
+};
@@ -0,0 +1,74 @@
+#include "track_pool.hpp"
+
+using namespace cv;
+using namespace std;
+
+size_t TrackPool::add(int id, const Rect& bbox, float confidence, float depth, const KalmanState& state,
+                      const Scalar& color) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+        colors.emplace_back();
+    }
+
+    size_t index = ids.size();
+    slots[slot].index = static_cast<uint32_t>(index);
+    slots[slot].live = true;
+    colors[slot] = color;
+
+    ids.push_back(id);
+    boxes.push_back(bbox);
+    confidences.push_back(confidence);
+    depths.push_back(depth);
+    killCounts.push_back(0);
+    matched.push_back(0);
+    states.push_back(state);
+    slotOf.push_back(slot);
+    return index;
+}
+
+void TrackPool::remove(size_t i) {
+    Slot& dead = slots[slotOf[i]];
+    dead.live = false;
+    dead.generation++; // Outstanding handles to this slot go stale
+    freeSlots.push_back(slotOf[i]);
+
+    size_t last = ids.size() - 1;
+    if (i != last) {
+        ids[i] = ids[last];
+        boxes[i] = boxes[last];
+        confidences[i] = confidences[last];
+        depths[i] = depths[last];
+        killCounts[i] = killCounts[last];
+        matched[i] = matched[last];
+        states[i] = states[last];
+        slotOf[i] = slotOf[last];
+        slots[slotOf[i]].index = static_cast<uint32_t>(i);
+    }
+    ids.pop_back();
+    boxes.pop_back();
+    confidences.pop_back();
+    depths.pop_back();
+    killCounts.pop_back();
+    matched.pop_back();
+    states.pop_back();
+    slotOf.pop_back();
+}
+
+TrackHandle TrackPool::handle(size_t i) const {
+    TrackHandle h;
+    h.slot = slotOf[i];
+    h.generation = slots[h.slot].generation;
+    return h;
+}
+
+int TrackPool::indexOf(TrackHandle handle) const {
+    if (handle.slot >= slots.size()) return -1;
+    const Slot& slot = slots[handle.slot];
+    if (!slot.live || slot.generation != handle.generation) return -1;
+    return static_cast<int>(slot.index);
+}
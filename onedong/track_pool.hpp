@@ -0,0 +1,79 @@
+#pragma once
+
+#include "kalman.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Refers to one track for as long as it lives, however the pool reorders
+struct TrackHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+};
+
+// Live tracks in structure-of-arrays form. The per-frame fields are dense arrays indexed
+// 0..size()-1, and removing a track moves the last one into its place, so dense order is not
+// stable. Each track also holds a slot that doesn't move while it lives; data only the renderer
+// needs (color) is indexed by slot, so swap-and-pop never copies it.
+class TrackPool {
+    public:
+        size_t size() const { return ids.size(); }
+        bool empty() const { return ids.empty(); }
+
+        // Appends a track and returns its dense index
+        size_t add(int id, const cv::Rect& bbox, float confidence, float depth, const KalmanState& state,
+                   const cv::Scalar& color);
+        // Swap-and-pop: the last track takes over index i
+        void remove(size_t i);
+
+        TrackHandle handle(size_t i) const;
+        // Dense index of the handle's track, -1 once it has been removed
+        int indexOf(TrackHandle handle) const;
+
+        // Hot, dense
+        std::vector<int> ids;
+        std::vector<cv::Rect> boxes;
+        std::vector<float> confidences;
+        std::vector<float> depths; // Last known, 0 when never measured
+        std::vector<int> killCounts;
+        std::vector<uint8_t> matched;
+        std::vector<KalmanState> states;
+        std::vector<uint32_t> slotOf;
+
+        // Cold, by slot
+        std::vector<cv::Scalar> colors;
+
+    private:
+        struct Slot {
+            uint32_t index = 0;
+            uint32_t generation = 0;
+            bool live = false;
+        };
+
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+};
+
+// Read-only window onto a tracker's tracks. Valid until the tracker's next update.
+class TrackView {
+    public:
+        TrackView() = default;
+        explicit TrackView(const TrackPool& pool) : pool(&pool) {}
+
+        size_t size() const { return pool ? pool->size() : 0; }
+        bool empty() const { return size() == 0; }
+
+        int id(size_t i) const { return pool->ids[i]; }
+        const cv::Rect& bbox(size_t i) const { return pool->boxes[i]; }
+        float confidence(size_t i) const { return pool->confidences[i]; }
+        float depth(size_t i) const { return pool->depths[i]; }
+        int killCount(size_t i) const { return pool->killCounts[i]; }
+        const cv::Scalar& color(size_t i) const { return pool->colors[pool->slotOf[i]]; }
+        TrackHandle handle(size_t i) const { return pool->handle(i); }
+
+    private:
+        const TrackPool* pool = nullptr;
+};
@@ -0,0 +1,110 @@
+// Microbenchmark for the tracker's association step.
+// Sweeps track and detection counts over a synthetic crowd and compares the grid-pruned
+// matcher against a single dense Hungarian solve, then times ByteTrack::update end to end.
+#include "assignment.hpp"
+#include "bytetracker.hpp"
+#include "synthetic_crowd.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+static double denseTotalIoU(const vector<Rect>& tracks, const vector<Rect>& dets, float minIoU, double& ms) {
+    auto begin = chrono::steady_clock::now();
+    vector<float> cost(tracks.size() * dets.size());
+    for (size_t t = 0; t < tracks.size(); t++) {
+        for (size_t d = 0; d < dets.size(); d++) {
+            float iou = computeIoU(tracks[t], dets[d]);
+            cost[t * dets.size() + d] = iou > minIoU ? 1.0f - iou : 1.0f;
+        }
+    }
+    vector<int> rowToCol;
+    solveAssignment(cost.data(), tracks.size(), dets.size(), rowToCol);
+    ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    double total = 0;
+    for (size_t t = 0; t < tracks.size(); t++) {
+        int d = rowToCol[t];
+        if (d >= 0 && cost[t * dets.size() + d] < 1.0f) total += 1.0f - cost[t * dets.size() + d];
+    }
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    int maxCount = 2000;
+    int denseLimit = 500;
+    int frames = 100;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) maxCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dense-limit") == 0 && i + 1 < argc) denseLimit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = atoi(argv[++i]);
+    }
+
+    const float minIoU = 0.3f;
+    mt19937 rng(42);
+
+    cout << fixed << setprecision(3);
+    cout << "tracks  dets  candidates  pruned_ms  dense_ms  same_cost  update_ms" << endl;
+    for (int tracks : {10, 30, 60, 120, 250, 500, 1000, 2000, 5000}) {
+        if (tracks > maxCount) break;
+        for (int dets : {tracks / 2, tracks, tracks * 2}) {
+            if (dets == 0) continue;
+
+            // Tracks are the crowd one frame ago, detections are the moved crowd plus strangers
+            vector<Person> crowd = makeCrowd(max(tracks, dets), rng);
+            vector<Person> trackCrowd(crowd.begin(), crowd.begin() + tracks);
+            vector<Rect> trackBoxes = observeCrowd(trackCrowd, rng, 2);
+            stepCrowd(crowd);
+            vector<Person> detCrowd(crowd.begin(), crowd.begin() + dets);
+            vector<Rect> detBoxes = observeCrowd(detCrowd, rng, 3);
+
+            IoUMatcher matcher;
+            vector<pair<int, int>> matches;
+            const int repeats = 20;
+            auto begin = chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++) {
+                matches.clear();
+                matcher.match(trackBoxes, detBoxes, minIoU, matches);
+            }
+            double prunedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count() / repeats;
+
+            double prunedTotal = 0;
+            for (const auto& [t, d] : matches) prunedTotal += computeIoU(trackBoxes[t], detBoxes[d]);
+
+            string denseMs = "-", same = "-";
+            if (max(tracks, dets) <= denseLimit) {
+                double ms;
+                double denseTotal = denseTotalIoU(trackBoxes, detBoxes, minIoU, ms);
+                ostringstream os;
+                os << fixed << setprecision(3) << ms;
+                denseMs = os.str();
+                same = abs(denseTotal - prunedTotal) < 1e-3 ? "yes" : "NO";
+            }
+
+            // Full tracker over a moving crowd
+            ByteTrack tracker;
+            vector<Person> walkers = makeCrowd(dets, rng);
+            double updateMs = 0;
+            for (int f = 0; f < frames; f++) {
+                stepCrowd(walkers);
+                vector<Detection> detections;
+                crowdDetections(walkers, rng, 2, detections);
+                auto updateBegin = chrono::steady_clock::now();
+                tracker.update(detections);
+                updateMs += chrono::duration<double, milli>(chrono::steady_clock::now() - updateBegin).count();
+            }
+
+            cout << setw(6) << tracks << setw(6) << dets << setw(12) << matcher.candidateCount()
+                 << setw(11) << prunedMs << setw(10) << denseMs << setw(11) << same
+                 << setw(11) << updateMs / frames << endl;
+        }
+    }
+    return 0;
+}
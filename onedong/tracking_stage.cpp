@@ -0,0 +1,69 @@
+#include "tracking_stage.hpp"
+
+#include "detection_log.hpp"
+#include "metrics.hpp"
+#include "reid.hpp"
+#include "stereo.hpp"
+
+using namespace cv;
+using namespace std;
+
+TrackingStage::TrackingStage(const RuntimeConfig& runtime)
+    : byteTrack(runtime.tracker),
+      lineCounter(runtime.zones),
+      nms(runtime.nms),
+      decodeConfidence(runtime.decodeConfidence) {}
+
+void TrackingStage::setConfig(const RuntimeConfig& runtime) {
+    byteTrack.setConfig(runtime.tracker);
+    lineCounter.setZones(runtime.zones);
+    nms = runtime.nms;
+    decodeConfidence = runtime.decodeConfidence;
+}
+
+void TrackingStage::detect(const Detector& detector, const vector<Mat>& outputs, const vector<DecodeParams>& images,
+                           int firstImage, int batchSize) {
+    if (batchSize == 0) batchSize = static_cast<int>(images.size());
+    {
+        ScopedLatency timer(hotPathMetrics.decode);
+        candidates.count = 0;
+        for (size_t i = 0; i < images.size(); i++) {
+            DecodeParams params = images[i];
+            params.confThreshold = decodeConfidence;
+            detector.decodeImage(outputs, batchSize, firstImage + static_cast<int>(i), params, candidates);
+        }
+    }
+
+    // Also merges the duplicates overlapping tiles produce
+    {
+        ScopedLatency timer(hotPathMetrics.nms);
+        frameDetections.clear();
+        suppressToDetections(candidates, nms, frameDetections);
+    }
+    hotPathMetrics.detections.add(frameDetections.size());
+    detected = true;
+}
+
+void TrackingStage::track(const Mat& frame, chrono::steady_clock::time_point timestamp,
+                          chrono::system_clock::time_point time, const Mat& right) {
+    if (!detected) frameDetections.clear();
+
+    // Depth for every box, then drop what can't be a person standing in the doorway
+    if (stereo) {
+        stereo->estimate(frame, right, frameDetections);
+        stereo->gate(frameDetections);
+    }
+    if (recorder) {
+        recorder->write(time, detected, frameDetections);
+    }
+    detected = false;
+
+    ScopedLatency timer(hotPathMetrics.track);
+    currentTracks = byteTrack.update(frameDetections, timestamp);
+    // Before counting, so a returning person is counted under the id they left with
+    if (reid) {
+        reid->update(frame, byteTrack);
+    }
+    frameEvents.clear();
+    lineCounter.update(currentTracks, time, frameEvents);
+}
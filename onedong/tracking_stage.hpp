@@ -0,0 +1,72 @@
+#pragma once
+
+#include "bytetracker.hpp"
+#include "counter.hpp"
+#include "detection.hpp"
+#include "detector.hpp"
+#include "nms.hpp"
+#include "runtime_config.hpp"
+#include "yolo_decoder.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <vector>
+
+class DetectionLogWriter;
+class ReidStage;
+class StereoDepth;
+
+// Everything a frame goes through after the network: decode, NMS, stereo depth gating, recording,
+// tracking, ReID and counting. main's consumer loop, MultiCameraEngine (one per camera) and
+// FrameEngine all run their frames through it; capture, preprocessing, the forward pass and any
+// threads stay with them.
+class TrackingStage {
+    public:
+        explicit TrackingStage(const RuntimeConfig& runtime = RuntimeConfig());
+
+        // Tracker, NMS, decode threshold and zones from the next frame on; tracks and counts carry over
+        void setConfig(const RuntimeConfig& runtime);
+
+        // Optional stages, owned by the caller; null turns them off
+        void setStereo(StereoDepth* depth) { stereo = depth; }
+        void setReid(ReidStage* stage) { reid = stage; }
+        void setRecorder(DetectionLogWriter* log) { recorder = log; }
+
+        // Decodes this frame's images of a forward pass: images.size() of them from firstImage on,
+        // in a batch of batchSize (0 when the batch is just this frame). Not called on frames the
+        // network skipped; their tracks just coast.
+        void detect(const Detector& detector, const std::vector<cv::Mat>& outputs,
+                    const std::vector<DecodeParams>& images, int firstImage = 0, int batchSize = 0);
+
+        // Tracks and counts what detect() found on this frame. timestamp is the capture time on
+        // the steady clock, time the wall clock time crossings are stamped with; right is the raw
+        // right view with a stereo rig.
+        void track(const cv::Mat& frame, std::chrono::steady_clock::time_point timestamp,
+                   std::chrono::system_clock::time_point time, const cv::Mat& right = cv::Mat());
+
+        ByteTrack& tracker() { return byteTrack; }
+        LineCounter& counter() { return lineCounter; }
+        const LineCounter& counter() const { return lineCounter; }
+
+        // Of the last frame
+        const std::vector<Detection>& detections() const { return frameDetections; }
+        const TrackView& tracks() const { return currentTracks; }
+        const std::vector<CrossingEvent>& events() const { return frameEvents; }
+
+    private:
+        ByteTrack byteTrack;
+        LineCounter lineCounter;
+        NmsParams nms;
+        float decodeConfidence;
+        StereoDepth* stereo = nullptr;
+        ReidStage* reid = nullptr;
+        DetectionLogWriter* recorder = nullptr;
+        bool detected = false; // detect() ran since the last track()
+
+        // Reused between frames
+        DecodeBuffer candidates;
+        std::vector<Detection> frameDetections;
+        TrackView currentTracks;
+        std::vector<CrossingEvent> frameEvents;
+};
@@ -0,0 +1,366 @@
+#include "uplink.hpp"
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char* endpoints[2] = {"events/entries/", "events/exits/"};
+
+static size_t discardResponse(char*, size_t size, size_t nmemb, void*) {
+    return size * nmemb;
+}
+
+static string eventJson(const UplinkEvent& event) {
+    return "{\"timestamp\":\"" + event.timestamp + "\",\"entrance\":" + to_string(event.entrance) + "}";
+}
+
+static size_t fileSize(const string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+string isoTimestamp(chrono::system_clock::time_point time) {
+    auto ms = chrono::duration_cast<chrono::milliseconds>(time.time_since_epoch()).count();
+    time_t seconds = static_cast<time_t>(ms / 1000);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char buffer[32];
+    size_t n = strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(buffer + n, sizeof(buffer) - n, ".%03dZ", static_cast<int>(ms % 1000));
+    return buffer;
+}
+
+EventUplink::EventUplink(const UplinkConfig& config) : config(config), queue(config.queueDepth) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi = curl_multi_init();
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    for (int k = 0; k < 2; k++) {
+        CURL* curl = curl_easy_init();
+        string url = config.baseUrl + endpoints[k];
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str()); // libcurl copies the string
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, config.requestTimeoutMs);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardResponse);
+        handles[k] = curl;
+    }
+
+    running = true;
+    worker = thread(&EventUplink::run, this);
+}
+
+EventUplink::~EventUplink() {
+    stop();
+    for (auto* curl : handles) {
+        curl_easy_cleanup(curl);
+    }
+    curl_multi_cleanup(multi);
+    curl_slist_free_all(headers);
+    curl_global_cleanup();
+}
+
+bool EventUplink::enqueue(const UplinkEvent& event) {
+    UplinkEvent copy = event;
+    if (!queue.tryPush(copy)) {
+        droppedCount.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    pendingCount.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void EventUplink::stop() {
+    running = false;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void EventUplink::setBaseUrl(const string& url) {
+    lock_guard<std::mutex> lock(urlMutex);
+    nextBaseUrl = url;
+    urlChanged = true;
+}
+
+void EventUplink::applyBaseUrl() {
+    if (!urlChanged.exchange(false)) return;
+    lock_guard<std::mutex> lock(urlMutex);
+    config.baseUrl = nextBaseUrl;
+    for (int k = 0; k < 2; k++) {
+        string url = config.baseUrl + endpoints[k];
+        curl_easy_setopt(handles[k], CURLOPT_URL, url.c_str());
+    }
+}
+
+void EventUplink::run() {
+    mt19937 rng(random_device{}());
+    auto backoff = config.initialBackoff;
+    auto nextAttempt = chrono::steady_clock::now();
+    auto nextFlush = nextAttempt;
+    spoolHasData = fileSize(config.spoolPath) > 0;
+
+    while (running) {
+        applyBaseUrl();
+        drainQueue();
+        auto now = chrono::steady_clock::now();
+        bool haveWork = !pendingEvents.empty() || spoolHasData;
+
+        if (haveWork && now >= nextAttempt && now >= nextFlush) {
+            nextFlush = now + config.flushInterval;
+            if (spoolHasData) loadSpool();
+            if (flush()) {
+                backoff = config.initialBackoff;
+                if (spoolLoaded) spoolPending(); // Everything that was in the file is through
+            } else {
+                spoolPending();
+                // Jitter keeps a site's units from all retrying at the same moment
+                uniform_int_distribution<long> jitter(0, backoff.count() / 4);
+                nextAttempt = now + backoff + chrono::milliseconds(jitter(rng));
+                backoff = min(backoff * 2, config.maxBackoff);
+            }
+        } else if (now < nextAttempt && !pendingEvents.empty()) {
+            // Server is down, keep memory bounded by moving new events to disk
+            spoolPending();
+        }
+
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+
+    // One last attempt on shutdown, whatever doesn't make it is spooled for the next run
+    drainQueue();
+    if (!pendingEvents.empty() && chrono::steady_clock::now() >= nextAttempt) {
+        if (spoolHasData) loadSpool();
+        flush();
+    }
+    spoolPending();
+}
+
+void EventUplink::drainQueue() {
+    UplinkEvent event;
+    while (queue.tryPop(event)) {
+        pendingEvents.push_back(std::move(event));
+    }
+}
+
+// Sends batches until nothing is pending. Returns false on the first batch that needs a retry.
+bool EventUplink::flush() {
+    while (!pendingEvents.empty()) {
+        if (sendBatches() == SendResult::Failed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Posts up to batchSize of the oldest events, entries and exits in parallel on the multi handle
+EventUplink::SendResult EventUplink::sendBatches() {
+    ScopedLatency timer(hotPathMetrics.uplink);
+    size_t n = min(config.batchSize, pendingEvents.size());
+    size_t counts[2] = {0, 0};
+    for (int k = 0; k < 2; k++) {
+        bodies[k] = "[";
+    }
+    for (size_t i = 0; i < n; i++) {
+        const UplinkEvent& event = pendingEvents[i];
+        int k = event.kind == EventKind::Entry ? 0 : 1;
+        if (counts[k]++) bodies[k] += ',';
+        bodies[k] += eventJson(event);
+    }
+
+    for (int k = 0; k < 2; k++) {
+        if (!counts[k]) continue;
+        bodies[k] += ']';
+        curl_easy_setopt(handles[k], CURLOPT_POSTFIELDS, bodies[k].c_str());
+        curl_easy_setopt(handles[k], CURLOPT_POSTFIELDSIZE, static_cast<long>(bodies[k].size()));
+        curl_multi_add_handle(multi, handles[k]);
+    }
+
+    int stillRunning = 0;
+    do {
+        curl_multi_perform(multi, &stillRunning);
+        if (stillRunning) {
+            curl_multi_wait(multi, nullptr, 0, 100, nullptr);
+        }
+    } while (stillRunning);
+
+    SendResult results[2] = {SendResult::Sent, SendResult::Sent};
+    long statuses[2] = {0, 0};
+    int messagesLeft = 0;
+    while (CURLMsg* msg = curl_multi_info_read(multi, &messagesLeft)) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        int k = msg->easy_handle == handles[0] ? 0 : 1;
+        long status = 0;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+        statuses[k] = status;
+
+        if (msg->data.result != CURLE_OK) {
+            cerr << "Uplink request failed: " << curl_easy_strerror(msg->data.result) << endl;
+            results[k] = SendResult::Failed;
+        } else if (status >= 500 || status == 429 || status == 408) {
+            cerr << "Uplink server error: HTTP " << status << endl;
+            results[k] = SendResult::Failed;
+        } else if (status == 400) {
+            // Some event in the batch is bad, isolateRejected() finds which
+            if (counts[k] > 1) cerr << "Uplink batch rejected: HTTP 400, splitting " << counts[k] << " events" << endl;
+            results[k] = SendResult::Rejected;
+        } else if (status >= 400) {
+            cerr << "Uplink batch rejected: HTTP " << status << ", dropping " << counts[k] << " events" << endl;
+            results[k] = SendResult::Rejected;
+        }
+    }
+    for (int k = 0; k < 2; k++) {
+        if (counts[k]) curl_multi_remove_handle(multi, handles[k]);
+    }
+
+    vector<SendResult> outcomes(n);
+    vector<size_t> rejected[2];
+    for (size_t i = 0; i < n; i++) {
+        int k = pendingEvents[i].kind == EventKind::Entry ? 0 : 1;
+        outcomes[i] = results[k];
+        if (results[k] == SendResult::Rejected && statuses[k] == 400) rejected[k].push_back(i);
+    }
+    for (int k = 0; k < 2; k++) {
+        if (!rejected[k].empty()) isolateRejected(k, rejected[k], outcomes);
+    }
+
+    // Keep the events that have to be retried, in order, and drop the rejected ones
+    deque<UplinkEvent> retry;
+    for (size_t i = 0; i < n; i++) {
+        UplinkEvent& event = pendingEvents[i];
+        if (outcomes[i] == SendResult::Failed) {
+            retry.push_back(std::move(event));
+        } else if (outcomes[i] == SendResult::Sent) {
+            sentCount.fetch_add(1, memory_order_relaxed);
+        } else {
+            droppedCount.fetch_add(1, memory_order_relaxed);
+        }
+    }
+    size_t done = n - retry.size();
+    pendingEvents.erase(pendingEvents.begin(), pendingEvents.begin() + n);
+    pendingEvents.insert(pendingEvents.begin(), make_move_iterator(retry.begin()), make_move_iterator(retry.end()));
+    pendingCount.fetch_sub(done, memory_order_relaxed);
+
+    if (find(outcomes.begin(), outcomes.end(), SendResult::Failed) != outcomes.end()) return SendResult::Failed;
+    if (find(outcomes.begin(), outcomes.end(), SendResult::Rejected) != outcomes.end()) return SendResult::Rejected;
+    return SendResult::Sent;
+}
+
+// Posts some of the pending events (by index) to endpoint k on their own, outside the multi handle
+EventUplink::SendResult EventUplink::post(int k, const vector<size_t>& batch) {
+    string body = "[";
+    for (size_t i : batch) {
+        if (body.size() > 1) body += ',';
+        body += eventJson(pendingEvents[i]);
+    }
+    body += ']';
+    curl_easy_setopt(handles[k], CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(handles[k], CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    CURLcode result = curl_easy_perform(handles[k]);
+    long status = 0;
+    curl_easy_getinfo(handles[k], CURLINFO_RESPONSE_CODE, &status);
+
+    if (result != CURLE_OK || status >= 500 || status == 429 || status == 408) return SendResult::Failed;
+    return status >= 400 ? SendResult::Rejected : SendResult::Sent;
+}
+
+// Halves a rejected batch until each event the server refuses is on its own, so one bad event
+// doesn't take the rest of its batch with it. Halves that can't be sent now are retried later.
+void EventUplink::isolateRejected(int k, const vector<size_t>& batch, vector<SendResult>& outcomes) {
+    if (batch.size() == 1) {
+        const UplinkEvent& event = pendingEvents[batch[0]];
+        cerr << "Uplink dropped rejected " << (k == 0 ? "entry" : "exit") << " at entrance " << event.entrance
+             << ", " << event.timestamp << endl;
+        outcomes[batch[0]] = SendResult::Rejected;
+        return;
+    }
+    size_t half = batch.size() / 2;
+    vector<size_t> parts[2] = {vector<size_t>(batch.begin(), batch.begin() + half),
+                               vector<size_t>(batch.begin() + half, batch.end())};
+    for (const auto& part : parts) {
+        SendResult result = post(k, part);
+        if (result == SendResult::Rejected) {
+            isolateRejected(k, part, outcomes);
+        } else {
+            for (size_t i : part) outcomes[i] = result;
+        }
+    }
+}
+
+// Spool lines are "<entry|exit> <entrance> <timestamp>", oldest first. While the file's events are
+// loaded it is replaced, through a temporary file and a rename, by everything still pending;
+// otherwise pending events are appended. Either way the file never loses an undelivered event.
+void EventUplink::spoolPending() {
+    if (pendingEvents.empty() && !spoolLoaded) return;
+
+    const string path = spoolLoaded ? config.spoolPath + ".tmp" : config.spoolPath;
+    size_t size = spoolLoaded ? 0 : fileSize(path);
+    ofstream spool(path, spoolLoaded ? ios::trunc : ios::app);
+    if (spoolLoaded) spooledEvents = 0;
+    size_t lost = 0;
+    for (const auto& event : pendingEvents) {
+        ostringstream line;
+        line << (event.kind == EventKind::Entry ? "entry" : "exit") << ' ' << event.entrance << ' ' << event.timestamp << '\n';
+        string text = line.str();
+        if (!spool || size + text.size() > config.maxSpoolBytes) {
+            lost++;
+            continue;
+        }
+        spool << text;
+        size += text.size();
+        spooledEvents++;
+    }
+    spool.close();
+    if (spoolLoaded) {
+        if (rename(path.c_str(), config.spoolPath.c_str()) != 0) {
+            // The old file still holds the events it held; new ones are lost only if the disk is failing
+            cerr << "Uplink cannot replace " << config.spoolPath << ": " << strerror(errno) << endl;
+        }
+        spoolLoaded = false;
+    }
+
+    if (lost) {
+        cerr << "Uplink spool full, dropped " << lost << " events" << endl;
+        droppedCount.fetch_add(lost, memory_order_relaxed);
+        pendingCount.fetch_sub(lost, memory_order_relaxed);
+    }
+    spoolHasData = spooledEvents > 0 || size > 0;
+    pendingEvents.clear();
+}
+
+// Puts spooled events in front of the in-memory ones. The file is left alone until they have been
+// delivered or spooled again, so a crash while they are in flight loses none of them.
+void EventUplink::loadSpool() {
+    ifstream spool(config.spoolPath);
+    deque<UplinkEvent> loaded;
+    string kind;
+    UplinkEvent event;
+    while (spool >> kind >> event.entrance >> event.timestamp) {
+        event.kind = kind == "exit" ? EventKind::Exit : EventKind::Entry;
+        loaded.push_back(event);
+    }
+    spool.close();
+    spoolLoaded = true;
+
+    // Events spooled by an earlier run weren't counted as pending yet
+    if (loaded.size() > spooledEvents) {
+        pendingCount.fetch_add(loaded.size() - spooledEvents, memory_order_relaxed);
+    }
+    spooledEvents = 0;
+    spoolHasData = false;
+    pendingEvents.insert(pendingEvents.begin(), make_move_iterator(loaded.begin()), make_move_iterator(loaded.end()));
+}
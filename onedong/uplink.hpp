@@ -0,0 +1,103 @@
+#pragma once
+
+#include "spsc_queue.hpp"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class EventKind {
+    Entry,
+    Exit,
+};
+
+struct UplinkEvent {
+    EventKind kind = EventKind::Entry;
+    int entrance = 1;
+    std::string timestamp; // ISO 8601, as the server's DateTimeField expects
+};
+
+struct UplinkConfig {
+    std::string baseUrl = "http://localhost:8000/api/v1/";
+    size_t queueDepth = 4096;         // Events the frame loop can queue before they are dropped
+    size_t batchSize = 100;           // Events per POST
+    std::chrono::milliseconds flushInterval{0}; // Collects events this long between POSTs; 0 sends them right away
+    std::string spoolPath = "uplink.spool";
+    size_t maxSpoolBytes = 16 << 20;  // Events beyond this are dropped while the server is unreachable
+    std::chrono::milliseconds initialBackoff{500};
+    std::chrono::milliseconds maxBackoff{60000};
+    long requestTimeoutMs = 5000;
+};
+
+// Formats a wall clock time as ISO 8601 UTC with milliseconds
+std::string isoTimestamp(std::chrono::system_clock::time_point time);
+
+// Posts entry/exit events to the server from a background thread.
+// The caller only pays for a lock-free enqueue. The uplink thread batches queued events into
+// one POST per endpoint over a persistent curl multi handle (connections are kept alive), retries
+// with exponential backoff, and spools events to disk while the server can't be reached.
+class EventUplink {
+    public:
+        explicit EventUplink(const UplinkConfig& config);
+        ~EventUplink();
+
+        // Must only be called from one thread. Returns false if the queue is full and the event was dropped.
+        bool enqueue(const UplinkEvent& event);
+
+        // Tries a last flush, spools whatever is left and joins the thread
+        void stop();
+
+        // Points the uplink at another server from the next POST on; queued and spooled events
+        // go to the new one. Safe to call from any thread.
+        void setBaseUrl(const std::string& url);
+
+        size_t pending() const { return pendingCount.load(std::memory_order_relaxed); }
+        uint64_t sent() const { return sentCount.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    private:
+        enum class SendResult {
+            Sent,
+            Rejected, // Server refused the batch, retrying won't help
+            Failed,   // Network or server error, retry later
+        };
+
+        void run();
+        void applyBaseUrl();
+        void drainQueue();
+        bool flush();
+        SendResult sendBatches();
+        SendResult post(int k, const std::vector<size_t>& batch);
+        void isolateRejected(int k, const std::vector<size_t>& batch, std::vector<SendResult>& outcomes);
+        void spoolPending();
+        void loadSpool();
+
+        UplinkConfig config;
+        SpscQueue<UplinkEvent> queue;
+        std::deque<UplinkEvent> pendingEvents; // Uplink thread only
+        bool spoolHasData = false;
+        bool spoolLoaded = false; // The spool's events are in pendingEvents, the file still has them
+
+        CURLM* multi = nullptr;
+        CURL* handles[2] = {nullptr, nullptr}; // One per endpoint, reused so connections stay alive
+        curl_slist* headers = nullptr;
+        std::string bodies[2];
+        size_t spooledEvents = 0;
+
+        std::mutex urlMutex;
+        std::string nextBaseUrl; // Guarded by urlMutex
+        std::atomic<bool> urlChanged{false};
+
+        std::thread worker;
+        std::atomic<bool> running{false};
+        std::atomic<size_t> pendingCount{0};
+        std::atomic<uint64_t> sentCount{0};
+        std::atomic<uint64_t> droppedCount{0};
+};
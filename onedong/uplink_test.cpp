@@ -0,0 +1,225 @@
+// Checks EventUplink against a stub HTTP server on localhost: batches are delivered, an event the
+// server refuses with 400 is dropped without its batch, events spooled while the server is down
+// are delivered once it is back, and a process killed while spooled events are in flight leaves
+// them in the spool. Exits non-zero when any of that doesn't hold.
+#include "uplink.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Answers one request per connection: 503 while down, 400 for a batch holding an event at
+// entrance 13, 201 otherwise. Bodies it accepted are kept for the checks.
+class StubServer {
+    public:
+        StubServer() {
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            int on = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            socklen_t length = sizeof(addr);
+            getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &length);
+            port = ntohs(addr.sin_port);
+            listen(listener, 16);
+        }
+
+        ~StubServer() {
+            stop();
+            close(listener);
+        }
+
+        // Without start() connections queue up unanswered, like a server that hangs
+        void start() {
+            running = true;
+            worker = thread(&StubServer::run, this);
+        }
+
+        void stop() {
+            running = false;
+            if (worker.joinable()) worker.join();
+        }
+
+        string baseUrl() const { return "http://127.0.0.1:" + to_string(port) + "/api/v1/"; }
+
+        // Events in the accepted bodies, entries and exits together
+        size_t accepted() {
+            lock_guard<mutex> lock(bodiesMutex);
+            size_t n = 0;
+            for (const string& body : bodies) {
+                for (size_t at = body.find("\"entrance\""); at != string::npos; at = body.find("\"entrance\"", at + 1)) n++;
+            }
+            return n;
+        }
+
+        atomic<bool> down{false};
+
+    private:
+        void run() {
+            while (running) {
+                pollfd ready = {listener, POLLIN, 0};
+                if (poll(&ready, 1, 20) <= 0) continue;
+                int connection = accept(listener, nullptr, nullptr);
+                if (connection < 0) continue;
+                answer(connection);
+                close(connection);
+            }
+        }
+
+        void answer(int connection) {
+            string request;
+            char buffer[4096];
+            size_t headerEnd = string::npos;
+            size_t contentLength = 0;
+            while (true) {
+                ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+                if (n <= 0) return;
+                request.append(buffer, n);
+                if (headerEnd == string::npos) {
+                    headerEnd = request.find("\r\n\r\n");
+                    if (headerEnd == string::npos) continue;
+                    size_t field = request.find("Content-Length: ");
+                    if (field != string::npos && field < headerEnd) contentLength = stoul(request.substr(field + 16));
+                }
+                if (request.size() >= headerEnd + 4 + contentLength) break;
+            }
+            string body = request.substr(headerEnd + 4, contentLength);
+
+            const char* status = "201 Created";
+            if (down) {
+                status = "503 Service Unavailable";
+            } else if (body.find("\"entrance\":13") != string::npos) {
+                status = "400 Bad Request";
+            } else {
+                lock_guard<mutex> lock(bodiesMutex);
+                bodies.push_back(body);
+            }
+            string response = string("HTTP/1.1 ") + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send(connection, response.data(), response.size(), MSG_NOSIGNAL);
+        }
+
+        int listener = -1;
+        int port = 0;
+        thread worker;
+        atomic<bool> running{false};
+        mutex bodiesMutex;
+        vector<string> bodies;
+};
+
+static const char* spoolPath = "uplink_test.spool";
+
+static UplinkEvent event(int i, int entrance = 1) {
+    UplinkEvent e;
+    e.kind = i % 3 == 0 ? EventKind::Exit : EventKind::Entry;
+    e.entrance = entrance;
+    e.timestamp = "2024-01-01T00:00:" + to_string(10 + i) + ".000Z";
+    return e;
+}
+
+static size_t spoolLines() {
+    ifstream spool(spoolPath);
+    size_t n = 0;
+    for (string line; getline(spool, line);) n++;
+    return n;
+}
+
+// Polls until the condition holds or a few seconds have passed
+static bool waitFor(const function<bool()>& condition) {
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (!condition()) {
+        if (chrono::steady_clock::now() > deadline) return false;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+    auto expect = [&ok](bool condition, const char* what) {
+        cout << (condition ? "ok    " : "FAIL  ") << what << endl;
+        ok = ok && condition;
+    };
+
+    // Forked before any thread exists. The child loads the spool, posts it to a server that
+    // never answers and is killed mid-request; the spool must still hold every event.
+    {
+        StubServer hanging;
+        {
+            ofstream spool(spoolPath, ios::trunc);
+            spool << "entry 1 2024-01-01T00:00:01.000Z\nexit 1 2024-01-01T00:00:02.000Z\nentry 2 2024-01-01T00:00:03.000Z\n";
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            UplinkConfig config;
+            config.baseUrl = hanging.baseUrl();
+            config.spoolPath = spoolPath;
+            config.requestTimeoutMs = 30000;
+            EventUplink uplink(config);
+            this_thread::sleep_for(chrono::seconds(30));
+            _exit(0);
+        }
+        this_thread::sleep_for(chrono::milliseconds(500));
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        expect(spoolLines() == 3, "a crash with spooled events in flight keeps them in the spool");
+    }
+    remove(spoolPath);
+
+    StubServer server;
+    server.start();
+    UplinkConfig config;
+    config.baseUrl = server.baseUrl();
+    config.spoolPath = spoolPath;
+    config.batchSize = 10;
+    config.initialBackoff = chrono::milliseconds(100);
+    config.maxBackoff = chrono::milliseconds(200);
+
+    {
+        EventUplink uplink(config);
+        for (int i = 0; i < 10; i++) uplink.enqueue(event(i, i == 4 || i == 7 ? 13 : 1));
+        waitFor([&uplink] { return uplink.pending() == 0; });
+        uplink.stop();
+        expect(uplink.sent() == 8 && server.accepted() == 8, "eight good events delivered");
+        expect(uplink.dropped() == 2, "only the two events the server refuses are dropped");
+    }
+
+    server.down = true;
+    {
+        EventUplink uplink(config);
+        for (int i = 0; i < 5; i++) uplink.enqueue(event(i));
+        this_thread::sleep_for(chrono::milliseconds(300));
+        uplink.stop();
+        expect(uplink.sent() == 0 && uplink.pending() == 5, "nothing is sent while the server is down");
+        expect(spoolLines() == 5, "events are spooled while the server is down");
+    }
+
+    server.down = false;
+    {
+        EventUplink uplink(config);
+        bool delivered = waitFor([&server] { return server.accepted() == 13; });
+        uplink.stop();
+        expect(delivered && uplink.sent() == 5, "spooled events are delivered by the next run");
+        expect(spoolLines() == 0, "the spool is emptied once they are through");
+    }
+    remove(spoolPath);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#include "yolo_decoder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DECODER_HAVE_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DECODER_HAVE_NEON 1
+#endif
+
+using namespace cv;
+using namespace std;
+
+void DecodeBuffer::reserve(size_t rows) {
+    if (x.size() >= rows) return;
+    x.resize(rows);
+    y.resize(rows);
+    w.resize(rows);
+    h.resize(rows);
+    conf.resize(rows);
+}
+
+Rect DecodeBuffer::box(size_t i) const {
+    return Rect(static_cast<int>(x[i]), static_cast<int>(y[i]), static_cast<int>(w[i]), static_cast<int>(h[i]));
+}
+
+// Same integer rounding as the original per-row decode, so boxes are bit-identical
+static inline void emitBox(const float* data, float confidence, const DecodeParams& params, DecodeBuffer& out) {
+    int centerX = static_cast<int>(data[0] * params.scaleX + params.offsetX);
+    int centerY = static_cast<int>(data[1] * params.scaleY + params.offsetY);
+    int width = static_cast<int>(data[2] * params.scaleX);
+    int height = static_cast<int>(data[3] * params.scaleY);
+
+    size_t i = out.count++;
+    out.x[i] = static_cast<float>(centerX - width / 2);
+    out.y[i] = static_cast<float>(centerY - height / 2);
+    out.w[i] = static_cast<float>(width);
+    out.h[i] = static_cast<float>(height);
+    out.conf[i] = confidence;
+}
+
+// max_element picks the first maximum, so person wins ties against the other classes
+static inline bool personIsArgmaxScalar(const float* scores, int classCount) {
+    const float person = scores[0];
+    for (int c = 1; c < classCount; c++) {
+        if (scores[c] > person) return false;
+    }
+    return true;
+}
+
+static void decodeScalar(const float* rows, int rowCount, int stride, const DecodeParams& params, DecodeBuffer& out) {
+    const int classCount = stride - 5;
+    for (int i = 0; i < rowCount; i++) {
+        const float* data = rows + static_cast<size_t>(i) * stride;
+        const float person = data[5];
+        // Early rejection: nearly every row fails here without touching the other class scores
+        if (!(person > params.confThreshold)) continue;
+        if (personIsArgmaxScalar(data + 5, classCount)) {
+            emitBox(data, person, params, out);
+        }
+    }
+}
+
+#if DECODER_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static inline bool personIsArgmaxAvx2(const float* scores, int classCount) {
+    const float person = scores[0];
+    __m256 best = _mm256_set1_ps(person);
+    int c = 1;
+    for (; c + 8 <= classCount; c += 8) {
+        // maxps returns the second operand on NaN, so NaN scores are skipped as max_element skips them
+        best = _mm256_max_ps(_mm256_loadu_ps(scores + c), best);
+    }
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+    float maxScore = _mm_cvtss_f32(half);
+    for (; c < classCount; c++) {
+        maxScore = scores[c] > maxScore ? scores[c] : maxScore;
+    }
+    return !(maxScore > person);
+}
+
+__attribute__((target("avx2")))
+static void decodeAvx2(const float* rows, int rowCount, int stride, const DecodeParams& params, DecodeBuffer& out) {
+    const int classCount = stride - 5;
+    const __m256 threshold = _mm256_set1_ps(params.confThreshold);
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+
+    int i = 0;
+    // Threshold test for eight rows at once by gathering their person scores
+    for (; i + 8 <= rowCount; i += 8) {
+        const float* block = rows + static_cast<size_t>(i) * stride;
+        __m256 person = _mm256_i32gather_ps(block + 5, offsets, 4);
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(person, threshold, _CMP_GT_OQ));
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            const float* data = block + static_cast<size_t>(lane) * stride;
+            if (personIsArgmaxAvx2(data + 5, classCount)) {
+                emitBox(data, data[5], params, out);
+            }
+        }
+    }
+    decodeScalar(rows + static_cast<size_t>(i) * stride, rowCount - i, stride, params, out);
+}
+
+static bool cpuHasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+#if DECODER_HAVE_NEON
+
+static inline bool personIsArgmaxNeon(const float* scores, int classCount) {
+    const float person = scores[0];
+    float32x4_t best = vdupq_n_f32(person);
+    int c = 1;
+    for (; c + 4 <= classCount; c += 4) {
+        // maxNum ignores NaN scores like max_element does; vmaxq would propagate them
+        best = vmaxnmq_f32(best, vld1q_f32(scores + c));
+    }
+    float maxScore = vmaxnmvq_f32(best);
+    for (; c < classCount; c++) {
+        maxScore = scores[c] > maxScore ? scores[c] : maxScore;
+    }
+    return !(maxScore > person);
+}
+
+static void decodeNeon(const float* rows, int rowCount, int stride, const DecodeParams& params, DecodeBuffer& out) {
+    const int classCount = stride - 5;
+    const float32x4_t threshold = vdupq_n_f32(params.confThreshold);
+
+    int i = 0;
+    // Threshold test for four rows at once
+    for (; i + 4 <= rowCount; i += 4) {
+        const float* block = rows + static_cast<size_t>(i) * stride;
+        float32x4_t person = vdupq_n_f32(0.0f);
+        person = vld1q_lane_f32(block + 5, person, 0);
+        person = vld1q_lane_f32(block + stride + 5, person, 1);
+        person = vld1q_lane_f32(block + 2 * stride + 5, person, 2);
+        person = vld1q_lane_f32(block + 3 * stride + 5, person, 3);
+        uint32x4_t pass = vcgtq_f32(person, threshold);
+        if (vmaxvq_u32(pass) == 0) continue;
+
+        uint32_t lanes[4];
+        vst1q_u32(lanes, pass);
+        for (int lane = 0; lane < 4; lane++) {
+            if (!lanes[lane]) continue;
+            const float* data = block + static_cast<size_t>(lane) * stride;
+            if (personIsArgmaxNeon(data + 5, classCount)) {
+                emitBox(data, data[5], params, out);
+            }
+        }
+    }
+    decodeScalar(rows + static_cast<size_t>(i) * stride, rowCount - i, stride, params, out);
+}
+
+#endif
+
+void decodePersonRows(const float* rows, int rowCount, int stride, const DecodeParams& params,
+                      DecodeBuffer& out, DecodePath path) {
+    if (rowCount <= 0 || stride < 6) return;
+    out.reserve(out.count + rowCount);
+
+    if (path != DecodePath::Scalar) {
+#if DECODER_HAVE_AVX2
+        if (cpuHasAvx2()) {
+            decodeAvx2(rows, rowCount, stride, params, out);
+            return;
+        }
+#elif DECODER_HAVE_NEON
+        decodeNeon(rows, rowCount, stride, params, out);
+        return;
+#endif
+    }
+    decodeScalar(rows, rowCount, stride, params, out);
+}
+
+void decodePersons(const vector<Mat>& outputs, const DecodeParams& params, DecodeBuffer& out, DecodePath path) {
+    size_t totalRows = 0;
+    for (const auto& output : outputs) {
+        totalRows += output.rows;
+    }
+    out.reserve(totalRows);
+    out.count = 0;
+
+    for (const auto& output : outputs) {
+        CV_Assert(output.type() == CV_32F && output.isContinuous());
+        decodePersonRows(output.ptr<float>(), output.rows, output.cols, params, out, path);
+    }
+}
+
+void decodePersonColumns(const float* data, int channels, int anchors, Size inputSize,
+                         const DecodeParams& params, DecodeBuffer& out) {
+    if (anchors <= 0 || channels < 5) return;
+    out.reserve(out.count + anchors);
+
+    const float* person = data + 4 * static_cast<size_t>(anchors);
+    const float invWidth = 1.0f / inputSize.width;
+    const float invHeight = 1.0f / inputSize.height;
+    for (int a = 0; a < anchors; a++) {
+        // The person row is contiguous, so the rejection scan streams through memory
+        const float score = person[a];
+        if (!(score > params.confThreshold)) continue;
+
+        bool isArgmax = true;
+        for (int c = 5; c < channels && isArgmax; c++) {
+            isArgmax = !(data[static_cast<size_t>(c) * anchors + a] > score);
+        }
+        if (!isArgmax) continue;
+
+        // Same normalised layout as a darknet row, so boxes round the same way
+        const float box[4] = {
+            data[a] * invWidth,
+            data[anchors + a] * invHeight,
+            data[2 * static_cast<size_t>(anchors) + a] * invWidth,
+            data[3 * static_cast<size_t>(anchors) + a] * invHeight,
+        };
+        emitBox(box, score, params, out);
+    }
+}
+
+void decodeBatchImage(const vector<Mat>& outputs, int batchSize, int image, const DecodeParams& params,
+                      DecodeBuffer& out, DecodePath path) {
+    for (const auto& output : outputs) {
+        CV_Assert(output.type() == CV_32F && output.isContinuous() && output.rows % batchSize == 0);
+        int rowsPerImage = output.rows / batchSize;
+        decodePersonRows(output.ptr<float>(image * rowsPerImage), rowsPerImage, output.cols, params, out, path);
+    }
+}
+
+void decodeBatch(const vector<Mat>& outputs, const vector<DecodeParams>& images, DecodeBuffer& out, DecodePath path) {
+    out.count = 0;
+    const int batchSize = static_cast<int>(images.size());
+    for (int b = 0; b < batchSize; b++) {
+        decodeBatchImage(outputs, batchSize, b, images[b], out, path);
+    }
+}
+
+const char* decodeSimdName() {
+#if DECODER_HAVE_AVX2
+    return cpuHasAvx2() ? "avx2" : "scalar";
+#elif DECODER_HAVE_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
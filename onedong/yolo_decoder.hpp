@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Person candidates in structure-of-arrays form. Arrays only ever grow, so once
+// they've seen the largest output the decoder writes into them without allocating.
+struct DecodeBuffer {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> w;
+    std::vector<float> h;
+    std::vector<float> conf;
+    size_t count = 0;
+
+    void reserve(size_t rows);
+    cv::Rect box(size_t i) const;
+};
+
+struct DecodeParams {
+    float confThreshold = 0.1f;
+    // Frame coordinate = normalised output * scale + offset
+    float scaleX = 1.0f;
+    float scaleY = 1.0f;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+};
+
+enum class DecodePath {
+    Auto,   // Best path the CPU supports
+    Scalar,
+    Simd,   // AVX2 or NEON; falls back to scalar when neither is available
+};
+
+// Decodes darknet YOLO output rows (cx, cy, w, h, objectness, class scores...) in place and
+// appends a box for every row whose best class is person (class 0) with a score above the
+// threshold. Matches the argmax-then-threshold logic exactly, so all paths give identical results.
+void decodePersonRows(const float* rows, int rowCount, int stride, const DecodeParams& params,
+                      DecodeBuffer& out, DecodePath path = DecodePath::Auto);
+
+// Clears the buffer and decodes every output Mat of a forward pass
+void decodePersons(const std::vector<cv::Mat>& outputs, const DecodeParams& params,
+                   DecodeBuffer& out, DecodePath path = DecodePath::Auto);
+
+// Decodes one image of YOLOv8-style output (ONNX exports from yolov/): `channels` rows of `anchors`
+// values, namely cx, cy, w, h in input pixels followed by one score per class and no objectness.
+// Appends every anchor whose best class is person (class 0) with a score above the threshold.
+void decodePersonColumns(const float* data, int channels, int anchors, cv::Size inputSize,
+                         const DecodeParams& params, DecodeBuffer& out);
+
+// Decodes image `image` of a forward pass over a batch of batchSize images and appends its boxes.
+// Each output stacks the rows of every image in the batch, one image after another.
+void decodeBatchImage(const std::vector<cv::Mat>& outputs, int batchSize, int image, const DecodeParams& params,
+                      DecodeBuffer& out, DecodePath path = DecodePath::Auto);
+
+// Clears the buffer and decodes every image of a batched forward pass, each with its own mapping
+void decodeBatch(const std::vector<cv::Mat>& outputs, const std::vector<DecodeParams>& images,
+                 DecodeBuffer& out, DecodePath path = DecodePath::Auto);
+
+// Name of the SIMD path used by DecodePath::Auto on this machine
+const char* decodeSimdName();
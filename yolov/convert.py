@@ -2,7 +2,7 @@ import torch
 import argparse
 from ultralytics import YOLO  # Correct way to load YOLOv8 models
 
-def export_onnx(model_path, output_onnx, img_size, opset_version):
+def export_onnx(model_path, output_onnx, img_size, opset_version, dynamic_batch):
     # Load trained YOLO model
     model = YOLO(model_path)  # Corrected from torch.hub.load
 
@@ -16,7 +16,9 @@ def export_onnx(model_path, output_onnx, img_size, opset_version):
         output_onnx,
         opset_version=opset_version,
         input_names=["images"],
-        output_names=["outputs"]
+        output_names=["outputs"],
+        # A dynamic batch lets onedong run tiles and several cameras in one forward pass
+        dynamic_axes={"images": {0: "batch"}, "outputs": {0: "batch"}} if dynamic_batch else None
     )
 
     print(f"ONNX model saved as {output_onnx}")
@@ -27,6 +29,7 @@ if __name__ == "__main__":
     parser.add_argument("--output-onnx", type=str, default="model.onnx", help="Output ONNX file name")
     parser.add_argument("--img-size", type=int, default=640, help="Image size for dummy input")
     parser.add_argument("--opset-version", type=int, default=11, help="ONNX opset version")
+    parser.add_argument("--dynamic-batch", action="store_true", help="Export with a variable batch size")
 
     args = parser.parse_args()
-    export_onnx(args.model_path, args.output_onnx, args.img_size, args.opset_version)
+    export_onnx(args.model_path, args.output_onnx, args.img_size, args.opset_version, args.dynamic_batch)
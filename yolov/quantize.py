@@ -0,0 +1,82 @@
+import argparse
+import glob
+import os
+
+import cv2
+import numpy as np
+from onnxruntime.quantization import (CalibrationDataReader, QuantFormat, QuantType,
+                                      quantize_static)
+from onnxruntime.quantization.shape_inference import quant_pre_process
+
+
+def letterbox(image, size, pad=0.5):
+    """
+    Scale an image into a size x size float CHW tensor the way onedong's --letterbox
+    preprocessing does (RGB, 0..1, centred, padded with `pad`).
+    """
+    h, w = image.shape[:2]
+    scale = min(size / w, size / h)
+    nw, nh = int(round(w * scale)), int(round(h * scale))
+    resized = cv2.resize(image, (nw, nh), interpolation=cv2.INTER_LINEAR)
+    canvas = np.full((size, size, 3), pad, dtype=np.float32)
+    x, y = (size - nw) // 2, (size - nh) // 2
+    canvas[y:y + nh, x:x + nw] = cv2.cvtColor(resized, cv2.COLOR_BGR2RGB).astype(np.float32) / 255.0
+    return canvas.transpose(2, 0, 1)[np.newaxis]
+
+
+class ImageCalibrationReader(CalibrationDataReader):
+    """
+    Feeds dataset frames to the calibrator one at a time. Use frames from the cameras the
+    model will run on; activation ranges taken from other footage cost accuracy.
+    """
+
+    def __init__(self, input_name, image_paths, img_size):
+        self.input_name = input_name
+        self.image_paths = iter(image_paths)
+        self.img_size = img_size
+
+    def get_next(self):
+        for path in self.image_paths:
+            image = cv2.imread(path)
+            if image is None:
+                print(f"Skipping unreadable image {path}")
+                continue
+            return {self.input_name: letterbox(image, self.img_size)}
+        return None
+
+
+def quantize(model, output, calib_dir, count, img_size):
+    image_paths = sorted(glob.glob(os.path.join(calib_dir, "*.jpg")) +
+                         glob.glob(os.path.join(calib_dir, "*.png")))[:count]
+    if not image_paths:
+        raise SystemExit(f"Error: No calibration images in {calib_dir}")
+    print(f"Calibrating on {len(image_paths)} images")
+
+    # Shape inference and graph cleanup first, as onnxruntime recommends
+    prepared = output + ".prep.onnx"
+    quant_pre_process(model, prepared)
+
+    quantize_static(
+        prepared,
+        output,
+        ImageCalibrationReader("images", image_paths, img_size),
+        quant_format=QuantFormat.QDQ,
+        per_channel=True,
+        activation_type=QuantType.QUInt8,
+        weight_type=QuantType.QInt8,
+    )
+    os.remove(prepared)
+
+    print(f"int8 model saved as {output}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Quantize an exported YOLO ONNX model to int8 for CPU inference")
+    parser.add_argument("--model", type=str, required=True, help="fp32 ONNX model from convert.py")
+    parser.add_argument("--output", type=str, default="model.int8.onnx", help="Output ONNX file name")
+    parser.add_argument("--calib-dir", type=str, required=True, help="Directory of representative frames")
+    parser.add_argument("--count", type=int, default=200, help="Number of calibration images")
+    parser.add_argument("--img-size", type=int, default=640, help="Network input size")
+
+    args = parser.parse_args()
+    quantize(args.model, args.output, args.calib_dir, args.count, args.img_size)